@@ -18,6 +18,7 @@
 #include "physics_and_chemistry.hpp"
 #include "sisummary.hpp"
 #include "spectrum_data.hpp"
+#include "utils/count_set.hpp"
 #include "visualize.hpp"
 
 using namespace magnon;
@@ -136,20 +137,6 @@ using Sis = std::vector<std::string>;
 using SisSet = std::set<Sis>;
 using SiToPossibs = std::map<std::string, std::set<int>>;
 
-std::set<int> all_sums(const std::set<int> &a, const std::set<int> &b) {
-    assert(!a.empty());
-    assert(!b.empty());
-
-    std::set<int> result;
-    for (const auto &x : a) {
-        for (const auto &y : b) {
-            result.insert(x + y);
-        }
-    }
-
-    return result;
-}
-
 // template<typename T>
 // void cartesian_product(auto first_set_it,
 //                        auto last_set_it,
@@ -209,8 +196,8 @@ static std::
     all_sis.insert("-0");
     all_sis.insert("-");
 
-    std::map<std::string, std::set<int>> finalsi_to_possibcounts;
-    std::map<std::string, std::set<int>> si_to_possibcounts;
+    std::map<std::string, utils::CountSet> finalsi_to_possibcounts;
+    std::map<std::string, utils::CountSet> si_to_possibcounts;
 
     for (const auto &[gap_range, sis_set] : gap_range_sis_set_pairs) {
         const auto &[gap_begin, gap_end] = gap_range;
@@ -225,13 +212,12 @@ static std::
             if (gap_end == 0) {  // finished super Hamiltonian
                 assert(gap_begin - 1 == num_bands);
 
-                finalsi_to_possibcounts[key_si].insert(si_to_possibcounts.at(key_si).begin(),
-                                                       si_to_possibcounts.at(key_si).end());
-                si_to_possibcounts[key_si].clear();
+                finalsi_to_possibcounts[key_si].merge(si_to_possibcounts.at(key_si));
+                si_to_possibcounts[key_si] = {};
                 continue;
             }
 
-            std::set<int> cur_possibcounts;
+            utils::CountSet cur_possibcounts;
 
             if (key_si == "-0") {
                 for (const auto &sis : sis_set) {
@@ -250,25 +236,30 @@ static std::
         }
     }
 
+    std::map<std::string, std::set<int>> finalsistr_to_possibcounts;
+    for (const auto &[si, possibcounts] : finalsi_to_possibcounts) {
+        finalsistr_to_possibcounts[si] = possibcounts.to_set();
+    }
+
     std::set<int> gappednontrivial_possibcounts_exctopband;
-    for (auto count : finalsi_to_possibcounts.at("-0")) {
+    for (auto count : finalsistr_to_possibcounts.at("-0")) {
         assert(count >= 1);
         gappednontrivial_possibcounts_exctopband.insert(num_bands - count);
     }
-    finalsi_to_possibcounts["well-defined \\& nontrivial"] =
+    finalsistr_to_possibcounts["well-defined \\& nontrivial"] =
         gappednontrivial_possibcounts_exctopband;
-    finalsi_to_possibcounts.erase("-0");
+    finalsistr_to_possibcounts.erase("-0");
 
-    finalsi_to_possibcounts["undefined (gap closed)"] = finalsi_to_possibcounts.at("-");
-    finalsi_to_possibcounts.erase("-");
+    finalsistr_to_possibcounts["undefined (gap closed)"] = finalsistr_to_possibcounts.at("-");
+    finalsistr_to_possibcounts.erase("-");
 
     std::set<int> correct_trivial_counts;
-    for (const auto &incorrect_count : finalsi_to_possibcounts.at(trivial_si)) {
+    for (const auto &incorrect_count : finalsistr_to_possibcounts.at(trivial_si)) {
         assert(incorrect_count >= 1);
         correct_trivial_counts.insert(incorrect_count - 1);
     }
-    finalsi_to_possibcounts.at(trivial_si) = correct_trivial_counts;
-    return {trivial_si, finalsi_to_possibcounts, gap_to_possibsis};
+    finalsistr_to_possibcounts.at(trivial_si) = correct_trivial_counts;
+    return {trivial_si, finalsistr_to_possibcounts, gap_to_possibsis};
 }
 
 }  // namespace
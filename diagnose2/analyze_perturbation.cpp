@@ -1,205 +1,740 @@
 #include "diagnose2/analyze_perturbation.hpp"
 
+#include <algorithm>
+#include <atomic>
 #include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <iterator>
+#include <mutex>
 #include <optional>
 #include <set>
-#include <sstream>
+#include <stdexcept>
 #include <string>
+#include <thread>
 #include <tuple>
 #include <utility>
 #include <vector>
 
 #include "fmt/core.h"
 
+#include "cancellation.hpp"
+#include "gap_si_evaluator.hpp"
+#include "prescreen.hpp"
 #include "si_summary.hpp"
+#include "sis_set.hpp"
 #include "spectrum_data.hpp"
+#include "subband_fingerprints.hpp"
+#include "witness.hpp"
+#include "utils/count_set.hpp"
 
 namespace magnon::diagnose2 {
 
 namespace {
 
-constexpr const char *GAPLESS = "G";
-constexpr const char *TRIVIAL_OR_GAPLESS = "TorG";
-
 using GapRange = std::pair<int, int>;
-using Sis = std::vector<std::string>;
-using SisSet = std::set<Sis>;
-using SiToPossibs = std::map<std::string, std::set<int>>;
+using Sis = std::vector<PackedSi>;
 
 auto now() { return std::chrono::high_resolution_clock::now(); }
 auto as_seconds(const auto &duration) { return std::chrono::duration<double>(duration).count(); }
 
-std::string si_to_str(const MatrixInt &si) {
-    std::ostringstream result;
-    for (int i = 0; i < si.size(); ++i) {
-        result << si(i);
-    }
-    return result.str();
-}
+// The possible gap counts of each SI and the possible SIs of each gap, over the superband
+// orderings folded in so far. Unlike the SI sequences it is built from, its size does not grow
+// with the number of orderings.
+struct Possibilities {
+    long num_orderings = 0;
+    std::map<PackedSi, utils::CountSet> si_to_possibcounts;
+    std::map<int, std::set<PackedSi>> gap_to_possibsis;
 
-std::set<int> all_sums(const std::set<int> &a, const std::set<int> &b) {
-    assert(!a.empty());
-    assert(!b.empty());
+    // Fold in the gap brackets of one complete superband ordering, from gap 1 up to the
+    // (num_bands + 1, 0) sentinel.
+    void add_ordering(const std::vector<std::pair<GapRange, SisSet>> &gap_range_sis_set_pairs) {
+        assert(!gap_range_sis_set_pairs.empty());
+        assert(gap_range_sis_set_pairs.front().first.first == 1);
+        assert(gap_range_sis_set_pairs.back().first.second == 0);
 
-    std::set<int> result;
-    for (const auto &x : a) {
-        for (const auto &y : b) {
-            result.insert(x + y);
+        Possibilities ordering{.num_orderings = 1};
+        for (const auto &[gap_range, sis_set] : gap_range_sis_set_pairs) {
+            const auto &[gap_begin, gap_end] = gap_range;
+            for (const auto sis : sis_set) {
+                for (int gap = gap_begin; gap <= gap_end; ++gap) {
+                    ordering.gap_to_possibsis[gap].insert(sis[gap - gap_begin]);
+                }
+                for (const auto si : sis) {
+                    ordering.si_to_possibcounts.try_emplace(si);
+                }
+            }
         }
-    }
+        ordering.si_to_possibcounts.try_emplace(PackedSi::trivial_or_gapless());
+        ordering.si_to_possibcounts.try_emplace(PackedSi::gapless());
 
-    return result;
-}
+        for (auto &[key_si, possibcounts] : ordering.si_to_possibcounts) {
+            possibcounts = {0};
+            for (const auto &[gap_range, sis_set] : gap_range_sis_set_pairs) {
+                if (gap_range.second == 0) {  // finished super Hamiltonian
+                    continue;
+                }
 
-std::tuple<std::string, std::map<std::string, std::set<int>>, std::map<int, std::set<std::string>>>
-summarize(const std::vector<std::pair<GapRange, SisSet>> &gap_range_sis_set_pairs,
-          const int num_bands) {
-    std::map<int, std::set<std::string>> gap_to_possibsis;
-    for (const auto &[gap_range, sis_set] : gap_range_sis_set_pairs) {
-        const auto &[gap_begin, gap_end] = gap_range;
-        for (const auto &sis : sis_set) {
-            for (int gap = gap_begin; gap <= gap_end; ++gap) {
-                gap_to_possibsis[gap].insert(sis.at(gap - gap_begin));
+                utils::CountSet cur_possibcounts;
+
+                if (key_si == PackedSi::trivial_or_gapless()) {
+                    for (const auto sis : sis_set) {
+                        cur_possibcounts.insert(
+                            std::count_if(sis.begin(), sis.end(), [](const auto &si) {
+                                return si.is_gapless() || si.is_trivial();
+                            }));
+                    }
+                } else {
+                    for (const auto sis : sis_set) {
+                        cur_possibcounts.insert(std::count(sis.begin(), sis.end(), key_si));
+                    }
+                }
+
+                possibcounts = all_sums(possibcounts, cur_possibcounts);
             }
         }
+
+        merge(std::move(ordering));
     }
 
-    std::set<std::string> all_sis;
-    for (const auto &[gap_range, sis_set] : gap_range_sis_set_pairs) {
-        for (const auto &sis : sis_set) {
-            for (const auto &si : sis) {
-                all_sis.insert(si);
+    void merge(Possibilities &&other) {
+        // An SI missing from all the orderings on one side occurs 0 times in them.
+        if (other.num_orderings > 0) {
+            for (auto &[si, possibcounts] : si_to_possibcounts) {
+                if (!other.si_to_possibcounts.contains(si)) {
+                    possibcounts.insert(0);
+                }
+            }
+        }
+        for (auto &[si, other_possibcounts] : other.si_to_possibcounts) {
+            const auto [it, is_new] = si_to_possibcounts.try_emplace(si);
+            if (is_new && num_orderings > 0) {
+                it->second.insert(0);
             }
+            it->second.merge(other_possibcounts);
         }
+
+        for (auto &[gap, other_possibsis] : other.gap_to_possibsis) {
+            gap_to_possibsis[gap].merge(other_possibsis);
+        }
+
+        num_orderings += other.num_orderings;
     }
 
-    std::string trivial_si;
-    for (const auto &si : all_sis) {
-        if (std::all_of(si.begin(), si.end(), [](const char c) { return c == '0'; })) {
-            assert(!si.empty());
-            for (char c : si) {
-                assert(c == '0');
-            }
-            trivial_si = si;
-            break;
+    long num_entries() const {
+        long result = 0;
+        for (const auto &[_, possibcounts] : si_to_possibcounts) {
+            result += possibcounts.size();
+        }
+        for (const auto &[_, possibsis] : gap_to_possibsis) {
+            result += possibsis.size();
         }
+        return result;
     }
-    assert(!trivial_si.empty());
+};
 
-    all_sis.insert(TRIVIAL_OR_GAPLESS);
-    all_sis.insert(GAPLESS);
+using Summary = std::
+    tuple<std::string, std::map<std::string, std::set<int>>, std::map<int, std::set<std::string>>>;
 
-    std::map<std::string, std::set<int>> finalsi_to_possibcounts;
-    std::map<std::string, std::set<int>> si_to_possibcounts;
+// Convert the possibilities to the result representation. SIs are converted to strings only here.
+// Return nothing if `poll` is set and the search is cancelled meanwhile.
+std::optional<Summary> summarize(const Possibilities &possibilities,
+                                 const int num_bands,
+                                 const SiGroup &si_group,
+                                 CancellationPoll *poll) {
+    const auto should_stop = [poll]() { return poll != nullptr && poll->should_stop(); };
+    const auto &[_, finalsi_to_possibcounts, gap_to_possibsis] = possibilities;
 
-    for (const auto &[gap_range, sis_set] : gap_range_sis_set_pairs) {
-        const auto &[gap_begin, gap_end] = gap_range;
+    constexpr PackedSi trivial_si{0};
+    assert(finalsi_to_possibcounts.contains(trivial_si));
 
-        for (const auto &key_si : all_sis) {
-            if (gap_begin == 1) {  // started super Hamiltonian
-                si_to_possibcounts[key_si] = {0};
+    std::map<std::string, std::set<int>> finalsistr_to_possibcounts;
+    for (const auto &[si, possibcounts] : finalsi_to_possibcounts) {
+        if (si.is_trivial()) {
+            std::set<int> correct_trivial_counts;
+            for (const auto &incorrect_count : possibcounts) {
+                if (should_stop()) {
+                    return std::nullopt;
+                }
+                assert(incorrect_count >= 1);
+                correct_trivial_counts.insert(incorrect_count - 1);
             }
-            if (gap_end == 0) {  // finished super Hamiltonian
-                assert(gap_begin - 1 == num_bands);
+            finalsistr_to_possibcounts[si_group.to_string(si)] = correct_trivial_counts;
+        } else if (si == PackedSi::trivial_or_gapless()) {
+            std::set<int> gappednontrivial_possibcounts_exctopband;
+            for (auto count : possibcounts) {
+                if (should_stop()) {
+                    return std::nullopt;
+                }
+                assert(count >= 1);
+                gappednontrivial_possibcounts_exctopband.insert(num_bands - count);
+            }
+            finalsistr_to_possibcounts["nontrivial"] = gappednontrivial_possibcounts_exctopband;
+        } else if (si.is_gapless()) {
+            finalsistr_to_possibcounts["gapless"] = possibcounts.to_set();
+        } else {
+            finalsistr_to_possibcounts[si_group.to_string(si)] = possibcounts.to_set();
+        }
+    }
 
-                finalsi_to_possibcounts[key_si].insert(si_to_possibcounts.at(key_si).begin(),
-                                                       si_to_possibcounts.at(key_si).end());
-                si_to_possibcounts[key_si].clear();
-                continue;
+    std::map<int, std::set<std::string>> gap_to_possibsistrs;
+    for (const auto &[gap, possibsis] : gap_to_possibsis) {
+        for (const auto &si : possibsis) {
+            if (should_stop()) {
+                return std::nullopt;
             }
+            gap_to_possibsistrs[gap].insert(si_group.to_string(si));
+        }
+    }
 
-            std::set<int> cur_possibcounts;
+    return Summary{si_group.to_string(trivial_si), finalsistr_to_possibcounts, gap_to_possibsistrs};
+}
 
-            if (key_si == TRIVIAL_OR_GAPLESS) {
-                for (const auto &sis : sis_set) {
-                    cur_possibcounts.insert(
-                        std::count_if(sis.begin(), sis.end(), [&trivial_si](const auto &si) {
-                            return si == GAPLESS || si == trivial_si;
-                        }));
-                }
-            } else {
-                for (const auto &sis : sis_set) {
-                    cur_possibcounts.insert(std::count(sis.begin(), sis.end(), key_si));
+// Write the possible gap counts and SIs of `summary` to `result`, a `SearchResult` or its
+// `PartialResult`.
+void set_possibilities(const Summary &summary, auto &result) {
+    const auto &[trivial_si, si_to_possible_counts, gap_to_possibsis] = summary;
+
+    for (const auto &[si, possible_counts] : si_to_possible_counts) {
+        SearchResult::GapCounts gap_counts{};
+        for (const auto &gap_count : possible_counts) {
+            gap_counts.add_gap_count(gap_count);
+        }
+        (*result.mutable_si_to_possible_gap_count())[si] = gap_counts;
+    }
+
+    for (const auto &[gap, possible_sis] : gap_to_possibsis) {
+        SearchResult::SIs sis_proto{};
+        for (const auto &si : possible_sis) {
+            *sis_proto.add_si() = si;
+        }
+        (*result.mutable_gap_to_possible_si_values())[gap] = sis_proto;
+    }
+}
+
+// Most subband fingerprints remembered by a search, bounding their memory to some tens of MB
+constexpr std::size_t MAX_NUM_SUBBAND_FINGERPRINTS = 1 << 16;
+
+// Shared between the threads enumerating disjoint chunks of the superband orderings.
+struct SearchControl {
+    EnergeticsOrder energetics_order;
+    SearchMode mode;
+
+    // Cancelled once the time is up or the search is interrupted, which it reports as a timeout
+    Cancellation cancellation;
+    std::atomic<bool> type_i_excluded = false;
+
+    // Subbands of the superband orderings enumerated to the end
+    SubbandFingerprints subband_fingerprints{MAX_NUM_SUBBAND_FINGERPRINTS};
+
+    // Whether the search was found to be done, without checking the clock.
+    bool is_stopped() const {
+        return cancellation.is_cancelled() || type_i_excluded.load(std::memory_order_relaxed);
+    }
+    bool should_stop(CancellationPoll &poll) const {
+        return poll.should_stop() || type_i_excluded.load(std::memory_order_relaxed);
+    }
+};
+
+// What the enumeration of (a chunk of) the superband orderings has learned so far.
+struct EnumerationResult {
+    std::optional<SiSummary> final_lower, final_upper;
+    Possibilities possibilities;
+
+    // Largest number of SI sequences held for one ordering, and of entries in `possibilities`,
+    // whether of one chunk or merged from several
+    long peak_num_si_sequences = 0;
+    long peak_num_possibility_entries = 0;
+    // Energetics models of gap brackets evaluated
+    long num_models = 0;
+    // Superband orderings whose subband was looked up among those enumerated before, and the
+    // number skipped as it was found
+    long num_subband_lookups = 0;
+    long num_repeated_subbands = 0;
+
+    // Orderings left to enumerate when the enumeration stopped early, and their number
+    std::vector<SearchCheckpoint::PendingChunk> pending_chunks;
+    double num_pending_orderings = 0.0;
+
+    // First models found with the fewest and the most gapped nontrivial gaps
+    std::optional<SearchResult::Witness> min_nontrivial_witness, max_nontrivial_witness;
+
+    // Fold in the result of the chunk enumerated right after this one.
+    void merge(EnumerationResult &&next) {
+        if (!next.final_lower) {
+            assert(!next.final_upper);
+        } else if (!final_lower) {
+            final_lower = std::move(next.final_lower);
+            final_upper = std::move(next.final_upper);
+        } else {
+            final_lower->merge_lower_bound(*next.final_lower);
+            final_upper->merge_upper_bound(*next.final_upper);
+        }
+
+        possibilities.merge(std::move(next.possibilities));
+
+        peak_num_si_sequences = std::max(peak_num_si_sequences, next.peak_num_si_sequences);
+        peak_num_possibility_entries =
+            std::max({peak_num_possibility_entries,
+                      next.peak_num_possibility_entries,
+                      possibilities.num_entries()});
+        num_models += next.num_models;
+        num_subband_lookups += next.num_subband_lookups;
+        num_repeated_subbands += next.num_repeated_subbands;
+
+        std::move(next.pending_chunks.begin(),
+                  next.pending_chunks.end(),
+                  std::back_inserter(pending_chunks));
+        num_pending_orderings += next.num_pending_orderings;
+
+        // On ties, the witness found first in the serial enumeration order is kept.
+        if (next.min_nontrivial_witness &&
+            (!min_nontrivial_witness || next.min_nontrivial_witness->num_nontrivial_gaps() <
+                                            min_nontrivial_witness->num_nontrivial_gaps())) {
+            min_nontrivial_witness = std::move(next.min_nontrivial_witness);
+        }
+        if (next.max_nontrivial_witness &&
+            (!max_nontrivial_witness || next.max_nontrivial_witness->num_nontrivial_gaps() >
+                                            max_nontrivial_witness->num_nontrivial_gaps())) {
+            max_nontrivial_witness = std::move(next.max_nontrivial_witness);
+        }
+    }
+};
+
+// A run of superband orderings to enumerate: the ordering `superband` is at, and all the
+// orderings `Superband::cartesian_permute()` reaches from it.
+struct Chunk {
+    Superband superband;
+    // Set if the first ordering was partially enumerated before the search was checkpointed.
+    std::optional<SearchCheckpoint::OrderingProgress> progress;
+};
+
+using FirstGapToBound = std::map<int, std::optional<SiSummary>>;
+
+// Subgroup irrep indices of the submodes at each subgroup k-point, in energy order.
+using SubmodeIdxs = std::vector<std::vector<int>>;
+
+// The first models of a gap bracket realizing the trivial-or-gapless counts of its lower and
+// upper bounds. Outside the spans of the bracket and their mirror images, the submodes are in the
+// sorted order all the other brackets are in at the end of the ordering.
+struct BracketModels {
+    SubmodeIdxs lower, upper;
+};
+using FirstGapToModels = std::map<int, BracketModels>;
+
+// Overwrite `result`, reusing its storage.
+void copy_submode_idxs(const Subband &subband, SubmodeIdxs &result) {
+    const auto &subk_idx_to_e_idx_to_submode = subband.subk_idx_to_e_idx_to_submode;
+    result.resize(subk_idx_to_e_idx_to_submode.size());
+    for (std::size_t subk_idx = 0; subk_idx < result.size(); ++subk_idx) {
+        const auto &submodes = subk_idx_to_e_idx_to_submode[subk_idx];
+        result[subk_idx].resize(submodes.size());
+        std::transform(submodes.begin(),
+                       submodes.end(),
+                       result[subk_idx].begin(),
+                       [](const Submode &submode) { return submode.subirrep_idx; });
+    }
+}
+
+// The model of the current ordering of `superband` combining one model of each gap bracket, from
+// the ordering's finished `subband`, whose brackets are all back in sorted order.
+SearchResult::Witness combine_bracket_models(const Superband &superband,
+                                             const Subband &subband,
+                                             const FirstGapToModels &firstgap_to_models,
+                                             SubmodeIdxs BracketModels::*model,
+                                             const int num_nontrivial_gaps) {
+    SubmodeIdxs sorted;
+    copy_submode_idxs(subband, sorted);
+    SubmodeIdxs combined = sorted;
+    for (const auto &[_, models] : firstgap_to_models) {
+        const auto &bracket_model = models.*model;
+        assert(bracket_model.size() == sorted.size());
+        for (std::size_t subk_idx = 0; subk_idx < sorted.size(); ++subk_idx) {
+            for (std::size_t e_idx = 0; e_idx < sorted[subk_idx].size(); ++e_idx) {
+                if (bracket_model[subk_idx][e_idx] != sorted[subk_idx][e_idx]) {
+                    combined[subk_idx][e_idx] = bracket_model[subk_idx][e_idx];
                 }
             }
+        }
+    }
+
+    return make_witness(superband, combined, num_nontrivial_gaps);
+}
 
-            si_to_possibcounts[key_si] = all_sums(si_to_possibcounts.at(key_si), cur_possibcounts);
+void to_proto(const SubmodeIdxs &submode_idxs,
+              google::protobuf::RepeatedPtrField<SearchCheckpoint::IndexList> &result) {
+    for (const auto &subirrep_idxs : submode_idxs) {
+        auto &sub_k_point = *result.Add();
+        for (const auto subirrep_idx : subirrep_idxs) {
+            sub_k_point.add_idx(subirrep_idx);
         }
     }
+}
 
-    std::set<int> gappednontrivial_possibcounts_exctopband;
-    for (auto count : finalsi_to_possibcounts.at(TRIVIAL_OR_GAPLESS)) {
-        assert(count >= 1);
-        gappednontrivial_possibcounts_exctopband.insert(num_bands - count);
+SubmodeIdxs submode_idxs_from_proto(
+    const google::protobuf::RepeatedPtrField<SearchCheckpoint::IndexList> &sub_k_points,
+    const Subband &subband) {
+    const auto &subk_idx_to_e_idx_to_submode = subband.subk_idx_to_e_idx_to_submode;
+    if (sub_k_points.size() != static_cast<int>(subk_idx_to_e_idx_to_submode.size())) {
+        throw std::invalid_argument("Checkpoint holds no bracket models of the structure");
     }
-    finalsi_to_possibcounts["nontrivial"] = gappednontrivial_possibcounts_exctopband;
-    finalsi_to_possibcounts.erase(TRIVIAL_OR_GAPLESS);
+    SubmodeIdxs result;
+    for (int subk_idx = 0; subk_idx < sub_k_points.size(); ++subk_idx) {
+        const auto &idxs = sub_k_points[subk_idx].idx();
+        if (idxs.size() != static_cast<int>(subk_idx_to_e_idx_to_submode[subk_idx].size())) {
+            throw std::invalid_argument("Checkpoint holds a bracket model of another structure");
+        }
+        result.emplace_back(idxs.begin(), idxs.end());
+    }
+    return result;
+}
 
-    finalsi_to_possibcounts["gapless"] = finalsi_to_possibcounts.at(GAPLESS);
-    finalsi_to_possibcounts.erase(GAPLESS);
+SearchCheckpoint::SiHistogram to_proto(const SiSummary &summary) {
+    SearchCheckpoint::SiHistogram result{};
+    result.set_gapless_count(summary.get_gapless_count());
+    result.set_trivial_or_gapless_count(summary.get_trivialorgapless_count());
+    const auto &si_code_to_count = summary.get_si_code_to_count();
+    const auto &si_code_to_is_present = summary.get_si_code_to_is_present();
+    for (std::size_t si_code = 0; si_code < si_code_to_count.size(); ++si_code) {
+        result.add_si_count(si_code_to_is_present[si_code] ? si_code_to_count[si_code] : -1);
+    }
+    return result;
+}
 
-    std::set<int> correct_trivial_counts;
-    for (const auto &incorrect_count : finalsi_to_possibcounts.at(trivial_si)) {
-        assert(incorrect_count >= 1);
-        correct_trivial_counts.insert(incorrect_count - 1);
+SiSummary si_summary_from_proto(const SearchCheckpoint::SiHistogram &histogram,
+                                const SiGroup &si_group) {
+    if (histogram.si_count_size() != si_group.num_elements()) {
+        throw std::invalid_argument("Checkpoint SI histogram does not match the SI group");
+    }
+    std::vector<int> si_code_to_count;
+    std::vector<std::uint8_t> si_code_to_is_present;
+    for (const auto count : histogram.si_count()) {
+        si_code_to_count.push_back(std::max(count, 0));
+        si_code_to_is_present.push_back(count >= 0);
     }
-    finalsi_to_possibcounts.at(trivial_si) = correct_trivial_counts;
-    return {trivial_si, finalsi_to_possibcounts, gap_to_possibsis};
+    return SiSummary(histogram.gapless_count(),
+                     histogram.trivial_or_gapless_count(),
+                     std::move(si_code_to_count),
+                     std::move(si_code_to_is_present));
 }
 
-}  // namespace
+SearchCheckpoint::Possibilities to_proto(const Possibilities &possibilities) {
+    SearchCheckpoint::Possibilities result{};
+    result.set_num_orderings(possibilities.num_orderings);
+    for (const auto &[si, possibcounts] : possibilities.si_to_possibcounts) {
+        auto &si_gap_counts = *result.add_si_gap_counts();
+        si_gap_counts.set_si_code(si.code);
+        for (const auto count : possibcounts) {
+            si_gap_counts.add_gap_count(count);
+        }
+    }
+    for (const auto &[gap, possibsis] : possibilities.gap_to_possibsis) {
+        auto &gap_sis = *result.add_gap_sis();
+        gap_sis.set_gap(gap);
+        for (const auto si : possibsis) {
+            gap_sis.add_si_code(si.code);
+        }
+    }
+    return result;
+}
 
-SearchResult analyze_perturbation(const PerturbedBandStructure &structure, double timeout_s) {
-    const auto start_time = now();
-    SpectrumData data(structure);
-    SearchResult result{};
-    result.set_supergroup_label(structure.supergroup().label());
-    result.set_supergroup_number(structure.supergroup().number());
-    result.set_subgroup_label(structure.subgroup().label());
-    result.set_subgroup_number(structure.subgroup().number());
-    *result.mutable_supergroup_from_subgroup_basis() =
-        structure.group_subgroup_relation().supergroup_from_subgroup_standard_basis();
-    *result.mutable_atomic_orbital() = structure.unperturbed_band_structure().atomic_orbital();
+Possibilities possibilities_from_proto(const SearchCheckpoint::Possibilities &proto) {
+    Possibilities result{.num_orderings = proto.num_orderings()};
+    for (const auto &si_gap_counts : proto.si_gap_counts()) {
+        auto &possibcounts = result.si_to_possibcounts[PackedSi{si_gap_counts.si_code()}];
+        for (const auto count : si_gap_counts.gap_count()) {
+            possibcounts.insert(count);
+        }
+    }
+    for (const auto &gap_sis : proto.gap_sis()) {
+        auto &possibsis = result.gap_to_possibsis[gap_sis.gap()];
+        for (const auto si_code : gap_sis.si_code()) {
+            possibsis.insert(PackedSi{si_code});
+        }
+    }
+    return result;
+}
 
-    if (structure.subgroup().symmetry_indicator_order_size() == 0) {
-        result.set_is_negative_diagnosis(true);
-        return result;
+SearchCheckpoint::PendingChunk to_pending_chunk(const Superband &superband) {
+    SearchCheckpoint::PendingChunk result{};
+    for (const auto &supermodes : superband.k_idx_to_e_idx_to_supermode) {
+        auto &super_k_point = *result.add_super_k_point();
+        for (const auto &supermode : supermodes) {
+            super_k_point.add_idx(supermode.superirrep_idx);
+        }
     }
+    result.set_num_permuted_k_points(superband.num_permuted_k_points());
+    for (const auto &[step, is_reversed] : superband.get_k_point_walks()) {
+        result.add_walk_step(step);
+        result.add_walk_reversed(is_reversed);
+    }
+    return result;
+}
 
-    const auto &positive_energy_irreps = [&]() {
-        std::vector<std::string> result{};
-        for (const auto &irrep : structure.unperturbed_band_structure().supergroup_little_irrep()) {
-            result.push_back(irrep.label());
+// Restore the superband of a pending chunk, checking it against the unpermuted `initial` one.
+Superband superband_from_pending_chunk(const SearchCheckpoint::PendingChunk &pending_chunk,
+                                       const Superband &initial) {
+    Superband result = initial;
+    if (pending_chunk.super_k_point_size() !=
+        static_cast<int>(result.k_idx_to_e_idx_to_supermode.size())) {
+        throw std::invalid_argument("Checkpoint does not match the supergroup k-points");
+    }
+    for (int k_idx = 0; k_idx < pending_chunk.super_k_point_size(); ++k_idx) {
+        auto &supermodes = result.k_idx_to_e_idx_to_supermode[k_idx];
+        const auto &idxs = pending_chunk.super_k_point(k_idx).idx();
+        std::vector<int> expected_idxs;
+        for (const auto &supermode : supermodes) {
+            expected_idxs.push_back(supermode.superirrep_idx);
         }
-        return result;
-    }();
-    auto superband = Superband(positive_energy_irreps, data);
-    superband.fix_antiunit_rels();
+        if (!is_reordering(idxs, std::move(expected_idxs))) {
+            throw std::invalid_argument("Checkpoint does not match the supermodes");
+        }
+        for (int e_idx = 0; e_idx < idxs.size(); ++e_idx) {
+            supermodes[e_idx] = Supermode(idxs[e_idx], result.data);
+        }
+    }
+    if (pending_chunk.num_permuted_k_points() < 0 ||
+        pending_chunk.num_permuted_k_points() > result.num_permuted_k_points() ||
+        !result.satisfies_antiunit_rels()) {
+        throw std::invalid_argument("Checkpoint holds an invalid superband ordering");
+    }
+    result.fix_slowest_k_points(pending_chunk.num_permuted_k_points());
 
-    Subband subband = superband.make_subband();
+    Vector<std::pair<long, bool>> step_isreversed_pairs;
+    for (int i = 0; i < pending_chunk.walk_step_size() && i < pending_chunk.walk_reversed_size();
+         ++i) {
+        step_isreversed_pairs.emplace_back(pending_chunk.walk_step(i),
+                                           pending_chunk.walk_reversed(i));
+    }
+    if (pending_chunk.walk_step_size() != pending_chunk.walk_reversed_size() ||
+        !result.set_k_point_walks(step_isreversed_pairs)) {
+        throw std::invalid_argument(
+            "Checkpoint does not match the k-points, or was taken in another energetics order");
+    }
+    return result;
+}
 
-    bool type_i_excluded = false;
-    std::optional<SiSummary> final_lower, final_upper;
+SearchCheckpoint::OrderingProgress to_ordering_progress(
+    const Subband &subband,
+    const FirstGapToBound &firstgap_to_lower,
+    const FirstGapToBound &firstgap_to_upper,
+    const FirstGapToModels &firstgap_to_models,
+    const std::vector<std::pair<GapRange, SisSet>> &gap_range_and_sis_set_pairs) {
+    SearchCheckpoint::OrderingProgress result{};
+    for (const auto &submodes : subband.subk_idx_to_e_idx_to_submode) {
+        auto &sub_k_point = *result.add_sub_k_point();
+        for (const auto &submode : submodes) {
+            sub_k_point.add_idx(submode.subirrep_idx);
+        }
+    }
+    for (const auto &[gaps, allspanstopermute, done] : subband.gaps_allspanstopermute_done_tuples) {
+        result.add_bracket_done(done);
+    }
+    for (const auto &[step, is_reversed] : subband.get_span_walks()) {
+        result.add_span_step(step);
+        result.add_span_reversed(is_reversed);
+    }
+    for (const auto &[firstgap, lower] : firstgap_to_lower) {
+        auto &first_gap_bounds = *result.add_first_gap_bounds();
+        first_gap_bounds.set_first_gap(firstgap);
+        *first_gap_bounds.mutable_lower() = to_proto(lower.value());
+        *first_gap_bounds.mutable_upper() = to_proto(firstgap_to_upper.at(firstgap).value());
+        const auto &[lower_model, upper_model] = firstgap_to_models.at(firstgap);
+        to_proto(lower_model, *first_gap_bounds.mutable_lower_model_sub_k_point());
+        to_proto(upper_model, *first_gap_bounds.mutable_upper_model_sub_k_point());
+    }
+    for (const auto &[gap_range, sis_set] : gap_range_and_sis_set_pairs) {
+        auto &bracket = *result.add_bracket();
+        bracket.set_gap_begin(gap_range.first);
+        bracket.set_gap_end(gap_range.second);
+        for (const auto sis : sis_set) {
+            for (const auto si : sis) {
+                bracket.add_si_code(si.code);
+            }
+        }
+    }
+    return result;
+}
 
+// Restore the enumeration state of a partially enumerated ordering into the freshly made
+// `subband` of that ordering and the empty bookkeeping.
+void restore_ordering_progress(
+    const SearchCheckpoint::OrderingProgress &progress,
+    Subband &subband,
+    FirstGapToBound &firstgap_to_lower,
+    FirstGapToBound &firstgap_to_upper,
+    FirstGapToModels &firstgap_to_models,
+    std::vector<std::pair<GapRange, SisSet>> &gap_range_and_sis_set_pairs) {
+    auto &subk_idx_to_e_idx_to_submode = subband.subk_idx_to_e_idx_to_submode;
+    if (progress.sub_k_point_size() != static_cast<int>(subk_idx_to_e_idx_to_submode.size())) {
+        throw std::invalid_argument("Checkpoint does not match the subgroup k-points");
+    }
+    for (int subk_idx = 0; subk_idx < progress.sub_k_point_size(); ++subk_idx) {
+        auto &submodes = subk_idx_to_e_idx_to_submode[subk_idx];
+        const auto &idxs = progress.sub_k_point(subk_idx).idx();
+        std::vector<int> expected_idxs;
+        for (const auto &submode : submodes) {
+            expected_idxs.push_back(submode.subirrep_idx);
+        }
+        if (!is_reordering(idxs, std::move(expected_idxs))) {
+            throw std::invalid_argument("Checkpoint does not match the submodes");
+        }
+        // In place, as the gap brackets hold spans into the submodes.
+        std::copy(idxs.begin(), idxs.end(), submodes.begin());
+    }
+
+    auto &brackets = subband.gaps_allspanstopermute_done_tuples;
+    if (progress.bracket_done_size() != static_cast<int>(brackets.size())) {
+        throw std::invalid_argument("Checkpoint does not match the gap brackets");
+    }
+    for (std::size_t i = 0; i < brackets.size(); ++i) {
+        std::get<2>(brackets[i]) = progress.bracket_done(i);
+    }
+    Vector<std::pair<long, bool>> step_isreversed_pairs;
+    for (int i = 0; i < progress.span_step_size() && i < progress.span_reversed_size(); ++i) {
+        step_isreversed_pairs.emplace_back(progress.span_step(i), progress.span_reversed(i));
+    }
+    if (progress.span_step_size() != progress.span_reversed_size() ||
+        !subband.set_span_walks(step_isreversed_pairs)) {
+        throw std::invalid_argument(
+            "Checkpoint does not match the spans, or was taken in another energetics order");
+    }
+    if (!subband.satisfies_antiunit_rels()) {
+        throw std::invalid_argument("Checkpoint holds an invalid energetics model");
+    }
+
+    const auto &si_group = subband.get_data().sub_si_group;
+    for (const auto &first_gap_bounds : progress.first_gap_bounds()) {
+        firstgap_to_lower[first_gap_bounds.first_gap()] =
+            si_summary_from_proto(first_gap_bounds.lower(), si_group);
+        firstgap_to_upper[first_gap_bounds.first_gap()] =
+            si_summary_from_proto(first_gap_bounds.upper(), si_group);
+        firstgap_to_models[first_gap_bounds.first_gap()] = {
+            .lower = submode_idxs_from_proto(first_gap_bounds.lower_model_sub_k_point(), subband),
+            .upper = submode_idxs_from_proto(first_gap_bounds.upper_model_sub_k_point(), subband)};
+    }
+
+    Sis sis;
+    for (const auto &bracket : progress.bracket()) {
+        const int width = std::max(0, bracket.gap_end() - bracket.gap_begin() + 1);
+        auto &sis_set =
+            gap_range_and_sis_set_pairs
+                .emplace_back(GapRange{bracket.gap_begin(), bracket.gap_end()}, SisSet(width))
+                .second;
+        if (width == 0 ? bracket.si_code_size() != 0 : bracket.si_code_size() % width != 0) {
+            throw std::invalid_argument("Checkpoint holds a truncated SI sequence");
+        }
+        for (int begin = 0; begin < bracket.si_code_size(); begin += width) {
+            sis.clear();
+            for (int i = begin; i < begin + width; ++i) {
+                sis.push_back(PackedSi{bracket.si_code(i)});
+            }
+            sis_set.insert(sis);
+        }
+    }
+}
+
+// Advance `superband` to its next ordering and bring `subband` in line with it.
+bool next_superband_ordering(Superband &superband, Subband &subband) {
+    if (!superband.cartesian_permute()) {
+        return false;
+    }
+    subband.rebase(superband, superband.last_changed_k_idx());
+    return true;
+}
+
+// Enumerate all the energetics models of all the superband orderings of `chunk`, the `chunk_idx`th
+// in enumeration order. If the enumeration stops early, the orderings left are recorded in
+// `result.pending_chunks`.
+void enumerate_superband_orderings(const Chunk &chunk,
+                                   const long chunk_idx,
+                                   EnumerationResult &result,
+                                   SearchControl &control) {
+    // Chunks reached after the search stopped are left as they are, which is much quicker than
+    // building their subbands when there are many of them.
+    if (control.is_stopped()) {
+        auto &pending_chunk = result.pending_chunks.emplace_back(to_pending_chunk(chunk.superband));
+        if (chunk.progress) {
+            *pending_chunk.mutable_ordering_progress() = *chunk.progress;
+        }
+        result.num_pending_orderings +=
+            chunk.superband.num_orderings() - chunk.superband.ordering_rank();
+        return;
+    }
+
+    auto &final_lower = result.final_lower;
+    auto &final_upper = result.final_upper;
+
+    Superband superband = chunk.superband;
+    Subband subband = superband.make_subband();
+    subband.set_energetics_order(control.energetics_order);
+
+    // The gap brackets of the current ordering, folded into `result.possibilities` as soon as the
+    // ordering is complete.
     std::vector<std::pair<GapRange, SisSet>> gap_range_and_sis_set_pairs;
-    result.set_is_timeout(false);
-    long counter = 0;
+    FirstGapToBound firstgap_to_lower, firstgap_to_upper;
+    FirstGapToModels firstgap_to_models;
+    // Whether the bookkeeping above holds models of the current ordering
+    bool is_ordering_started = false;
+
+    if (chunk.progress) {
+        restore_ordering_progress(*chunk.progress,
+                                  subband,
+                                  firstgap_to_lower,
+                                  firstgap_to_upper,
+                                  firstgap_to_models,
+                                  gap_range_and_sis_set_pairs);
+        is_ordering_started = true;
+    }
+
+    const auto save_pending_chunk = [&]() {
+        result.num_pending_orderings += superband.num_orderings() - superband.ordering_rank();
+        auto &pending_chunk = result.pending_chunks.emplace_back(to_pending_chunk(superband));
+        if (is_ordering_started) {
+            *pending_chunk.mutable_ordering_progress() =
+                to_ordering_progress(subband,
+                                     firstgap_to_lower,
+                                     firstgap_to_upper,
+                                     firstgap_to_models,
+                                     gap_range_and_sis_set_pairs);
+        }
+    };
+
+    const bool is_diagnosis_only = control.mode == SearchMode::DiagnosisOnly;
+    // Reused for every model, so that the loop does not allocate.
+    const auto &si_group = superband.data.sub_si_group;
+    SiSummary cur(si_group), cur_lower(si_group), cur_upper(si_group);
+    Sis sis;
+    CancellationPoll poll(control.cancellation);
     do {
+        if (control.should_stop(poll)) {
+            save_pending_chunk();
+            return;
+        }
 
         assert(superband.satisfies_antiunit_rels());
 
-        Subband subband = superband.make_subband();
-        std::map<int, std::optional<SiSummary>> firstgap_to_lower, firstgap_to_upper;
+        // An ordering with the subband of one enumerated before has the same models, and adds
+        // nothing to the bounds, the possibilities or the witnesses.
+        std::optional<Vector<int>> fingerprint;
+        if (!is_ordering_started) {
+            fingerprint = make_fingerprint(subband);
+            ++result.num_subband_lookups;
+            if (control.subband_fingerprints.contains(*fingerprint, chunk_idx)) {
+                ++result.num_repeated_subbands;
+                continue;
+            }
+        }
+
+        GapSiEvaluator gap_si_evaluator(subband);
+        // Set once the models of the current bracket can no longer change the diagnosis.
+        bool is_bracket_settled = false;
         do {
-            ++counter;
-            if (counter % 1000 == 0) {
-                if (timeout_s > 0.0) {
-                    if (as_seconds(now() - start_time) > timeout_s) {
-                        result.set_is_timeout(true);
-                        type_i_excluded = true;
-                        break;
-                    }
-                }
+            is_bracket_settled = false;
+            if (control.should_stop(poll)) {
+                save_pending_chunk();
+                return;
             }
             assert(subband.satisfies_antiunit_rels());
 
@@ -215,44 +750,79 @@ SearchResult analyze_perturbation(const PerturbedBandStructure &structure, doubl
             }
 
             GapRange cur_gap_range{gap_bracket_begin, gap_bracket_end};
-            if (gap_range_and_sis_set_pairs.empty() ||
-                gap_range_and_sis_set_pairs.back().first != cur_gap_range) {
-                gap_range_and_sis_set_pairs.emplace_back(cur_gap_range, SisSet{});
+            if (!is_diagnosis_only && (gap_range_and_sis_set_pairs.empty() ||
+                                       gap_range_and_sis_set_pairs.back().first != cur_gap_range)) {
+                gap_range_and_sis_set_pairs.emplace_back(
+                    cur_gap_range, SisSet(std::max(0, gap_bracket_end - gap_bracket_begin + 1)));
             }
 
             if (gap_bracket_end >= gap_bracket_begin) {
                 assert(gap_bracket_end >= gap_bracket_begin);
-                const auto gap_to_isgapped_and_si = subband.calc_gap_sis();
-                SiSummary cur;
-
-                Sis sis;
-                for (int gap = gap_bracket_begin; gap <= gap_bracket_end; ++gap) {
-                    const auto &[is_gapped, si] = gap_to_isgapped_and_si.at(gap);
+                const auto &bracket_isgapped_and_sis = gap_si_evaluator.evaluate(
+                    gap_bracket_begin, gap_bracket_end, subband.last_changes());
+                ++result.num_models;
+                cur.clear();
 
+                sis.clear();
+                SisSet::Hash sis_hash = SisSet::EMPTY_HASH;
+                for (const auto &[is_gapped, si] : bracket_isgapped_and_sis) {
                     if (is_gapped) {
                         cur.increment_si(si);
-                        sis.push_back(si_to_str(si));
+                        sis.push_back(si);
                     } else {
                         cur.increment_gapless();
-                        sis.push_back(GAPLESS);
+                        sis.push_back(PackedSi::gapless());
                     }
+                    sis_hash = SisSet::extend_hash(sis_hash, sis.back());
+                }
+                if (!is_diagnosis_only) {
+                    gap_range_and_sis_set_pairs.back().second.insert(sis, sis_hash);
                 }
-                gap_range_and_sis_set_pairs.back().second.insert(sis);
 
                 auto &partial_lower = firstgap_to_lower[gap_bracket_begin];
                 auto &partial_upper = firstgap_to_upper[gap_bracket_begin];
+                auto &models = firstgap_to_models[gap_bracket_begin];
 
                 if (!partial_lower) {
                     assert(!partial_upper);
                     partial_lower = cur;
                     partial_upper = cur;
+                    copy_submode_idxs(subband, models.lower);
+                    copy_submode_idxs(subband, models.upper);
+                } else if (cur.get_trivialorgapless_count() <
+                           partial_lower->get_trivialorgapless_count()) {
+                    copy_submode_idxs(subband, models.lower);
+                } else if (cur.get_trivialorgapless_count() >
+                           partial_upper->get_trivialorgapless_count()) {
+                    copy_submode_idxs(subband, models.upper);
                 }
 
-                partial_lower = SiSummary::lower_bound(cur, *partial_lower);
-                partial_upper = SiSummary::upper_bound(cur, *partial_upper);
+                partial_lower->merge_lower_bound(cur);
+                partial_upper->merge_upper_bound(cur);
+
+                // Once all the gaps of the bracket were trivial or gapless, no later model of it
+                // can raise the upper bound, which is all that decides the diagnosis.
+                is_bracket_settled = is_diagnosis_only &&
+                                     partial_upper->get_trivialorgapless_count() ==
+                                         gap_bracket_end - gap_bracket_begin + 1;
 
             } else {  // Reached last gap
-                SiSummary cur_lower, cur_upper;
+                if (!is_diagnosis_only) {
+                    long num_si_sequences = 0;
+                    for (const auto &[_, sis_set] : gap_range_and_sis_set_pairs) {
+                        num_si_sequences += sis_set.size();
+                    }
+                    result.peak_num_si_sequences =
+                        std::max(result.peak_num_si_sequences, num_si_sequences);
+
+                    result.possibilities.add_ordering(gap_range_and_sis_set_pairs);
+                    gap_range_and_sis_set_pairs.clear();
+                    result.peak_num_possibility_entries = std::max(
+                        result.peak_num_possibility_entries, result.possibilities.num_entries());
+                }
+
+                cur_lower.clear();
+                cur_upper.clear();
                 for (const auto &[firstgap, si_summary] : firstgap_to_lower) {
                     cur_lower += si_summary.value();
                 }
@@ -267,51 +837,431 @@ SearchResult analyze_perturbation(const PerturbedBandStructure &structure, doubl
                 }
                 assert(final_upper);
 
-                final_lower = SiSummary::lower_bound(cur_lower, *final_lower);
-                final_upper = SiSummary::upper_bound(cur_upper, *final_upper);
+                final_lower->merge_lower_bound(cur_lower);
+                final_upper->merge_upper_bound(cur_upper);
+
+                // Settled brackets leave the lower bounds, and so the witnesses, incomplete.
+                const int num_bands = subband.get_num_bands();
+                const int min_nontrivial = num_bands - cur_upper.get_trivialorgapless_count();
+                const int max_nontrivial = num_bands - cur_lower.get_trivialorgapless_count();
+                auto &min_witness = result.min_nontrivial_witness;
+                auto &max_witness = result.max_nontrivial_witness;
+                if (!is_diagnosis_only &&
+                    (!min_witness || min_nontrivial < min_witness->num_nontrivial_gaps())) {
+                    min_witness = combine_bracket_models(superband,
+                                                         subband,
+                                                         firstgap_to_models,
+                                                         &BracketModels::upper,
+                                                         min_nontrivial);
+                }
+                if (!is_diagnosis_only &&
+                    (!max_witness || max_nontrivial > max_witness->num_nontrivial_gaps())) {
+                    max_witness = combine_bracket_models(superband,
+                                                         subband,
+                                                         firstgap_to_models,
+                                                         &BracketModels::lower,
+                                                         max_nontrivial);
+                }
 
                 if (final_upper->get_trivialorgapless_count() >= subband.get_num_bands()) {
                     assert(final_upper->get_trivialorgapless_count() == subband.get_num_bands());
-                    type_i_excluded = true;
-                    break;
+                    control.type_i_excluded = true;
+                    return;
                 }
             }
+            is_ordering_started = true;
+
+        } while (is_bracket_settled ? subband.skip_bracket() : subband.next_energetics());
+
+        if (fingerprint) {
+            control.subband_fingerprints.insert(std::move(*fingerprint), chunk_idx);
+        }
+        firstgap_to_lower.clear();
+        firstgap_to_upper.clear();
+        firstgap_to_models.clear();
+        is_ordering_started = false;
+    } while (next_superband_ordering(superband, subband));
+}
+
+// Enumerate the chunks on `num_threads` threads and fold their results into `result`. Chunks are
+// handed out on demand, so that threads finishing cheap chunks pick up the remaining work, and the
+// chunk results are merged in the serial enumeration order.
+void enumerate_chunks(const std::vector<Chunk> &chunks,
+                      const int num_threads,
+                      SearchControl &control,
+                      EnumerationResult &result) {
+    std::vector<EnumerationResult> chunk_results(chunks.size());
+    if (num_threads <= 1) {
+        for (std::size_t chunk_idx = 0; chunk_idx < chunks.size(); ++chunk_idx) {
+            enumerate_superband_orderings(
+                chunks[chunk_idx], chunk_idx, chunk_results[chunk_idx], control);
+        }
+    } else {
+        std::atomic<std::size_t> next_chunk_idx = 0;
+        std::vector<std::jthread> threads;
+        for (int i = 0; i < std::min<int>(num_threads, chunks.size()); ++i) {
+            threads.emplace_back([&]() {
+                for (auto chunk_idx = next_chunk_idx++; chunk_idx < chunks.size();
+                     chunk_idx = next_chunk_idx++) {
+                    enumerate_superband_orderings(
+                        chunks[chunk_idx], chunk_idx, chunk_results[chunk_idx], control);
+                }
+            });
+        }
+    }
+
+    for (auto &chunk_result : chunk_results) {
+        result.merge(std::move(chunk_result));
+    }
+}
+
+// Split the orderings of the unpermuted `superband` into chunks for `num_threads` threads.
+std::vector<Chunk> make_chunks(const Superband &superband, const int num_threads) {
+    if (num_threads <= 1) {
+        return {Chunk{superband, std::nullopt}};
+    }
+
+    // Several chunks per thread keep the threads busy when chunk costs are uneven.
+    constexpr int CHUNKS_PER_THREAD = 16;
+    std::vector<Chunk> result;
+    for (auto &chunk_superband : superband.split(CHUNKS_PER_THREAD * num_threads)) {
+        result.push_back(Chunk{std::move(chunk_superband), std::nullopt});
+    }
+    return result;
+}
+
+SearchCheckpoint make_checkpoint(const PerturbedBandStructure &structure,
+                                 const SearchOptions &options,
+                                 const EnumerationResult &enumeration_result) {
+    SearchCheckpoint result{};
+    result.set_supergroup_number(structure.supergroup().number());
+    result.set_subgroup_number(structure.subgroup().number());
+    result.set_is_diagnosis_only(options.mode == SearchMode::DiagnosisOnly);
+    result.set_ordering_strategy(static_cast<int>(options.ordering_strategy));
+    for (const auto &pending_chunk : enumeration_result.pending_chunks) {
+        *result.add_pending_chunk() = pending_chunk;
+    }
+    if (enumeration_result.final_lower) {
+        *result.mutable_final_lower() = to_proto(*enumeration_result.final_lower);
+        *result.mutable_final_upper() = to_proto(*enumeration_result.final_upper);
+    }
+    *result.mutable_possibilities() = to_proto(enumeration_result.possibilities);
+    result.set_peak_num_si_sequences(enumeration_result.peak_num_si_sequences);
+    result.set_peak_num_possibility_entries(enumeration_result.peak_num_possibility_entries);
+    result.set_num_models(enumeration_result.num_models);
+    result.set_num_subband_lookups(enumeration_result.num_subband_lookups);
+    result.set_num_repeated_subbands(enumeration_result.num_repeated_subbands);
+    if (enumeration_result.min_nontrivial_witness) {
+        *result.mutable_min_nontrivial_witness() = *enumeration_result.min_nontrivial_witness;
+        *result.mutable_max_nontrivial_witness() = *enumeration_result.max_nontrivial_witness;
+    }
+    return result;
+}
+
+// Restore the progress and the pending chunks of `checkpoint`, checking them against the
+// unpermuted `superband` of the structure and the search mode and ordering strategy.
+std::pair<EnumerationResult, std::vector<Chunk>> restore_checkpoint(
+    const SearchCheckpoint &checkpoint,
+    const PerturbedBandStructure &structure,
+    const Superband &superband,
+    const SearchOptions &options) {
+    if (checkpoint.supergroup_number() != structure.supergroup().number() ||
+        checkpoint.subgroup_number() != structure.subgroup().number()) {
+        throw std::invalid_argument(fmt::format(
+            "Checkpoint of the {} -> {} perturbation cannot resume the {} -> {} perturbation",
+            checkpoint.supergroup_number(),
+            checkpoint.subgroup_number(),
+            structure.supergroup().number(),
+            structure.subgroup().number()));
+    }
+    const bool is_diagnosis_only = options.mode == SearchMode::DiagnosisOnly;
+    if (checkpoint.is_diagnosis_only() != is_diagnosis_only) {
+        throw std::invalid_argument("Checkpoint was taken in another search mode");
+    }
+    if (checkpoint.ordering_strategy() != static_cast<int>(options.ordering_strategy)) {
+        throw std::invalid_argument("Checkpoint was taken with another ordering strategy");
+    }
+    if (checkpoint.has_final_lower() != checkpoint.has_final_upper() ||
+        (!is_diagnosis_only &&
+         (checkpoint.has_final_lower() != checkpoint.has_min_nontrivial_witness() ||
+          checkpoint.has_final_lower() != checkpoint.has_max_nontrivial_witness()))) {
+        throw std::invalid_argument("Checkpoint holds only some of the SI bounds and witnesses");
+    }
 
-        } while (subband.next_energetics());
-    } while (!type_i_excluded && superband.cartesian_permute());
+    const auto &si_group = superband.data.sub_si_group;
+    EnumerationResult enumeration_result{};
+    if (checkpoint.has_final_lower()) {
+        enumeration_result.final_lower = si_summary_from_proto(checkpoint.final_lower(), si_group);
+        enumeration_result.final_upper = si_summary_from_proto(checkpoint.final_upper(), si_group);
+    }
+    if (checkpoint.has_min_nontrivial_witness()) {
+        enumeration_result.min_nontrivial_witness = checkpoint.min_nontrivial_witness();
+        enumeration_result.max_nontrivial_witness = checkpoint.max_nontrivial_witness();
+    }
+    enumeration_result.possibilities = possibilities_from_proto(checkpoint.possibilities());
+    enumeration_result.peak_num_si_sequences = checkpoint.peak_num_si_sequences();
+    enumeration_result.peak_num_possibility_entries = checkpoint.peak_num_possibility_entries();
+    enumeration_result.num_models = checkpoint.num_models();
+    enumeration_result.num_subband_lookups = checkpoint.num_subband_lookups();
+    enumeration_result.num_repeated_subbands = checkpoint.num_repeated_subbands();
+
+    std::vector<Chunk> chunks;
+    for (const auto &pending_chunk : checkpoint.pending_chunk()) {
+        auto &chunk = chunks.emplace_back(
+            Chunk{superband_from_pending_chunk(pending_chunk, superband), std::nullopt});
+        if (pending_chunk.has_ordering_progress()) {
+            chunk.progress = pending_chunk.ordering_progress();
+        }
+    }
+    return {std::move(enumeration_result), std::move(chunks)};
+}
+
+}  // namespace
+
+SearchResult analyze_perturbation(const PerturbedBandStructure &structure, double timeout_s) {
+    return analyze_perturbation(structure, SearchOptions{.timeout_s = timeout_s});
+}
+
+SearchResult analyze_perturbation(const PerturbedBandStructure &structure,
+                                  const SearchOptions &options) {
+    const auto start_time = now();
+    // Timeouts beyond the range of the clock never expire.
+    std::optional<Cancellation::Clock::time_point> deadline;
+    if (const std::chrono::duration<double> timeout(options.timeout_s);
+        options.timeout_s > 0.0 && timeout < Cancellation::Clock::duration::max() / 2) {
+        deadline = Cancellation::Clock::now() +
+                   std::chrono::duration_cast<Cancellation::Clock::duration>(timeout);
+    }
+    SpectrumData data(structure);
+    SearchResult result{};
+    result.set_supergroup_label(structure.supergroup().label());
+    result.set_supergroup_number(structure.supergroup().number());
+    result.set_subgroup_label(structure.subgroup().label());
+    result.set_subgroup_number(structure.subgroup().number());
+    *result.mutable_supergroup_from_subgroup_basis() =
+        structure.group_subgroup_relation().supergroup_from_subgroup_standard_basis();
+    *result.mutable_atomic_orbital() = structure.unperturbed_band_structure().atomic_orbital();
+
+    if (structure.subgroup().symmetry_indicator_order_size() == 0) {
+        result.set_is_negative_diagnosis(true);
+        return result;
+    }
+
+    const auto &positive_energy_irreps = [&]() {
+        std::vector<std::string> result{};
+        for (const auto &irrep : structure.unperturbed_band_structure().supergroup_little_irrep()) {
+            result.push_back(irrep.label());
+        }
+        return result;
+    }();
+    std::optional<SearchKey> cache_key;
+    if (options.cache != nullptr) {
+        cache_key = make_search_key(
+            data, positive_energy_irreps, options.energetics_order, options.ordering_strategy);
+        if (const auto cached_result = options.cache->find(*cache_key)) {
+            result.MergeFrom(*cached_result);
+            result.mutable_metadata()->set_is_cached(true);
+            result.mutable_metadata()->set_compute_time_s(as_seconds(now() - start_time));
+            return result;
+        }
+    }
+
+    auto superband = Superband(positive_energy_irreps, data);
+    superband.set_ordering_strategy(options.ordering_strategy);
+    superband.set_energetics_order(options.energetics_order);
+
+    Subband subband = superband.make_subband();
+
+    SearchControl control{
+        .energetics_order = options.energetics_order,
+        .mode = options.mode,
+        .cancellation = Cancellation(deadline, options.interrupt, options.stop_token)};
+    auto [enumeration_result, chunks] =
+        options.resume_from != nullptr
+            ? restore_checkpoint(*options.resume_from, structure, superband, options)
+            : std::pair{EnumerationResult{}, make_chunks(superband, options.num_threads)};
+    const bool is_excluded_by_prescreen =
+        options.num_prescreen_orderings > 0 &&
+        find_exclusion_witness(superband,
+                               options.num_prescreen_orderings,
+                               options.num_threads,
+                               /*seed=*/0,
+                               control.cancellation);
+    if (is_excluded_by_prescreen) {
+        control.type_i_excluded = true;
+    } else {
+        enumerate_chunks(chunks, options.num_threads, control, enumeration_result);
+    }
+    const auto &final_lower = enumeration_result.final_lower;
+    const auto &final_upper = enumeration_result.final_upper;
+
+    // An exclusion found by any thread is conclusive, even if another one ran out of time.
+    const bool type_i_excluded = control.type_i_excluded;
+    std::optional<Summary> summary;
+    if (!type_i_excluded && !control.cancellation.is_cancelled() &&
+        options.mode == SearchMode::Full) {
+        // A search resumed with only the summary left runs it to the end, so that it advances.
+        CancellationPoll poll(control.cancellation);
+        summary = summarize(enumeration_result.possibilities,
+                            subband.get_num_bands(),
+                            data.sub_si_group,
+                            chunks.empty() ? nullptr : &poll);
+    }
 
     result.mutable_metadata()->set_compute_time_s(as_seconds(now() - start_time));
+    result.mutable_metadata()->set_peak_num_si_sequences(enumeration_result.peak_num_si_sequences);
+    result.mutable_metadata()->set_peak_num_possibility_entries(
+        enumeration_result.peak_num_possibility_entries);
+    result.mutable_metadata()->set_num_models(enumeration_result.num_models);
+    if (enumeration_result.num_subband_lookups > 0) {
+        result.mutable_metadata()->set_num_repeated_subbands(
+            enumeration_result.num_repeated_subbands);
+        result.mutable_metadata()->set_repeated_subband_fraction(
+            static_cast<double>(enumeration_result.num_repeated_subbands) /
+            enumeration_result.num_subband_lookups);
+    }
 
+    // Without an exclusion, the search only gets cancelled with orderings or the summary left.
+    result.set_is_timeout(!type_i_excluded && control.cancellation.is_cancelled());
     if (result.is_timeout()) {
+        // The bounds and possibilities of the completed orderings are those of some models, and
+        // remain valid however the search would go on.
+        const int num_bands = subband.get_num_bands();
+        auto &partial_result = *result.mutable_partial_result();
+        const double num_orderings = superband.num_orderings();
+        partial_result.set_ordering_fraction(
+            (num_orderings - enumeration_result.num_pending_orderings) / num_orderings);
+        if (final_upper) {
+            partial_result.set_min_nontrivial_gap_count(
+                num_bands - final_upper->get_trivialorgapless_count());
+            partial_result.set_max_nontrivial_gap_count(
+                num_bands - final_lower->get_trivialorgapless_count());
+        }
+        if (enumeration_result.possibilities.num_orderings > 0) {
+            set_possibilities(*summarize(enumeration_result.possibilities,
+                                         num_bands,
+                                         data.sub_si_group,
+                                         nullptr),
+                              partial_result);
+        }
+
+        if (options.checkpoint != nullptr) {
+            *options.checkpoint = make_checkpoint(structure, options, enumeration_result);
+        }
         return result;
     }
 
     if (type_i_excluded) {
         result.set_is_negative_diagnosis(true);
+        result.mutable_metadata()->set_is_excluded_by_prescreen(is_excluded_by_prescreen);
+    } else if (options.mode == SearchMode::DiagnosisOnly) {
+        result.set_is_negative_diagnosis(false);
+        result.mutable_metadata()->set_is_diagnosis_only(true);
     } else {
         result.set_is_negative_diagnosis(false);
         assert(final_lower);
         assert(final_upper);
-        const auto [trivial_si, si_to_possible_counts, gap_to_possibsis] =
-            summarize(gap_range_and_sis_set_pairs, subband.get_num_bands());
+        assert(summary);
+        set_possibilities(*summary, result);
 
-        for (const auto &[si, possible_counts] : si_to_possible_counts) {
-            SearchResult::GapCounts gap_counts{};
-            for (const auto &gap_count : possible_counts) {
-                gap_counts.add_gap_count(gap_count);
+        assert(enumeration_result.min_nontrivial_witness);
+        assert(enumeration_result.max_nontrivial_witness);
+        *result.mutable_min_nontrivial_witness() = *enumeration_result.min_nontrivial_witness;
+        *result.mutable_max_nontrivial_witness() = *enumeration_result.max_nontrivial_witness;
+    }
+
+    // A negative diagnosis is the same in both modes, but only a full search finds the tables.
+    if (cache_key && !result.metadata().is_diagnosis_only()) {
+        options.cache->insert(*cache_key, result);
+    }
+    return result;
+}
+
+std::vector<SearchResult> analyze_perturbations(std::span<const PerturbedBandStructure> structures,
+                                                const BatchOptions &options) {
+    assert(options.search_options.resume_from == nullptr);
+    assert(options.search_options.checkpoint == nullptr);
+    if ((!options.resume_from.empty() && options.resume_from.size() != structures.size()) ||
+        (!options.checkpoints.empty() && options.checkpoints.size() != structures.size())) {
+        throw std::invalid_argument("Batch checkpoints are not sized like the structures");
+    }
+    if (!options.stop_tokens.empty() && options.stop_tokens.size() != structures.size()) {
+        throw std::invalid_argument("Batch stop tokens are not sized like the structures");
+    }
+
+    const auto search = [&](const std::size_t idx) {
+        SearchOptions search_options = options.search_options;
+        if (!options.resume_from.empty()) {
+            search_options.resume_from = options.resume_from[idx];
+        }
+        if (!options.checkpoints.empty()) {
+            search_options.checkpoint = &options.checkpoints[idx];
+        }
+        if (!options.stop_tokens.empty()) {
+            search_options.stop_token = options.stop_tokens[idx];
+        }
+        return analyze_perturbation(structures[idx], search_options);
+    };
+
+    std::vector<SearchResult> results(structures.size());
+    if (options.num_jobs <= 1) {
+        for (std::size_t idx = 0; idx < structures.size(); ++idx) {
+            results[idx] = search(idx);
+            if (options.on_result) {
+                options.on_result(idx, results[idx]);
             }
-            (*result.mutable_si_to_possible_gap_count())[si] = gap_counts;
         }
+        return results;
+    }
+
+    // Guards `is_done` and `errors`, and is notified whenever a search finishes.
+    std::mutex mutex;
+    std::condition_variable done;
+    std::vector<bool> is_done(structures.size(), false);
+    std::vector<std::exception_ptr> errors(structures.size());
+    // Set on the first error, after which no more searches are started.
+    std::atomic<bool> is_failed = false;
 
-        for (const auto &[gap, possible_sis] : gap_to_possibsis) {
-            SearchResult::SIs sis_proto{};
-            for (const auto &si : possible_sis) {
-                *sis_proto.add_si() = si;
+    std::atomic<std::size_t> next_idx = 0;
+    std::vector<std::jthread> threads;
+    for (int i = 0; i < std::min<int>(options.num_jobs, structures.size()); ++i) {
+        threads.emplace_back([&]() {
+            for (auto idx = next_idx++; idx < structures.size() && !is_failed; idx = next_idx++) {
+                std::exception_ptr error;
+                try {
+                    results[idx] = search(idx);
+                } catch (...) {
+                    error = std::current_exception();
+                    is_failed = true;
+                }
+                {
+                    const std::lock_guard lock(mutex);
+                    is_done[idx] = true;
+                    errors[idx] = error;
+                }
+                done.notify_all();
+            }
+        });
+    }
+
+    // Structures are handed out in input order, so all the ones before a failed one are searched.
+    try {
+        for (std::size_t idx = 0; idx < structures.size(); ++idx) {
+            std::unique_lock lock(mutex);
+            done.wait(lock, [&]() { return is_done[idx]; });
+            if (errors[idx]) {
+                std::rethrow_exception(errors[idx]);
+            }
+            lock.unlock();
+            if (options.on_result) {
+                options.on_result(idx, results[idx]);
             }
-            (*result.mutable_gap_to_possible_si_values())[gap] = sis_proto;
         }
+    } catch (...) {
+        is_failed = true;
+        throw;
     }
-    return result;
+    return results;
 }
 
 }  // namespace magnon::diagnose2
@@ -1,10 +1,96 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <span>
+#include <stop_token>
+#include <vector>
+
 #include "diagnose2/perturbed_band_structure.pb.h"
+#include "diagnose2/search_cache.hpp"
+#include "diagnose2/search_checkpoint.pb.h"
 #include "diagnose2/search_result.pb.h"
+#include "diagnose2/spectrum_data.hpp"
 
 namespace magnon::diagnose2 {
 
+enum class SearchMode {
+    // Decide the diagnosis, and for a positive one collect the possible gap counts and SIs and the
+    // witnesses.
+    Full,
+    // Only decide the diagnosis. Much quicker, as the SIs of the gaps are not collected, and the
+    // energetics of a gap bracket are no longer enumerated once all its gaps can be trivial.
+    DiagnosisOnly,
+};
+
+struct SearchOptions {
+    // Give up the search after this many seconds. Non-positive values disable the timeout.
+    double timeout_s = 0.0;
+
+    // Number of threads enumerating the superband orderings. The result does not depend on it.
+    int num_threads = 1;
+
+    // Order of the energetics models of each superband ordering. The result does not depend on it.
+    EnergeticsOrder energetics_order = EnergeticsOrder::Lexicographic;
+    // Order of the superband orderings. The result does not depend on it, but the time to find an
+    // exclusion does.
+    OrderingStrategy ordering_strategy = OrderingStrategy::Lexicographic;
+
+    SearchMode mode = SearchMode::Full;
+
+    // If positive, first sample this many random superband orderings on `num_threads` threads for
+    // a model with all gaps trivial or gapless, which settles a negative diagnosis at once. The
+    // result does not depend on it, but it can find the exclusion long before the enumeration.
+    long num_prescreen_orderings = 0;
+
+    // If set, continue the search saved in this checkpoint, which must have been taken from the
+    // same structure in the same mode and ordering strategy, instead of starting over.
+    const SearchCheckpoint *resume_from = nullptr;
+    // If set and the search times out or is interrupted, save its state here for resuming.
+    SearchCheckpoint *checkpoint = nullptr;
+    // If set, stop the search as if it timed out once this becomes true. It may be set from a
+    // signal handler.
+    const std::atomic<bool> *interrupt = nullptr;
+    // Likewise once a stop is requested, e.g. by a driver making room for a more urgent search.
+    std::stop_token stop_token;
+
+    // If set, return the result stored in this cache for the same search, and store the result of
+    // any search that does not time out. Diagnosis-only searches share the entries of full ones,
+    // and only store their negative diagnoses.
+    const SearchCache *cache = nullptr;
+};
+
 // Analyze the perturbation and decide if all possible Hamiltonians (for both the unperturbed and
 // perturbed systems) lead to topological gaps.
+SearchResult analyze_perturbation(const PerturbedBandStructure &structure,
+                                  const SearchOptions &options);
 SearchResult analyze_perturbation(const PerturbedBandStructure &structure, double timeout_s = 0.0);
 
+struct BatchOptions {
+    // Number of structures searched at once, each on `search_options.num_threads` threads.
+    int num_jobs = 1;
+
+    // Options of each search, whose timeout applies to each structure on its own. Its checkpoint
+    // fields must be unset; use the ones below instead.
+    SearchOptions search_options;
+
+    // If not empty, the checkpoint to resume each structure from (or null), and where to save the
+    // state of each structure whose search times out. Sized like the structures.
+    std::span<const SearchCheckpoint *const> resume_from;
+    std::span<SearchCheckpoint> checkpoints;
+    // If not empty, the stop token of each structure, which replaces the one of `search_options`.
+    // Sized like the structures.
+    std::span<const std::stop_token> stop_tokens;
+
+    // If set, called on the calling thread with the index and result of each structure, in input
+    // order, as soon as the searches of it and all the structures before it are done.
+    std::function<void(std::size_t, const SearchResult &)> on_result;
+};
+
+// Analyze the perturbations concurrently. Structures are handed out on demand, so that a slow one
+// does not hold up the others, and the results are returned in input order.
+std::vector<SearchResult> analyze_perturbations(std::span<const PerturbedBandStructure> structures,
+                                                const BatchOptions &options);
+
 }  // namespace magnon::diagnose2
@@ -1,7 +1,16 @@
 #include "diagnose2/analyze_perturbation.hpp"
 
+#include <algorithm>
+#include <atomic>
 #include <cassert>
+#include <filesystem>
+#include <stop_token>
+#include <string>
+#include <utility>
+#include <vector>
 
+#include "diagnose2/test_structures.hpp"
+#include "diagnose2/witness.hpp"
 #include "google/protobuf/util/message_differencer.h"
 #include "gtest/gtest.h"
 #include "utils/proto_text_format.hpp"
@@ -10,20 +19,20 @@ namespace magnon::utils {
 
 constexpr const char *RESULT_PATH =
     "diagnose2/test_data/analyze_perturbation_result_205_33_4a_2_4.txtpb";
-constexpr const char *PROCESSED_TABLES_PATH =
-    "diagnose2/test_data/processed_tables_205_33_4a_2_4.txtpb";
+
+using magnon::diagnose2::make_copies;
+using magnon::diagnose2::read_structure;
+using magnon::diagnose2::with_trivial_sis;
+
+magnon::diagnose2::SearchResult read_expected_result() {
+    magnon::diagnose2::SearchResult result{};
+    assert(magnon::utils::proto::read_from_text_file(RESULT_PATH, result));
+    return result;
+}
 
 TEST(AnalyzePerturbationTest, RegressionTestCase) {
-    const auto structure = []() {
-        magnon::diagnose2::PerturbedBandStructure structure{};
-        assert(magnon::utils::proto::read_from_text_file(PROCESSED_TABLES_PATH, structure));
-        return structure;
-    }();
-    const auto expected_result = []() {
-        magnon::diagnose2::SearchResult result{};
-        assert(magnon::utils::proto::read_from_text_file(RESULT_PATH, result));
-        return result;
-    }();
+    const auto structure = read_structure();
+    const auto expected_result = read_expected_result();
 
     const auto result = [&structure]() {
         auto result = magnon::diagnose2::analyze_perturbation(structure);
@@ -38,4 +47,423 @@ TEST(AnalyzePerturbationTest, RegressionTestCase) {
     EXPECT_TRUE(::google::protobuf::util::MessageDifferencer::Equals(result, expected_result));
 }
 
+TEST(AnalyzePerturbationTest, MultiThreadedMatchesRegressionTestCase) {
+    const auto structure = read_structure();
+    const auto expected_result = read_expected_result();
+
+    for (const int num_threads : {2, 3, 8}) {
+        auto result =
+            magnon::diagnose2::analyze_perturbation(structure, {.num_threads = num_threads});
+        result.clear_metadata();
+        EXPECT_TRUE(::google::protobuf::util::MessageDifferencer::Equals(result, expected_result))
+            << "num_threads: " << num_threads;
+    }
+}
+
+TEST(AnalyzePerturbationTest, ReportsPeakEntryCounts) {
+    // The peaks of a single-threaded search are deterministic.
+    const auto result = magnon::diagnose2::analyze_perturbation(read_structure());
+    EXPECT_EQ(result.metadata().peak_num_si_sequences(), 58);
+    EXPECT_EQ(result.metadata().peak_num_possibility_entries(), 148);
+}
+
+TEST(AnalyzePerturbationTest, SkipsOrderingsWithRepeatedSubbands) {
+    const auto structure = make_copies(read_structure(), 2);
+
+    auto expected_result = magnon::diagnose2::analyze_perturbation(structure);
+    const auto &metadata = expected_result.metadata();
+    EXPECT_GT(metadata.num_repeated_subbands(), 0);
+    EXPECT_GT(metadata.repeated_subband_fraction(), 0.0);
+    EXPECT_LT(metadata.repeated_subband_fraction(), 1.0);
+
+    // Orderings skipped by other threads leave the result as it is.
+    expected_result.clear_metadata();
+    for (const int num_threads : {2, 3}) {
+        auto result =
+            magnon::diagnose2::analyze_perturbation(structure, {.num_threads = num_threads});
+        result.clear_metadata();
+        EXPECT_TRUE(::google::protobuf::util::MessageDifferencer::Equals(result, expected_result))
+            << "num_threads: " << num_threads;
+    }
+}
+
+TEST(AnalyzePerturbationTest, ResumesFromCheckpoints) {
+    // Triple the bands, so that the search runs long enough to be interrupted.
+    const auto structure = make_copies(read_structure(), 3);
+    // With the interrupt raised from the start, each call stops at its first timeout check, after
+    // at most one superband ordering per chunk.
+    const std::atomic<bool> interrupt = true;
+    using magnon::diagnose2::EnergeticsOrder;
+    const std::vector<std::pair<int, EnergeticsOrder>> numthreads_order_pairs{
+        {1, EnergeticsOrder::Lexicographic},
+        {3, EnergeticsOrder::Lexicographic},
+        {1, EnergeticsOrder::Transpositions},
+        {3, EnergeticsOrder::Transpositions},
+    };
+    for (const auto &[num_threads, energetics_order] : numthreads_order_pairs) {
+        // The witnesses are the first models found, which depend on the energetics order.
+        const auto expected_result = [&structure, energetics_order]() {
+            auto result = magnon::diagnose2::analyze_perturbation(
+                structure, {.energetics_order = energetics_order});
+            result.clear_metadata();
+            return result;
+        }();
+
+        magnon::diagnose2::SearchResult result{};
+        magnon::diagnose2::SearchCheckpoint checkpoint{};
+        bool has_checkpoint = false;
+        int num_interruptions = 0;
+        do {
+            // Resume from a serialized copy, as a later process would.
+            magnon::diagnose2::SearchCheckpoint resume_from{};
+            std::string serialized;
+            ASSERT_TRUE(checkpoint.SerializeToString(&serialized));
+            ASSERT_TRUE(resume_from.ParseFromString(serialized));
+            checkpoint.Clear();
+
+            result = magnon::diagnose2::analyze_perturbation(
+                structure,
+                {.num_threads = num_threads,
+                 .energetics_order = energetics_order,
+                 .resume_from = has_checkpoint ? &resume_from : nullptr,
+                 .checkpoint = &checkpoint,
+                 .interrupt = &interrupt});
+            has_checkpoint = result.is_timeout();
+            num_interruptions += result.is_timeout();
+        } while (result.is_timeout());
+
+        EXPECT_GT(num_interruptions, 1) << "num_threads: " << num_threads;
+        result.clear_metadata();
+        EXPECT_TRUE(::google::protobuf::util::MessageDifferencer::Equals(result, expected_result))
+            << "num_threads: " << num_threads
+            << ", transpositions: " << (energetics_order == EnergeticsOrder::Transpositions);
+    }
+}
+
+TEST(AnalyzePerturbationTest, ReportsPartialResultsOnTimeout) {
+    const auto structure = make_copies(read_structure(), 3);
+    const auto expected_result = magnon::diagnose2::analyze_perturbation(structure);
+    ASSERT_FALSE(expected_result.is_negative_diagnosis());
+    const auto &nontrivial_counts =
+        expected_result.si_to_possible_gap_count().at("nontrivial").gap_count();
+    const auto [min_count, max_count] =
+        std::minmax_element(nontrivial_counts.begin(), nontrivial_counts.end());
+
+    const std::atomic<bool> interrupt = true;
+    magnon::diagnose2::SearchResult result{};
+    magnon::diagnose2::SearchCheckpoint checkpoint{};
+    double ordering_fraction = 0.0;
+    bool has_partial_possibilities = false;
+    int num_interruptions = 0;
+    do {
+        const auto resume_from = checkpoint;
+        result = magnon::diagnose2::analyze_perturbation(
+            structure,
+            {.resume_from = num_interruptions > 0 ? &resume_from : nullptr,
+             .checkpoint = &checkpoint,
+             .interrupt = &interrupt});
+        if (!result.is_timeout()) {
+            break;
+        }
+        ++num_interruptions;
+
+        ASSERT_TRUE(result.has_partial_result());
+        const auto &partial_result = result.partial_result();
+        EXPECT_GE(partial_result.ordering_fraction(), ordering_fraction);
+        EXPECT_LE(partial_result.ordering_fraction(), 1.0);
+        ordering_fraction = partial_result.ordering_fraction();
+        has_partial_possibilities |= !partial_result.gap_to_possible_si_values().empty();
+        if (partial_result.has_min_nontrivial_gap_count()) {
+            EXPECT_GE(partial_result.min_nontrivial_gap_count(), *min_count);
+            EXPECT_LE(partial_result.max_nontrivial_gap_count(), *max_count);
+        }
+        for (const auto &[gap, sis] : partial_result.gap_to_possible_si_values()) {
+            const auto &expected_sis = expected_result.gap_to_possible_si_values().at(gap).si();
+            for (const auto &si : sis.si()) {
+                EXPECT_NE(std::find(expected_sis.begin(), expected_sis.end(), si),
+                          expected_sis.end());
+            }
+        }
+        for (const auto &[si, gap_counts] : partial_result.si_to_possible_gap_count()) {
+            const auto &expected_counts =
+                expected_result.si_to_possible_gap_count().at(si).gap_count();
+            for (const auto count : gap_counts.gap_count()) {
+                EXPECT_NE(std::find(expected_counts.begin(), expected_counts.end(), count),
+                          expected_counts.end());
+            }
+        }
+    } while (true);
+
+    EXPECT_GT(num_interruptions, 1);
+    EXPECT_GT(ordering_fraction, 0.0);
+    EXPECT_TRUE(has_partial_possibilities);
+    EXPECT_FALSE(result.has_partial_result());
+}
+
+TEST(AnalyzePerturbationTest, WitnessesReplayToExtremeNontrivialCounts) {
+    const auto structure = read_structure();
+    const magnon::diagnose2::SpectrumData data(structure);
+    using magnon::diagnose2::EnergeticsOrder;
+    for (const auto energetics_order :
+         {EnergeticsOrder::Lexicographic, EnergeticsOrder::Transpositions}) {
+        const auto result = magnon::diagnose2::analyze_perturbation(
+            structure, {.energetics_order = energetics_order});
+        ASSERT_FALSE(result.is_negative_diagnosis());
+        ASSERT_TRUE(result.has_min_nontrivial_witness());
+        ASSERT_TRUE(result.has_max_nontrivial_witness());
+
+        const auto &nontrivial_counts =
+            result.si_to_possible_gap_count().at("nontrivial").gap_count();
+        const auto [min_count, max_count] =
+            std::minmax_element(nontrivial_counts.begin(), nontrivial_counts.end());
+        for (const auto &[witness, expected_count] :
+             {std::pair{result.min_nontrivial_witness(), *min_count},
+              std::pair{result.max_nontrivial_witness(), *max_count}}) {
+            EXPECT_EQ(witness.num_nontrivial_gaps(), expected_count);
+
+            const auto model = magnon::diagnose2::replay_witness(witness, data);
+            const int num_bands = model->subband.get_num_bands();
+            int num_trivial_or_gapless = 0;
+            for (const auto &[gap, isgapped_and_si] : model->subband.calc_gap_sis()) {
+                const auto &[is_gapped, si] = isgapped_and_si;
+                num_trivial_or_gapless += !is_gapped || si.is_trivial();
+            }
+            EXPECT_EQ(num_bands - num_trivial_or_gapless, expected_count);
+        }
+    }
+}
+
+TEST(AnalyzePerturbationTest, RejectsWitnessOfOtherStructure) {
+    const auto structure = read_structure();
+    const magnon::diagnose2::SpectrumData data(structure);
+    auto witness = magnon::diagnose2::analyze_perturbation(structure).max_nontrivial_witness();
+    witness.mutable_sub_k_point(0)->set_irrep_idx(0, -1);
+    EXPECT_THROW(magnon::diagnose2::replay_witness(witness, data), std::invalid_argument);
+}
+
+TEST(AnalyzePerturbationTest, DiagnosisOnlyMatchesFullSearch) {
+    const std::vector<magnon::diagnose2::PerturbedBandStructure> structures{
+        read_structure(), with_trivial_sis(read_structure())};
+
+    using magnon::diagnose2::EnergeticsOrder;
+    for (const auto &structure : structures) {
+        for (const auto energetics_order :
+             {EnergeticsOrder::Lexicographic, EnergeticsOrder::Transpositions}) {
+            const auto expected_result = magnon::diagnose2::analyze_perturbation(
+                structure, {.energetics_order = energetics_order});
+            const auto result = magnon::diagnose2::analyze_perturbation(
+                structure,
+                {.energetics_order = energetics_order,
+                 .mode = magnon::diagnose2::SearchMode::DiagnosisOnly});
+            ASSERT_FALSE(result.is_timeout());
+            EXPECT_EQ(result.is_negative_diagnosis(), expected_result.is_negative_diagnosis());
+            EXPECT_EQ(result.metadata().is_diagnosis_only(), !result.is_negative_diagnosis());
+            EXPECT_TRUE(result.si_to_possible_gap_count().empty());
+            EXPECT_TRUE(result.gap_to_possible_si_values().empty());
+            EXPECT_FALSE(result.has_max_nontrivial_witness());
+        }
+    }
+}
+
+TEST(AnalyzePerturbationTest, DiagnosisOnlyResumesFromCheckpoints) {
+    // Five copies, as most orderings of fewer repeat the subband of an earlier one and are quickly
+    // skipped.
+    const auto structure = make_copies(read_structure(), 5);
+    const auto expected_result = magnon::diagnose2::analyze_perturbation(structure);
+
+    const std::atomic<bool> interrupt = true;
+    const magnon::diagnose2::SearchOptions options{
+        .mode = magnon::diagnose2::SearchMode::DiagnosisOnly, .interrupt = &interrupt};
+    magnon::diagnose2::SearchResult result{};
+    magnon::diagnose2::SearchCheckpoint checkpoint{};
+    int num_interruptions = 0;
+    do {
+        const auto resume_from = checkpoint;
+        auto resume_options = options;
+        resume_options.resume_from = num_interruptions > 0 ? &resume_from : nullptr;
+        resume_options.checkpoint = &checkpoint;
+        result = magnon::diagnose2::analyze_perturbation(structure, resume_options);
+        num_interruptions += result.is_timeout();
+    } while (result.is_timeout());
+
+    EXPECT_GT(num_interruptions, 1);
+    EXPECT_EQ(result.is_negative_diagnosis(), expected_result.is_negative_diagnosis());
+
+    // The checkpoints of a diagnosis hold no possibilities to finish a full search with.
+    EXPECT_THROW(magnon::diagnose2::analyze_perturbation(structure, {.resume_from = &checkpoint}),
+                 std::invalid_argument);
+}
+
+TEST(AnalyzePerturbationTest, PrescreenMatchesSearchWithoutIt) {
+    for (const auto &structure : {read_structure(), with_trivial_sis(read_structure())}) {
+        auto expected_result = magnon::diagnose2::analyze_perturbation(structure);
+        auto result = magnon::diagnose2::analyze_perturbation(
+            structure, {.num_threads = 2, .num_prescreen_orderings = 16});
+        EXPECT_EQ(result.metadata().is_excluded_by_prescreen(),
+                  expected_result.is_negative_diagnosis());
+        expected_result.clear_metadata();
+        result.clear_metadata();
+        EXPECT_TRUE(
+            google::protobuf::util::MessageDifferencer::Equals(result, expected_result));
+    }
+}
+
+TEST(AnalyzePerturbationTest, OrderingStrategiesMatchLexicographicSearch) {
+    // With all SIs trivial, the search excludes the perturbation.
+    const std::vector<magnon::diagnose2::PerturbedBandStructure> structures{
+        read_structure(),
+        make_copies(read_structure(), 2),
+        with_trivial_sis(make_copies(read_structure(), 2))};
+
+    using magnon::diagnose2::EnergeticsOrder;
+    using magnon::diagnose2::OrderingStrategy;
+    for (const auto &structure : structures) {
+        const auto expected_result = magnon::diagnose2::analyze_perturbation(structure);
+        for (const auto ordering_strategy :
+             {OrderingStrategy::ImpactFirst, OrderingStrategy::ImpactFirstInterleaved}) {
+            for (const int num_threads : {1, 3}) {
+                // The walks of the k-points start where the strategy puts them.
+                const auto energetics_order = num_threads == 1 ? EnergeticsOrder::Lexicographic
+                                                               : EnergeticsOrder::Transpositions;
+                const auto result = magnon::diagnose2::analyze_perturbation(
+                    structure,
+                    {.num_threads = num_threads,
+                     .energetics_order = energetics_order,
+                     .ordering_strategy = ordering_strategy});
+                EXPECT_EQ(result.is_negative_diagnosis(), expected_result.is_negative_diagnosis());
+                EXPECT_GT(result.metadata().num_models(), 0);
+                for (const auto &[si, gap_counts] : expected_result.si_to_possible_gap_count()) {
+                    ASSERT_TRUE(result.si_to_possible_gap_count().contains(si));
+                    EXPECT_TRUE(google::protobuf::util::MessageDifferencer::Equals(
+                        result.si_to_possible_gap_count().at(si), gap_counts));
+                }
+                EXPECT_EQ(result.min_nontrivial_witness().num_nontrivial_gaps(),
+                          expected_result.min_nontrivial_witness().num_nontrivial_gaps());
+                EXPECT_EQ(result.max_nontrivial_witness().num_nontrivial_gaps(),
+                          expected_result.max_nontrivial_witness().num_nontrivial_gaps());
+            }
+        }
+    }
+}
+
+TEST(AnalyzePerturbationTest, RejectsCheckpointOfOtherOrderingStrategy) {
+    const auto structure = read_structure();
+    const std::atomic<bool> interrupt = true;
+    magnon::diagnose2::SearchCheckpoint checkpoint{};
+    ASSERT_TRUE(magnon::diagnose2::analyze_perturbation(
+                    structure, {.checkpoint = &checkpoint, .interrupt = &interrupt})
+                    .is_timeout());
+    EXPECT_THROW(
+        magnon::diagnose2::analyze_perturbation(
+            structure,
+            {.ordering_strategy = magnon::diagnose2::OrderingStrategy::ImpactFirstInterleaved,
+             .resume_from = &checkpoint}),
+        std::invalid_argument);
+}
+
+TEST(AnalyzePerturbationTest, BatchStreamsResultsInInputOrder) {
+    // Structures of different costs, so that they finish out of order.
+    std::vector<magnon::diagnose2::PerturbedBandStructure> structures;
+    for (int num_copies = 3; num_copies >= 1; --num_copies) {
+        structures.push_back(make_copies(read_structure(), num_copies));
+    }
+    structures.push_back(with_trivial_sis(read_structure()));
+
+    std::vector<std::size_t> streamed_idxs;
+    auto results = magnon::diagnose2::analyze_perturbations(
+        structures,
+        {.num_jobs = 3,
+         .on_result = [&](const std::size_t idx, const magnon::diagnose2::SearchResult &) {
+             streamed_idxs.push_back(idx);
+         }});
+
+    ASSERT_EQ(results.size(), structures.size());
+    EXPECT_EQ(streamed_idxs, (std::vector<std::size_t>{0, 1, 2, 3}));
+    for (std::size_t idx = 0; idx < structures.size(); ++idx) {
+        auto expected_result = magnon::diagnose2::analyze_perturbation(structures[idx]);
+        expected_result.clear_metadata();
+        results[idx].clear_metadata();
+        EXPECT_TRUE(
+            ::google::protobuf::util::MessageDifferencer::Equals(results[idx], expected_result))
+            << "idx: " << idx;
+    }
+    EXPECT_TRUE(results.back().is_negative_diagnosis());
+}
+
+TEST(AnalyzePerturbationTest, BatchStopsSearchesOnRequest) {
+    const std::vector<magnon::diagnose2::PerturbedBandStructure> structures(3, read_structure());
+    std::vector<std::stop_source> stop_sources(structures.size());
+    std::vector<std::stop_token> stop_tokens;
+    for (const auto &stop_source : stop_sources) {
+        stop_tokens.push_back(stop_source.get_token());
+    }
+    stop_sources[1].request_stop();
+
+    const auto results = magnon::diagnose2::analyze_perturbations(
+        structures, {.num_jobs = 2, .stop_tokens = stop_tokens});
+    ASSERT_EQ(results.size(), structures.size());
+    EXPECT_FALSE(results[0].is_timeout());
+    EXPECT_TRUE(results[1].is_timeout());
+    EXPECT_FALSE(results[2].is_timeout());
+}
+
+TEST(AnalyzePerturbationTest, ReturnsCachedResults) {
+    const auto dir = std::filesystem::path(testing::TempDir()) / "analyze_perturbation_cache";
+    std::filesystem::remove_all(dir);
+    const magnon::diagnose2::SearchCache cache(dir);
+    const auto structure = read_structure();
+
+    auto result = magnon::diagnose2::analyze_perturbation(structure, {.cache = &cache});
+    EXPECT_FALSE(result.metadata().is_cached());
+    auto cached_result = magnon::diagnose2::analyze_perturbation(structure, {.cache = &cache});
+    EXPECT_TRUE(cached_result.metadata().is_cached());
+
+    result.clear_metadata();
+    cached_result.clear_metadata();
+    EXPECT_TRUE(::google::protobuf::util::MessageDifferencer::Equals(cached_result, result));
+}
+
+TEST(AnalyzePerturbationTest, SharesCachedResultsBetweenReorderedStructures) {
+    const auto dir =
+        std::filesystem::path(testing::TempDir()) / "analyze_perturbation_reordered_cache";
+    std::filesystem::remove_all(dir);
+    const magnon::diagnose2::SearchCache cache(dir);
+    const auto structure = read_structure();
+    auto reordered_structure = structure;
+    auto &irreps = *reordered_structure.mutable_subgroup()->mutable_little_irrep();
+    std::reverse(irreps.begin(), irreps.end());
+
+    auto result = magnon::diagnose2::analyze_perturbation(structure, {.cache = &cache});
+    const auto cached_result =
+        magnon::diagnose2::analyze_perturbation(reordered_structure, {.cache = &cache});
+    EXPECT_TRUE(cached_result.metadata().is_cached());
+    auto cached_summary = cached_result;
+    for (auto *summary : {&result, &cached_summary}) {
+        summary->clear_metadata();
+        summary->clear_min_nontrivial_witness();
+        summary->clear_max_nontrivial_witness();
+    }
+    EXPECT_TRUE(::google::protobuf::util::MessageDifferencer::Equals(cached_summary, result));
+
+    // The witnesses are translated to the irreps of the reordered structure.
+    const magnon::diagnose2::SpectrumData data(reordered_structure);
+    const auto &witness = cached_result.max_nontrivial_witness();
+    const auto model = magnon::diagnose2::replay_witness(witness, data);
+    int num_nontrivial = 0;
+    for (const auto &[gap, isgapped_and_si] : model->subband.calc_gap_sis()) {
+        const auto &[is_gapped, si] = isgapped_and_si;
+        num_nontrivial += is_gapped && !si.is_trivial();
+    }
+    EXPECT_EQ(num_nontrivial, witness.num_nontrivial_gaps());
+}
+
+TEST(AnalyzePerturbationTest, RejectsCheckpointOfOtherStructure) {
+    const auto structure = read_structure();
+    magnon::diagnose2::SearchCheckpoint checkpoint{};
+    checkpoint.set_supergroup_number("1.1");
+    checkpoint.set_subgroup_number(structure.subgroup().number());
+    EXPECT_THROW(magnon::diagnose2::analyze_perturbation(structure, {.resume_from = &checkpoint}),
+                 std::invalid_argument);
+}
+
 }  // namespace magnon::utils
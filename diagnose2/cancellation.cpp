@@ -0,0 +1,43 @@
+#include "diagnose2/cancellation.hpp"
+
+#include <algorithm>
+#include <utility>
+
+namespace magnon::diagnose2 {
+
+Cancellation::Cancellation(const std::optional<Clock::time_point> deadline,
+                           const std::atomic<bool> *interrupt,
+                           std::stop_token stop_token)
+    : deadline{deadline}, interrupt{interrupt}, stop_token{std::move(stop_token)} {}
+
+bool Cancellation::check(const Clock::time_point now) {
+    if (is_cancelled()) {
+        return true;
+    }
+    if ((deadline && now >= *deadline) ||
+        (interrupt != nullptr && interrupt->load(std::memory_order_relaxed)) ||
+        stop_token.stop_requested()) {
+        is_cancelled_.store(true, std::memory_order_relaxed);
+        return true;
+    }
+    return false;
+}
+
+bool CancellationPoll::check() {
+    const auto now = Cancellation::Clock::now();
+    if (last_check_time) {
+        // Grow the stride gradually, but shrink it at once when the iterations get slower.
+        const auto interval = now - *last_check_time;
+        if (interval < CHECK_INTERVAL / 2) {
+            stride = std::min(2 * stride, MAX_STRIDE);
+        } else if (interval > 2 * CHECK_INTERVAL) {
+            const double slowdown = std::chrono::duration<double>(interval) / CHECK_INTERVAL;
+            stride = std::max(static_cast<int>(stride / slowdown), 1);
+        }
+    }
+    last_check_time = now;
+    num_polls_left = stride;
+    return cancellation.check(now);
+}
+
+}  // namespace magnon::diagnose2
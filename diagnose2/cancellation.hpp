@@ -0,0 +1,64 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <optional>
+#include <stop_token>
+
+namespace magnon::diagnose2 {
+
+// Why and when a search must stop early: once its deadline has passed, its interrupt flag is raised
+// or a stop is requested through its stop token. Shared by the threads of a search, which find out
+// through a `CancellationPoll` each.
+class Cancellation {
+ public:
+    using Clock = std::chrono::steady_clock;
+
+    // Never cancelled.
+    Cancellation() = default;
+    Cancellation(std::optional<Clock::time_point> deadline,
+                 const std::atomic<bool> *interrupt,
+                 std::stop_token stop_token);
+
+    // Check whether the search is cancelled at `now`, and remember it if so.
+    bool check(Clock::time_point now);
+    // Whether a check found the search cancelled.
+    bool is_cancelled() const { return is_cancelled_.load(std::memory_order_relaxed); }
+
+ private:
+    std::optional<Clock::time_point> deadline;
+    const std::atomic<bool> *interrupt = nullptr;
+    std::stop_token stop_token;
+
+    std::atomic<bool> is_cancelled_ = false;
+};
+
+// Checks a `Cancellation` from the loops of one thread. Polling is cheap enough for every iteration
+// of the innermost loops: the clock is only read every `stride` polls, with the stride adapted to
+// the cost of the iterations so that the reads are about `CHECK_INTERVAL` apart. The first read
+// comes after `INITIAL_STRIDE` polls, so that a search resumed past its deadline still advances.
+class CancellationPoll {
+ public:
+    explicit CancellationPoll(Cancellation &cancellation) : cancellation{cancellation} {}
+
+    bool should_stop() {
+        if (--num_polls_left > 0) {
+            return cancellation.is_cancelled();
+        }
+        return check();
+    }
+
+ private:
+    static constexpr auto CHECK_INTERVAL = std::chrono::microseconds{100};
+    static constexpr int INITIAL_STRIDE = 64;
+    static constexpr int MAX_STRIDE = 1 << 16;
+
+    bool check();
+
+    Cancellation &cancellation;
+    int stride = INITIAL_STRIDE;
+    int num_polls_left = INITIAL_STRIDE;
+    std::optional<Cancellation::Clock::time_point> last_check_time;
+};
+
+}  // namespace magnon::diagnose2
@@ -0,0 +1,75 @@
+#include "diagnose2/cancellation.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <stop_token>
+#include <thread>
+
+#include "gtest/gtest.h"
+
+namespace magnon::diagnose2 {
+
+using Clock = Cancellation::Clock;
+
+TEST(CancellationTest, IsCancelledOncePastDeadline) {
+    const auto deadline = Clock::now() + std::chrono::hours{1};
+    Cancellation cancellation(deadline, nullptr, {});
+    EXPECT_FALSE(cancellation.check(deadline - std::chrono::nanoseconds{1}));
+    EXPECT_FALSE(cancellation.is_cancelled());
+    EXPECT_TRUE(cancellation.check(deadline));
+    EXPECT_TRUE(cancellation.is_cancelled());
+    // Once cancelled, it stays cancelled.
+    EXPECT_TRUE(cancellation.check(deadline - std::chrono::hours{1}));
+}
+
+TEST(CancellationTest, IsCancelledByInterrupt) {
+    std::atomic<bool> interrupt = false;
+    Cancellation cancellation(std::nullopt, &interrupt, {});
+    EXPECT_FALSE(cancellation.check(Clock::now()));
+    interrupt = true;
+    EXPECT_TRUE(cancellation.check(Clock::now()));
+}
+
+TEST(CancellationTest, IsCancelledByStopRequest) {
+    std::stop_source stop_source;
+    Cancellation cancellation(std::nullopt, nullptr, stop_source.get_token());
+    EXPECT_FALSE(cancellation.check(Clock::now()));
+    stop_source.request_stop();
+    EXPECT_TRUE(cancellation.check(Clock::now()));
+}
+
+TEST(CancellationTest, DefaultIsNeverCancelled) {
+    Cancellation cancellation;
+    EXPECT_FALSE(cancellation.check(Clock::time_point::max()));
+}
+
+TEST(CancellationPollTest, StopsSoonAfterDeadline) {
+    const auto timeout = std::chrono::milliseconds{20};
+    const auto start_time = Clock::now();
+    Cancellation cancellation(start_time + timeout, nullptr, {});
+    CancellationPoll poll(cancellation);
+    // Polls of uneven cost, so that the stride has to adapt both ways.
+    long num_polls = 0;
+    while (!poll.should_stop()) {
+        if (++num_polls % 4096 == 0) {
+            std::this_thread::sleep_for(std::chrono::microseconds{200});
+        }
+    }
+    const auto overrun = Clock::now() - (start_time + timeout);
+    EXPECT_LT(overrun, std::chrono::milliseconds{10});
+    EXPECT_TRUE(cancellation.is_cancelled());
+}
+
+TEST(CancellationPollTest, SeesCancellationFoundByOtherPoll) {
+    std::atomic<bool> interrupt = false;
+    Cancellation cancellation(std::nullopt, &interrupt, {});
+    CancellationPoll poll(cancellation);
+    CancellationPoll other_poll(cancellation);
+    EXPECT_FALSE(poll.should_stop());
+    interrupt = true;
+    while (!other_poll.should_stop()) {
+    }
+    EXPECT_TRUE(poll.should_stop());
+}
+
+}  // namespace magnon::diagnose2
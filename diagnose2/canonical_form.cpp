@@ -0,0 +1,481 @@
+#include "diagnose2/canonical_form.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <functional>
+#include <numeric>
+#include <optional>
+#include <tuple>
+#include <utility>
+
+#include "fmt/core.h"
+
+namespace magnon::diagnose2 {
+
+namespace {
+
+// Kinds of vertices of the problem graph. The kind leads the initial color of a vertex, so that
+// the canonical order keeps the vertices of each kind together, in this order.
+enum Kind : long { SuperK, SuperIrrep, SubK, SubIrrep, CrRow };
+
+// Labels of the directed edges, each relation with its reverse.
+enum Relation : long { Member, Owner, Image, Preimage, Entry, EntryOf };
+
+// Number the distinct signatures by their sorted order, so that the numbers do not depend on the
+// order of the vertices.
+std::vector<int> rank_signatures(const std::vector<std::vector<long>> &signatures) {
+    auto sorted = signatures;
+    std::sort(sorted.begin(), sorted.end());
+    sorted.erase(std::unique(sorted.begin(), sorted.end()), sorted.end());
+    std::vector<int> result;
+    result.reserve(signatures.size());
+    for (const auto &signature : signatures) {
+        result.push_back(std::lower_bound(sorted.begin(), sorted.end(), signature) -
+                         sorted.begin());
+    }
+    return result;
+}
+
+int num_colors(const std::vector<int> &colors) {
+    return colors.empty() ? 0 : *std::max_element(colors.begin(), colors.end()) + 1;
+}
+
+class Graph {
+ public:
+    int add_vertex(std::vector<long> initial_color) {
+        initial_colors.push_back(std::move(initial_color));
+        vertex_to_edges.emplace_back();
+        return static_cast<int>(initial_colors.size()) - 1;
+    }
+
+    void add_edge(const int from, const int to, const Relation relation, const long weight = 0) {
+        // Each relation is followed by its reverse in `Relation`.
+        const auto reverse_relation = static_cast<Relation>(relation + 1);
+        vertex_to_edges[from].emplace_back(relation, weight, to);
+        vertex_to_edges[to].emplace_back(reverse_relation, weight, from);
+    }
+
+    // Call `visit` on candidate numberings of the vertices, among which those with the smallest
+    // form only depend on the graph. Vertices the refinement leaves tied are told apart by trying
+    // each vertex of the first tied color in turn, except those which an automorphism found so far
+    // maps to a vertex already tried while fixing the vertices told apart before.
+    void visit_orders(const std::function<void(const std::vector<int> &)> &visit) const {
+        Search search{.visit = visit};
+        std::vector<int> path;
+        visit_orders(rank_signatures(initial_colors), path, search);
+    }
+
+ private:
+    struct Search {
+        const std::function<void(const std::vector<int> &)> &visit;
+        // The vertex at each position of the first numbering visited.
+        std::vector<int> first_position_to_vertex;
+        // Automorphisms found by comparing the later numberings to the first.
+        std::vector<std::vector<int>> automorphisms;
+    };
+
+    void visit_orders(const std::vector<int> &start_colors,
+                      std::vector<int> &path,
+                      Search &search) const {
+        const auto colors = refine(start_colors);
+        const int num_vertices = static_cast<int>(colors.size());
+        if (num_colors(colors) == num_vertices) {
+            if (search.first_position_to_vertex.empty()) {
+                search.first_position_to_vertex.resize(num_vertices);
+                for (int vertex = 0; vertex < num_vertices; ++vertex) {
+                    search.first_position_to_vertex[colors[vertex]] = vertex;
+                }
+            } else {
+                std::vector<int> permutation(num_vertices);
+                for (int vertex = 0; vertex < num_vertices; ++vertex) {
+                    permutation[vertex] = search.first_position_to_vertex[colors[vertex]];
+                }
+                if (is_automorphism(permutation)) {
+                    search.automorphisms.push_back(std::move(permutation));
+                }
+            }
+            search.visit(colors);
+            return;
+        }
+
+        std::vector<int> color_to_count(num_vertices, 0);
+        for (const int color : colors) {
+            ++color_to_count[color];
+        }
+        const int tied_color = std::find_if(color_to_count.begin(),
+                                            color_to_count.end(),
+                                            [](const int count) { return count > 1; }) -
+                               color_to_count.begin();
+        std::vector<int> tried_vertices;
+        std::vector<std::vector<long>> signatures(num_vertices);
+        for (int chosen_vertex = 0; chosen_vertex < num_vertices; ++chosen_vertex) {
+            if (colors[chosen_vertex] != tied_color ||
+                is_in_orbit(chosen_vertex, tried_vertices, path, search.automorphisms)) {
+                continue;
+            }
+            for (int vertex = 0; vertex < num_vertices; ++vertex) {
+                signatures[vertex] = {colors[vertex], vertex == chosen_vertex ? 0 : 1};
+            }
+            path.push_back(chosen_vertex);
+            visit_orders(rank_signatures(signatures), path, search);
+            path.pop_back();
+            tried_vertices.push_back(chosen_vertex);
+        }
+    }
+
+    // Whether `permutation` maps the vertices to ones of the same initial color and the edges to
+    // edges.
+    bool is_automorphism(const std::vector<int> &permutation) const {
+        std::vector<std::tuple<Relation, long, int>> edges;
+        for (int vertex = 0; vertex < static_cast<int>(permutation.size()); ++vertex) {
+            const int image = permutation[vertex];
+            if (initial_colors[vertex] != initial_colors[image]) {
+                return false;
+            }
+            edges.clear();
+            for (const auto &[relation, weight, to] : vertex_to_edges[vertex]) {
+                edges.emplace_back(relation, weight, permutation[to]);
+            }
+            auto image_edges = vertex_to_edges[image];
+            std::sort(edges.begin(), edges.end());
+            std::sort(image_edges.begin(), image_edges.end());
+            if (edges != image_edges) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // Whether the automorphisms fixing each vertex of `path` map `vertex` to one of `vertices`,
+    // directly or in turn.
+    static bool is_in_orbit(const int vertex,
+                            const std::vector<int> &vertices,
+                            const std::vector<int> &path,
+                            const std::vector<std::vector<int>> &automorphisms) {
+        if (vertices.empty() || automorphisms.empty()) {
+            return false;
+        }
+        std::vector<int> vertex_to_root(automorphisms.front().size());
+        std::iota(vertex_to_root.begin(), vertex_to_root.end(), 0);
+        const auto find_root = [&](int v) {
+            while (vertex_to_root[v] != v) {
+                v = vertex_to_root[v] = vertex_to_root[vertex_to_root[v]];
+            }
+            return v;
+        };
+        for (const auto &automorphism : automorphisms) {
+            if (std::all_of(path.begin(), path.end(), [&](const int fixed) {
+                    return automorphism[fixed] == fixed;
+                })) {
+                for (int v = 0; v < static_cast<int>(automorphism.size()); ++v) {
+                    vertex_to_root[find_root(v)] = find_root(automorphism[v]);
+                }
+            }
+        }
+        const int root = find_root(vertex);
+        return std::any_of(vertices.begin(), vertices.end(), [&](const int v) {
+            return find_root(v) == root;
+        });
+    }
+
+    // Split the colors by the colors of the neighbors until they are stable. Each new color is
+    // led by the old one, so that the order of the colors is kept.
+    std::vector<int> refine(std::vector<int> colors) const {
+        std::vector<std::vector<long>> signatures(colors.size());
+        std::vector<std::tuple<long, long, long>> edge_colors;
+        while (true) {
+            for (std::size_t vertex = 0; vertex < colors.size(); ++vertex) {
+                edge_colors.clear();
+                for (const auto &[relation, weight, to] : vertex_to_edges[vertex]) {
+                    edge_colors.emplace_back(relation, weight, colors[to]);
+                }
+                std::sort(edge_colors.begin(), edge_colors.end());
+                auto &signature = signatures[vertex];
+                signature.assign({colors[vertex]});
+                for (const auto &[relation, weight, color] : edge_colors) {
+                    signature.insert(signature.end(), {relation, weight, color});
+                }
+            }
+            auto new_colors = rank_signatures(signatures);
+            if (num_colors(new_colors) == num_colors(colors)) {
+                return colors;
+            }
+            colors = std::move(new_colors);
+        }
+    }
+
+    std::vector<std::vector<long>> initial_colors;
+    std::vector<std::vector<std::tuple<Relation, long, int>>> vertex_to_edges;
+};
+
+// Appends values to the content unambiguously: each value is terminated, and each sequence is
+// prefixed with its length.
+class ContentWriter {
+ public:
+    void add(const long value) { content += fmt::format("{};", value); }
+    template <typename T>
+    void add(const std::vector<T> &values) {
+        add(static_cast<long>(values.size()));
+        for (const auto &value : values) {
+            add(value);
+        }
+    }
+    template <typename T, typename U>
+    void add(const std::pair<T, U> &value) {
+        add(value.first);
+        add(value.second);
+    }
+
+    std::string content;
+};
+
+// Canonical index of each vertex from `first_vertex` on, `num_vertices` of one kind.
+std::vector<int> to_canonical_idxs(const std::vector<int> &order,
+                                   const int first_vertex,
+                                   const int num_vertices) {
+    std::vector<int> result;
+    for (int vertex = first_vertex; vertex < first_vertex + num_vertices; ++vertex) {
+        result.push_back(order[vertex] - first_vertex);
+    }
+    return result;
+}
+
+std::vector<int> invert(const std::vector<int> &permutation) {
+    std::vector<int> result(permutation.size());
+    for (int i = 0; i < static_cast<int>(permutation.size()); ++i) {
+        result[permutation[i]] = i;
+    }
+    return result;
+}
+
+// The antiunitary relations of a group in canonical indices, as sorted (k1, k2, irrep pairs).
+std::vector<std::pair<std::pair<int, int>, std::vector<std::pair<int, int>>>>
+canonical_antiunit_rels(const SpectrumData::Msg &msg,
+                        const std::vector<int> &k_idx_to_canonical_idx,
+                        const std::vector<int> &irrep_idx_to_canonical_idx) {
+    std::vector<std::pair<std::pair<int, int>, std::vector<std::pair<int, int>>>> result;
+    for (const auto &[k1_idx, k2_idx, irrep1idx_to_irrep2idx] :
+         msg.k1idx_k2idx_irrep1idxtoirrep2idx_tuples) {
+        std::vector<std::pair<int, int>> irrep_pairs;
+        for (int irrep1_idx = 0; irrep1_idx < static_cast<int>(irrep1idx_to_irrep2idx.size());
+             ++irrep1_idx) {
+            if (irrep1idx_to_irrep2idx[irrep1_idx] >= 0) {
+                irrep_pairs.emplace_back(
+                    irrep_idx_to_canonical_idx[irrep1_idx],
+                    irrep_idx_to_canonical_idx[irrep1idx_to_irrep2idx[irrep1_idx]]);
+            }
+        }
+        std::sort(irrep_pairs.begin(), irrep_pairs.end());
+        result.emplace_back(
+            std::pair{k_idx_to_canonical_idx[k1_idx], k_idx_to_canonical_idx[k2_idx]},
+            std::move(irrep_pairs));
+    }
+    std::sort(result.begin(), result.end());
+    return result;
+}
+
+// Relabel the k-points and irreps of a witness: k-point `k_idx` moves to `k_idx_map[k_idx]` and
+// irrep `irrep_idx` becomes `irrep_idx_map[irrep_idx]`.
+void relabel_k_points(
+    const google::protobuf::RepeatedPtrField<SearchResult::Witness::KPoint> &k_points,
+    const std::vector<int> &k_idx_map,
+    const std::vector<int> &irrep_idx_map,
+    google::protobuf::RepeatedPtrField<SearchResult::Witness::KPoint> &result) {
+    assert(k_points.size() == static_cast<int>(k_idx_map.size()));
+    result.Clear();
+    for (int i = 0; i < k_points.size(); ++i) {
+        result.Add();
+    }
+    for (int k_idx = 0; k_idx < k_points.size(); ++k_idx) {
+        auto &k_point = result[k_idx_map[k_idx]];
+        for (const int irrep_idx : k_points[k_idx].irrep_idx()) {
+            k_point.add_irrep_idx(irrep_idx_map[irrep_idx]);
+        }
+    }
+}
+
+}  // namespace
+
+CanonicalForm make_canonical_form(const SpectrumData &data,
+                                  const std::vector<std::string> &positive_energy_irreps) {
+    const auto &super_msg = data.super_msg;
+    const auto &sub_msg = data.sub_msg;
+    const int num_superks = static_cast<int>(super_msg.ks.size());
+    const int num_superirreps = static_cast<int>(super_msg.irreps.size());
+    const int num_subks = static_cast<int>(sub_msg.ks.size());
+    const int num_subirreps = static_cast<int>(sub_msg.irreps.size());
+    const int num_cr_rows = static_cast<int>(sub_msg.comp_rels_matrix.rows());
+
+    std::vector<long> superirrep_idx_to_num_positive(num_superirreps, 0);
+    for (const auto &irrep : positive_energy_irreps) {
+        ++superirrep_idx_to_num_positive[super_msg.irrep_to_idx(irrep)];
+    }
+
+    Graph graph;
+    const int first_superk = 0;
+    const int first_superirrep = first_superk + num_superks;
+    const int first_subk = first_superirrep + num_superirreps;
+    const int first_subirrep = first_subk + num_subks;
+    const int first_cr_row = first_subirrep + num_subirreps;
+    for (int k_idx = 0; k_idx < num_superks; ++k_idx) {
+        graph.add_vertex({SuperK});
+    }
+    for (int irrep_idx = 0; irrep_idx < num_superirreps; ++irrep_idx) {
+        graph.add_vertex({SuperIrrep,
+                          super_msg.dims[irrep_idx],
+                          superirrep_idx_to_num_positive[irrep_idx],
+                          data.superirrep_idx_to_bag_idx[irrep_idx] == Bag::invalid_idx});
+    }
+    for (int k_idx = 0; k_idx < num_subks; ++k_idx) {
+        graph.add_vertex({SubK});
+    }
+    for (int irrep_idx = 0; irrep_idx < num_subirreps; ++irrep_idx) {
+        graph.add_vertex(
+            {SubIrrep, sub_msg.dims[irrep_idx], data.sub_irrepidx_to_packed_si[irrep_idx].code});
+    }
+    for (int row = 0; row < num_cr_rows; ++row) {
+        graph.add_vertex({CrRow});
+    }
+
+    for (int irrep_idx = 0; irrep_idx < num_superirreps; ++irrep_idx) {
+        graph.add_edge(first_superk + super_msg.irrepidx_to_kidx[irrep_idx],
+                       first_superirrep + irrep_idx,
+                       Member);
+        const int bag_idx = data.superirrep_idx_to_bag_idx[irrep_idx];
+        if (bag_idx != Bag::invalid_idx) {
+            for (const auto &[_, subirrep_idx] :
+                 data.unique_bags[bag_idx].subk_idx_and_subirrep_idx_pairs) {
+                graph.add_edge(
+                    first_superirrep + irrep_idx, first_subirrep + subirrep_idx, Member);
+            }
+        }
+    }
+    for (int k_idx = 0; k_idx < num_subks; ++k_idx) {
+        graph.add_edge(
+            first_superk + data.subk_idx_to_superk_idx(k_idx), first_subk + k_idx, Member);
+    }
+    for (int irrep_idx = 0; irrep_idx < num_subirreps; ++irrep_idx) {
+        graph.add_edge(
+            first_subk + sub_msg.irrepidx_to_kidx[irrep_idx], first_subirrep + irrep_idx, Member);
+    }
+    for (const auto &[msg, first_k, first_irrep] :
+         {std::tuple{&super_msg, first_superk, first_superirrep},
+          std::tuple{&sub_msg, first_subk, first_subirrep}}) {
+        for (const auto &[k1_idx, k2_idx, irrep1idx_to_irrep2idx] :
+             msg->k1idx_k2idx_irrep1idxtoirrep2idx_tuples) {
+            graph.add_edge(first_k + k1_idx, first_k + k2_idx, Image);
+            for (int irrep1_idx = 0; irrep1_idx < static_cast<int>(irrep1idx_to_irrep2idx.size());
+                 ++irrep1_idx) {
+                if (irrep1idx_to_irrep2idx[irrep1_idx] >= 0) {
+                    graph.add_edge(first_irrep + irrep1_idx,
+                                   first_irrep + irrep1idx_to_irrep2idx[irrep1_idx],
+                                   Image);
+                }
+            }
+        }
+    }
+    for (int row = 0; row < num_cr_rows; ++row) {
+        for (int irrep_idx = 0; irrep_idx < num_subirreps; ++irrep_idx) {
+            if (const int entry = sub_msg.comp_rels_matrix(row, irrep_idx); entry != 0) {
+                graph.add_edge(first_cr_row + row, first_subirrep + irrep_idx, Entry, entry);
+            }
+        }
+    }
+
+    // Form of the problem in the numbering `order`.
+    const auto to_form = [&](const std::vector<int> &order) {
+        CanonicalForm result{
+            .superk_idx_to_canonical_idx = to_canonical_idxs(order, first_superk, num_superks),
+            .superirrep_idx_to_canonical_idx =
+                to_canonical_idxs(order, first_superirrep, num_superirreps),
+            .subk_idx_to_canonical_idx = to_canonical_idxs(order, first_subk, num_subks),
+            .subirrep_idx_to_canonical_idx = to_canonical_idxs(order, first_subirrep, num_subirreps)};
+        const auto canonical_cr_row_idxs = to_canonical_idxs(order, first_cr_row, num_cr_rows);
+
+        ContentWriter writer;
+        writer.add(static_cast<long>(num_superks));
+        for (const int irrep_idx : invert(result.superirrep_idx_to_canonical_idx)) {
+            writer.add(static_cast<long>(
+                result.superk_idx_to_canonical_idx[super_msg.irrepidx_to_kidx[irrep_idx]]));
+            writer.add(static_cast<long>(super_msg.dims[irrep_idx]));
+            writer.add(superirrep_idx_to_num_positive[irrep_idx]);
+            const int bag_idx = data.superirrep_idx_to_bag_idx[irrep_idx];
+            std::vector<int> bag;
+            if (bag_idx != Bag::invalid_idx) {
+                for (const auto &[_, subirrep_idx] :
+                     data.unique_bags[bag_idx].subk_idx_and_subirrep_idx_pairs) {
+                    bag.push_back(result.subirrep_idx_to_canonical_idx[subirrep_idx]);
+                }
+                std::sort(bag.begin(), bag.end());
+            }
+            writer.add(static_cast<long>(bag_idx == Bag::invalid_idx));
+            writer.add(bag);
+        }
+        writer.add(canonical_antiunit_rels(
+            super_msg, result.superk_idx_to_canonical_idx, result.superirrep_idx_to_canonical_idx));
+
+        for (const int k_idx : invert(result.subk_idx_to_canonical_idx)) {
+            const int superk_idx = data.subk_idx_to_superk_idx(k_idx);
+            writer.add(static_cast<long>(result.superk_idx_to_canonical_idx[superk_idx]));
+        }
+        writer.add(sub_msg.si_orders);
+        const auto canonical_subirrep_idx_to_subirrep_idx =
+            invert(result.subirrep_idx_to_canonical_idx);
+        for (const int irrep_idx : canonical_subirrep_idx_to_subirrep_idx) {
+            const int subk_idx = sub_msg.irrepidx_to_kidx[irrep_idx];
+            writer.add(static_cast<long>(result.subk_idx_to_canonical_idx[subk_idx]));
+            writer.add(static_cast<long>(sub_msg.dims[irrep_idx]));
+            writer.add(static_cast<long>(data.sub_irrepidx_to_packed_si[irrep_idx].code));
+        }
+        writer.add(canonical_antiunit_rels(
+            sub_msg, result.subk_idx_to_canonical_idx, result.subirrep_idx_to_canonical_idx));
+
+        writer.add(static_cast<long>(num_cr_rows));
+        for (const int row : invert(canonical_cr_row_idxs)) {
+            for (const int irrep_idx : canonical_subirrep_idx_to_subirrep_idx) {
+                writer.add(static_cast<long>(sub_msg.comp_rels_matrix(row, irrep_idx)));
+            }
+        }
+
+        result.content = std::move(writer.content);
+        return result;
+    };
+
+    // Keep the smallest form over the candidate numberings, which only depends on the graph.
+    std::optional<CanonicalForm> best;
+    graph.visit_orders([&](const std::vector<int> &order) {
+        auto form = to_form(order);
+        if (!best || form.content < best->content) {
+            best = std::move(form);
+        }
+    });
+    return std::move(*best);
+}
+
+SearchResult::Witness CanonicalForm::to_canonical(const SearchResult::Witness &witness) const {
+    SearchResult::Witness result = witness;
+    relabel_k_points(witness.super_k_point(),
+                     superk_idx_to_canonical_idx,
+                     superirrep_idx_to_canonical_idx,
+                     *result.mutable_super_k_point());
+    relabel_k_points(witness.sub_k_point(),
+                     subk_idx_to_canonical_idx,
+                     subirrep_idx_to_canonical_idx,
+                     *result.mutable_sub_k_point());
+    return result;
+}
+
+SearchResult::Witness CanonicalForm::from_canonical(const SearchResult::Witness &witness) const {
+    SearchResult::Witness result = witness;
+    relabel_k_points(witness.super_k_point(),
+                     invert(superk_idx_to_canonical_idx),
+                     invert(superirrep_idx_to_canonical_idx),
+                     *result.mutable_super_k_point());
+    relabel_k_points(witness.sub_k_point(),
+                     invert(subk_idx_to_canonical_idx),
+                     invert(subirrep_idx_to_canonical_idx),
+                     *result.mutable_sub_k_point());
+    return result;
+}
+
+}  // namespace magnon::diagnose2
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "diagnose2/search_result.pb.h"
+#include "diagnose2/spectrum_data.hpp"
+
+namespace magnon::diagnose2 {
+
+// Label-free normal form of the search problem of a `SpectrumData`, which is all the search depends
+// on: the k-points and irreps of both groups, renumbered canonically, with the irrep dimensions,
+// the bags, the subgroup SI and compatibility relation columns, the antiunitary relations and the
+// irreps at the positive energies. Problems differing only in labels and in the order of their
+// k-points, irreps and compatibility relations have the same form, so that they are searched once.
+//
+// The numbering refines the k-points and irreps by these relations until they are told apart.
+// Remaining ties are broken by trying each tied vertex in turn, skipping those an automorphism
+// found so far makes equivalent, and the numbering with the lexicographically smallest content is
+// kept.
+struct CanonicalForm {
+    // Serialization of the problem in canonical indices, equal for isomorphic problems.
+    std::string content;
+
+    // Canonical index of each k-point and irrep, by original index.
+    std::vector<int> superk_idx_to_canonical_idx;
+    std::vector<int> superirrep_idx_to_canonical_idx;
+    std::vector<int> subk_idx_to_canonical_idx;
+    std::vector<int> subirrep_idx_to_canonical_idx;
+
+    // Translate the k-points and irrep indices of a witness of the original problem to the
+    // canonical ones, and back.
+    SearchResult::Witness to_canonical(const SearchResult::Witness &witness) const;
+    SearchResult::Witness from_canonical(const SearchResult::Witness &witness) const;
+};
+
+CanonicalForm make_canonical_form(const SpectrumData &data,
+                                  const std::vector<std::string> &positive_energy_irreps);
+
+}  // namespace magnon::diagnose2
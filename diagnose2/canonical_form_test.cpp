@@ -0,0 +1,96 @@
+#include "diagnose2/canonical_form.hpp"
+
+#include <algorithm>
+#include <numeric>
+#include <random>
+#include <vector>
+
+#include "diagnose2/test_structures.hpp"
+#include "google/protobuf/util/message_differencer.h"
+#include "gtest/gtest.h"
+
+namespace magnon::diagnose2 {
+
+// The structure with the k-points, irreps and compatibility relations of both groups shuffled by
+// `seed`.
+PerturbedBandStructure shuffle_order(PerturbedBandStructure structure, const unsigned seed) {
+    std::mt19937 generator(seed);
+    for (auto *group : {structure.mutable_supergroup(), structure.mutable_subgroup()}) {
+        std::shuffle(group->mutable_little_irrep()->begin(),
+                     group->mutable_little_irrep()->end(),
+                     generator);
+        std::shuffle(group->mutable_kvector()->begin(), group->mutable_kvector()->end(), generator);
+        if (group->has_compatibility_relations_matrix()) {
+            auto &matrix = *group->mutable_compatibility_relations_matrix();
+            const int num_columns = static_cast<int>(matrix.num_columns());
+            std::vector<int> rows(matrix.num_rows());
+            std::iota(rows.begin(), rows.end(), 0);
+            std::shuffle(rows.begin(), rows.end(), generator);
+            const auto entries = matrix.entry();
+            for (int row = 0; row < static_cast<int>(rows.size()); ++row) {
+                for (int column = 0; column < num_columns; ++column) {
+                    matrix.set_entry(row * num_columns + column,
+                                     entries[rows[row] * num_columns + column]);
+                }
+            }
+        }
+    }
+    return structure;
+}
+
+TEST(CanonicalFormTest, IsInvariantUnderReordering) {
+    const auto structure = read_structure();
+    const SpectrumData data(structure);
+    const auto form = make_canonical_form(data, positive_energy_irreps(structure));
+
+    for (unsigned seed = 0; seed < 10; ++seed) {
+        const auto shuffled_structure = shuffle_order(structure, seed);
+        const SpectrumData shuffled_data(shuffled_structure);
+        ASSERT_NE(shuffled_data.sub_msg.irreps, data.sub_msg.irreps);
+        const auto shuffled_form =
+            make_canonical_form(shuffled_data, positive_energy_irreps(shuffled_structure));
+        EXPECT_EQ(shuffled_form.content, form.content) << "seed " << seed;
+
+        // Both number each irrep alike.
+        for (int irrep_idx = 0; irrep_idx < static_cast<int>(data.sub_msg.irreps.size());
+             ++irrep_idx) {
+            const auto &irrep = data.sub_msg.irreps[irrep_idx];
+            EXPECT_EQ(form.subirrep_idx_to_canonical_idx[irrep_idx],
+                      shuffled_form.subirrep_idx_to_canonical_idx[shuffled_data.sub_msg.irrep_to_idx(
+                          irrep)])
+                << "seed " << seed << ", irrep " << irrep;
+        }
+    }
+}
+
+TEST(CanonicalFormTest, DependsOnPositiveEnergyIrreps) {
+    const auto structure = read_structure();
+    const SpectrumData data(structure);
+    auto irreps = positive_energy_irreps(structure);
+    const auto form = make_canonical_form(data, irreps);
+    irreps.pop_back();
+    EXPECT_NE(make_canonical_form(data, irreps).content, form.content);
+}
+
+TEST(CanonicalFormTest, TranslatesWitnessesBack) {
+    const auto structure = read_structure();
+    const SpectrumData data(structure);
+    const auto form = make_canonical_form(data, positive_energy_irreps(structure));
+
+    SearchResult::Witness witness{};
+    witness.set_num_nontrivial_gaps(1);
+    for (int k_idx = 0; k_idx < static_cast<int>(data.super_msg.ks.size()); ++k_idx) {
+        witness.add_super_k_point()->add_irrep_idx(k_idx);
+    }
+    for (int k_idx = 0; k_idx < static_cast<int>(data.sub_msg.ks.size()); ++k_idx) {
+        witness.add_sub_k_point()->add_irrep_idx(k_idx);
+    }
+    const auto canonical_witness = form.to_canonical(witness);
+    EXPECT_EQ(canonical_witness.num_nontrivial_gaps(), 1);
+    EXPECT_EQ(canonical_witness.sub_k_point(form.subk_idx_to_canonical_idx[0]).irrep_idx(0),
+              form.subirrep_idx_to_canonical_idx[0]);
+    EXPECT_TRUE(google::protobuf::util::MessageDifferencer::Equals(
+        form.from_canonical(canonical_witness), witness));
+}
+
+}  // namespace magnon::diagnose2
@@ -0,0 +1,188 @@
+#include "diagnose2/gap_si_evaluator.hpp"
+
+#include <algorithm>
+#include <cassert>
+
+namespace magnon::diagnose2 {
+
+GapSiEvaluator::GapSiEvaluator(const Subband &subband)
+    : subband{subband}, data{subband.get_data()} {
+    const auto num_subks = data.sub_msg.ks.size();
+
+    prefix.gap = 0;
+    prefix.subk_idx_to_numbandsbelow.assign(num_subks, 0);
+    prefix.subk_idx_to_e_idx.assign(num_subks, 0);
+    prefix.si = PackedSi{0};
+    prefix.cr = 0 * data.sub_msg.comp_rels_matrix.col(0);
+
+    for (const auto si : data.sub_irrepidx_to_packed_si) {
+        sub_irrepidx_to_negated_si.push_back(data.sub_si_group.negate(si));
+    }
+    subk_idx_to_mirror_subk_idxs.resize(num_subks);
+    for (const auto &[k1idx, k2idx, _] : data.sub_msg.k1idx_k2idx_irrep1idxtoirrep2idx_tuples) {
+        subk_idx_to_mirror_subk_idxs[k1idx].push_back(k2idx);
+    }
+
+    // Sized once, so that scanning a bracket does not allocate.
+    const int num_bands = subband.get_num_bands();
+    bracket_sis.resize(num_bands);
+    bracket_crs.resize(data.sub_msg.comp_rels_matrix.rows(), num_bands);
+    bracket_numbandsbelow.resize(num_bands);
+    subk_idx_to_window.resize(num_subks);
+}
+
+bool GapSiEvaluator::advance(ScanState &state) const {
+    const int gap = ++state.gap;
+    assert(gap <= subband.get_num_bands());
+
+    for (int subk_idx = 0; subk_idx < static_cast<int>(data.sub_msg.ks.size()); ++subk_idx) {
+        auto &numbandsbelow = state.subk_idx_to_numbandsbelow[subk_idx];
+        auto &e_idx = state.subk_idx_to_e_idx[subk_idx];
+        while (numbandsbelow < gap) {
+            const int cur_subirrep_idx =
+                subband.subk_idx_to_e_idx_to_submode[subk_idx][e_idx].subirrep_idx;
+
+            numbandsbelow += data.sub_msg.dims[cur_subirrep_idx];
+
+            state.si = data.sub_si_group.add(state.si,
+                                             data.sub_irrepidx_to_packed_si[cur_subirrep_idx]);
+            state.cr += data.sub_msg.comp_rels_matrix.col(cur_subirrep_idx);
+
+            ++e_idx;
+        }
+    }
+
+    bool gapped = state.cr.isZero();
+
+    if (gapped) {
+        const auto numbandsbelow = state.subk_idx_to_numbandsbelow[0];
+        for (const auto subk_numbandsbelow : state.subk_idx_to_numbandsbelow) {
+            assert(subk_numbandsbelow == numbandsbelow);
+        }
+        if (numbandsbelow != gap) {
+            gapped = false;
+        }
+    }
+
+    return gapped;
+}
+
+const Vector<std::pair<bool, PackedSi>> &GapSiEvaluator::evaluate(const int gap_begin,
+                                                                 const int gap_end) {
+    assert(gap_begin >= 1);
+    assert(gap_begin <= gap_end);
+    assert(gap_begin > prefix.gap);
+
+    // The spans below `gap_begin` are no longer permuted, so the prefix can move up for good.
+    while (prefix.gap + 1 < gap_begin) {
+        advance(prefix);
+    }
+
+    scratch = prefix;
+    bracket_isgapped_and_sis.resize(gap_end - gap_begin + 1);
+    for (int i = 0; i <= gap_end - gap_begin; ++i) {
+        auto &[is_gapped, si] = bracket_isgapped_and_sis[i];
+        is_gapped = advance(scratch);
+        if (is_gapped) {
+            si = scratch.si;
+        }
+        bracket_sis[i] = scratch.si;
+        bracket_crs.col(i) = scratch.cr;
+        bracket_numbandsbelow[i] = scratch.subk_idx_to_numbandsbelow[0];
+    }
+
+    bracket_gap_begin = gap_begin;
+    bracket_gap_end = gap_end;
+    for (int subk_idx = 0; subk_idx < static_cast<int>(subk_idx_to_window.size()); ++subk_idx) {
+        auto &window = subk_idx_to_window[subk_idx];
+        window.e_idx_begin = prefix.subk_idx_to_e_idx[subk_idx];
+        window.subirrep_idxs.clear();
+        window.numbandsbelow.assign(1, prefix.subk_idx_to_numbandsbelow[subk_idx]);
+        const auto &submodes = subband.subk_idx_to_e_idx_to_submode[subk_idx];
+        for (int e_idx = window.e_idx_begin; e_idx < scratch.subk_idx_to_e_idx[subk_idx]; ++e_idx) {
+            const auto subirrep_idx = submodes[e_idx].subirrep_idx;
+            window.subirrep_idxs.push_back(subirrep_idx);
+            window.numbandsbelow.push_back(window.numbandsbelow.back() +
+                                           data.sub_msg.dims[subirrep_idx]);
+        }
+    }
+
+    return bracket_isgapped_and_sis;
+}
+
+const Vector<std::pair<bool, PackedSi>> &GapSiEvaluator::evaluate(
+    const int gap_begin, const int gap_end, const Vector<SubmodeRange> &changes) {
+    if (gap_begin != bracket_gap_begin || gap_end != bracket_gap_end) {
+        return evaluate(gap_begin, gap_end);
+    }
+
+    for (const auto &range : changes) {
+        bool is_updated = update(range.subk_idx, range);
+        for (const auto mirror_subk_idx : subk_idx_to_mirror_subk_idxs[range.subk_idx]) {
+            is_updated = is_updated && update(mirror_subk_idx, range);
+        }
+        if (!is_updated) {
+            return evaluate(gap_begin, gap_end);
+        }
+    }
+    return bracket_isgapped_and_sis;
+}
+
+bool GapSiEvaluator::update(const int subk_idx, const SubmodeRange &range) {
+    auto &window = subk_idx_to_window[subk_idx];
+    const int begin = range.e_idx_begin - window.e_idx_begin;
+    const int end = range.e_idx_end - window.e_idx_begin;
+    if (begin < 0 || end > static_cast<int>(window.subirrep_idxs.size())) {
+        return false;
+    }
+
+    const auto &submodes = subband.subk_idx_to_e_idx_to_submode[subk_idx];
+    const auto &si_group = data.sub_si_group;
+    const auto &comp_rels_matrix = data.sub_msg.comp_rels_matrix;
+
+    // Only the gaps that the reordered submodes straddle see different submodes below them.
+    const int numbandsbelow_begin = window.numbandsbelow[begin];
+    const int first_gap = std::max(bracket_gap_begin, numbandsbelow_begin + 1);
+    const int last_gap = std::min(bracket_gap_end, window.numbandsbelow[end]);
+    for (int gap = first_gap; gap <= last_gap; ++gap) {
+        const int i = gap - bracket_gap_begin;
+        auto &si = bracket_sis[i];
+        auto cr = bracket_crs.col(i);
+
+        int old_numbandsbelow = numbandsbelow_begin;
+        for (int e = begin; old_numbandsbelow < gap; ++e) {
+            const auto subirrep_idx = window.subirrep_idxs[e];
+            old_numbandsbelow += data.sub_msg.dims[subirrep_idx];
+            si = si_group.add(si, sub_irrepidx_to_negated_si[subirrep_idx]);
+            cr -= comp_rels_matrix.col(subirrep_idx);
+        }
+        int new_numbandsbelow = numbandsbelow_begin;
+        for (int e = begin; new_numbandsbelow < gap; ++e) {
+            const auto subirrep_idx = submodes[window.e_idx_begin + e].subirrep_idx;
+            new_numbandsbelow += data.sub_msg.dims[subirrep_idx];
+            si = si_group.add(si, data.sub_irrepidx_to_packed_si[subirrep_idx]);
+            cr += comp_rels_matrix.col(subirrep_idx);
+        }
+        if (subk_idx == 0) {
+            bracket_numbandsbelow[i] += new_numbandsbelow - old_numbandsbelow;
+        }
+    }
+
+    for (int e = begin; e < end; ++e) {
+        const auto subirrep_idx = submodes[window.e_idx_begin + e].subirrep_idx;
+        window.subirrep_idxs[e] = subirrep_idx;
+        window.numbandsbelow[e + 1] = window.numbandsbelow[e] + data.sub_msg.dims[subirrep_idx];
+    }
+
+    for (int gap = first_gap; gap <= last_gap; ++gap) {
+        const int i = gap - bracket_gap_begin;
+        auto &[is_gapped, si] = bracket_isgapped_and_sis[i];
+        is_gapped = bracket_crs.col(i).isZero() && bracket_numbandsbelow[i] == gap;
+        if (is_gapped) {
+            si = bracket_sis[i];
+        }
+    }
+    return true;
+}
+
+}  // namespace magnon::diagnose2
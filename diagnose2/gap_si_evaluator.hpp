@@ -0,0 +1,78 @@
+#pragma once
+
+#include <utility>
+
+#include "diagnose2/packed_si.hpp"
+#include "diagnose2/spectrum_data.hpp"
+#include "diagnose2/utility.hpp"
+
+namespace magnon::diagnose2 {
+
+// Incremental replacement for `Subband::calc_gap_sis()`, driven by the energetics enumeration.
+//
+// While `Subband::next_energetics()` permutes the spans of one gap bracket, the submodes below the
+// bracket stay put, so the per-k scan state at the bottom of the bracket is cached and only the
+// bracket itself is re-scanned. The cache moves up whenever the enumeration moves on to a later
+// bracket, and must be rebuilt (by constructing a new evaluator) for every new subband.
+//
+// Given the submodes `Subband::next_energetics()` reordered, the scan state of every gap in the
+// bracket is instead updated in place, and only the gaps between the first and last reordered
+// submodes are touched. With `EnergeticsOrder::Transpositions`, that is usually a single gap.
+class GapSiEvaluator {
+ public:
+    explicit GapSiEvaluator(const Subband &subband);
+
+    // Return the (is_gapped, si) pairs of gaps `gap_begin`, ..., `gap_end`, with the same values
+    // `Subband::calc_gap_sis()` would give. `gap_begin` must not decrease between calls.
+    const Vector<std::pair<bool, PackedSi>> &evaluate(int gap_begin, int gap_end);
+    // Same, given that only the submodes at `changes` (mirror images excluded) were reordered since
+    // the last call, as reported by `Subband::last_changes()`.
+    const Vector<std::pair<bool, PackedSi>> &evaluate(int gap_begin,
+                                                      int gap_end,
+                                                      const Vector<SubmodeRange> &changes);
+
+ private:
+    struct ScanState {
+        int gap;  // Last processed gap
+        Vector<int> subk_idx_to_numbandsbelow;
+        Vector<int> subk_idx_to_e_idx;
+        PackedSi si;
+        MatrixInt cr;
+    };
+
+    // Process gap `state.gap + 1` and return whether it is gapped.
+    bool advance(ScanState &state) const;
+
+    // Update the gaps of the bracket whose submodes at `subk_idx` within `range` were reordered.
+    // Return false if the range is outside the submodes the bracket was scanned from.
+    bool update(int subk_idx, const SubmodeRange &range);
+
+    const Subband &subband;
+    const SpectrumData &data;
+
+    ScanState prefix;  // State below the current bracket
+    ScanState scratch;
+    Vector<std::pair<bool, PackedSi>> bracket_isgapped_and_sis;
+
+    Vector<PackedSi> sub_irrepidx_to_negated_si;
+    // Subgroup k-points mirroring each one by antiunitary relations
+    Vector<Vector<int>> subk_idx_to_mirror_subk_idxs;
+
+    // Scan state of each gap of the last scanned bracket, by gap - gap_begin
+    int bracket_gap_begin = 0;
+    int bracket_gap_end = -1;
+    Vector<PackedSi> bracket_sis;
+    MatrixInt bracket_crs;  // One column per gap
+    Vector<int> bracket_numbandsbelow;  // At subgroup k-point 0
+
+    // Submodes the bracket was scanned from at one subgroup k-point, as subgroup irrep indices,
+    // and the bands below each of them
+    struct Window {
+        int e_idx_begin;
+        Vector<int> subirrep_idxs;
+        Vector<int> numbandsbelow;  // One more than `subirrep_idxs`
+    };
+    Vector<Window> subk_idx_to_window;
+};
+
+}  // namespace magnon::diagnose2
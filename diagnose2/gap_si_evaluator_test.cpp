@@ -0,0 +1,65 @@
+#include "diagnose2/gap_si_evaluator.hpp"
+
+#include "diagnose2/test_structures.hpp"
+#include "gtest/gtest.h"
+
+namespace magnon::diagnose2 {
+
+// Check the evaluator against `Subband::calc_gap_sis()` on every model, rescanning each bracket or
+// updating it from `Subband::last_changes()`.
+void check_all_models(const EnergeticsOrder order, const bool use_changes) {
+    const auto structure = read_structure();
+    const SpectrumData data(structure);
+
+    Superband superband(positive_energy_irreps(structure), data);
+    superband.set_energetics_order(order);
+
+    int num_models = 0;
+    do {
+        Subband subband = superband.make_subband();
+        subband.set_energetics_order(order);
+        GapSiEvaluator evaluator(subband);
+        do {
+            int gap_begin = 1;
+            int gap_end = 0;
+            for (const auto &[gaps, _, done] : subband.gaps_allspanstopermute_done_tuples) {
+                if (!done) {
+                    gap_end = gaps.back();
+                    break;
+                }
+                gap_begin = gaps.back() + 1;
+            }
+            if (gap_end < gap_begin) {
+                continue;
+            }
+
+            const auto expected = subband.calc_gap_sis();
+            const auto &actual =
+                use_changes ? evaluator.evaluate(gap_begin, gap_end, subband.last_changes())
+                            : evaluator.evaluate(gap_begin, gap_end);
+            ASSERT_EQ(static_cast<int>(actual.size()), gap_end - gap_begin + 1);
+            for (int gap = gap_begin; gap <= gap_end; ++gap) {
+                const auto &[expected_is_gapped, expected_si] = expected.at(gap);
+                const auto &[is_gapped, si] = actual[gap - gap_begin];
+                ASSERT_EQ(is_gapped, expected_is_gapped) << "gap: " << gap;
+                if (is_gapped) {
+                    ASSERT_EQ(si, expected_si) << "gap: " << gap;
+                }
+            }
+            ++num_models;
+        } while (subband.next_energetics());
+    } while (superband.cartesian_permute());
+
+    EXPECT_GT(num_models, 0);
+}
+
+TEST(GapSiEvaluatorTest, MatchesFullScanForAllModels) {
+    check_all_models(EnergeticsOrder::Lexicographic, false);
+}
+
+TEST(GapSiEvaluatorTest, UpdatesMatchFullScan) {
+    check_all_models(EnergeticsOrder::Lexicographic, true);
+    check_all_models(EnergeticsOrder::Transpositions, true);
+}
+
+}  // namespace magnon::diagnose2
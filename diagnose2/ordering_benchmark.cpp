@@ -0,0 +1,139 @@
+// Compares the superband ordering strategies by the energetics models a diagnosis-only search
+// evaluates before it terminates. For negative diagnoses that is how soon the strategy reaches an
+// excluding model, which decides the runtime far more than the size of the search space.
+//
+// Without arguments, the cases are the structure in `diagnose2/test_data` with its supermodes
+// repeated once to three times, each also with all SIs trivial, which makes it negative. These
+// only have orderings to choose at GM, so a negative case permuting both GM and R is added, which
+// the strategies reach the exclusion of at different times. Further cases are read from the
+// `PerturbedBandStructure` or `PerturbedBandStructures` text files given.
+//
+// Usage: ordering_benchmark [structures.txtpb ...]
+
+#include <chrono>
+#include <iostream>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "fmt/core.h"
+
+#include "diagnose2/analyze_perturbation.hpp"
+#include "diagnose2/test_structures.hpp"
+#include "utils/proto_text_format.hpp"
+
+namespace {
+
+constexpr double TIMEOUT_S = 600.0;
+
+using magnon::diagnose2::OrderingStrategy;
+using magnon::diagnose2::PerturbedBandStructure;
+
+const std::vector<std::pair<OrderingStrategy, std::string>> STRATEGY_AND_NAME_PAIRS = {
+    {OrderingStrategy::Lexicographic, "lexicographic"},
+    {OrderingStrategy::ImpactFirst, "impact_first"},
+    {OrderingStrategy::ImpactFirstInterleaved, "impact_first_interleaved"},
+};
+
+// The test structure with supermodes giving 6 orderings at GM and 20 at R, and with only its Z_4
+// SI, which is 1 for GM1+, 2 for GM1- and R1+, 3 for R1- and 0 elsewhere. All gaps are then trivial
+// only if the bands at GM and R pair up as GM1+ with R1- and GM1- with R1+. That excludes the
+// orderings with the GM4+ supermodes on one side of the GM4- ones and the R1- supermodes on the
+// same side of the R1+ ones, so the order in which GM and R are permuted decides how soon one is
+// reached.
+PerturbedBandStructure two_permuted_k_points_structure() {
+    std::vector<std::string> labels = {"GM_{4}^{+}", "GM_{4}^{+}", "GM_{4}^{-}", "GM_{4}^{-}"};
+    for (int i = 0; i < 6; ++i) {
+        labels.insert(labels.end(), {"M_{1}", "X_{1}"});
+    }
+    labels.insert(labels.end(), 3, "R_{1}^{+}");
+    labels.insert(labels.end(), 3, "R_{1}^{-}");
+    auto structure = magnon::diagnose2::with_trivial_sis(
+        magnon::diagnose2::with_supermodes(magnon::diagnose2::read_structure(), labels));
+
+    auto &subgroup = *structure.mutable_subgroup();
+    auto &si_matrix = *subgroup.mutable_symmetry_indicator_matrix();
+    const int z4_row = static_cast<int>(si_matrix.num_rows()) - 1;
+    for (const auto &[label, si] : std::vector<std::pair<std::string, int>>{
+             {"GM_{1}^{+}", 1}, {"GM_{1}^{-}", 2}, {"R_{1}^{+}", 2}, {"R_{1}^{-}", 3}}) {
+        si_matrix.set_entry(z4_row * static_cast<int>(si_matrix.num_columns()) +
+                                subgroup.irrep_label_to_matrix_column_index().at(label),
+                            si);
+    }
+    return structure;
+}
+
+std::vector<std::pair<std::string, PerturbedBandStructure>> default_cases() {
+    const auto structure = magnon::diagnose2::read_structure();
+
+    std::vector<std::pair<std::string, PerturbedBandStructure>> result;
+    for (int num_copies = 1; num_copies <= 3; ++num_copies) {
+        const auto copies = magnon::diagnose2::make_copies(structure, num_copies);
+        result.emplace_back(fmt::format("test_data x{}", num_copies), copies);
+        result.emplace_back(fmt::format("test_data x{}, trivial SIs", num_copies),
+                            magnon::diagnose2::with_trivial_sis(copies));
+    }
+    result.emplace_back("GM and R permuted, Z_4 SI", two_permuted_k_points_structure());
+    return result;
+}
+
+std::vector<std::pair<std::string, PerturbedBandStructure>> read_cases(const std::string &path) {
+    std::vector<std::pair<std::string, PerturbedBandStructure>> result;
+    magnon::diagnose2::PerturbedBandStructures structures{};
+    try {
+        magnon::utils::proto::read_from_text_file(path, structures);
+    } catch (const std::runtime_error &) {
+        structures.Clear();
+        magnon::utils::proto::read_from_text_file(path, *structures.add_structure());
+    }
+    for (int i = 0; i < structures.structure_size(); ++i) {
+        result.emplace_back(fmt::format("{} #{}", path, i), structures.structure(i));
+    }
+    return result;
+}
+
+}  // namespace
+
+int main(int argc, const char **argv) {
+    auto cases = default_cases();
+    for (int i = 1; i < argc; ++i) {
+        for (auto &case_ : read_cases(argv[i])) {
+            cases.push_back(std::move(case_));
+        }
+    }
+
+    std::map<std::string, long> name_to_total_num_models;
+    std::cout << fmt::format(
+        "{:<40}{:<26}{:>10}{:>14}{:>12}\n", "Case", "Strategy", "Diagnosis", "Models", "Time (s)");
+    for (const auto &[case_name, structure] : cases) {
+        for (const auto &[strategy, strategy_name] : STRATEGY_AND_NAME_PAIRS) {
+            const auto start_time = std::chrono::steady_clock::now();
+            const auto result = magnon::diagnose2::analyze_perturbation(
+                structure,
+                {.timeout_s = TIMEOUT_S,
+                 .ordering_strategy = strategy,
+                 .mode = magnon::diagnose2::SearchMode::DiagnosisOnly});
+            const std::chrono::duration<double> elapsed =
+                std::chrono::steady_clock::now() - start_time;
+
+            const auto diagnosis = result.is_timeout()               ? "timeout"
+                                   : result.is_negative_diagnosis() ? "negative"
+                                                                     : "positive";
+            std::cout << fmt::format("{:<40}{:<26}{:>10}{:>14}{:>12.3f}\n",
+                                     case_name,
+                                     strategy_name,
+                                     diagnosis,
+                                     result.metadata().num_models(),
+                                     elapsed.count());
+            name_to_total_num_models[strategy_name] += result.metadata().num_models();
+        }
+    }
+
+    std::cout << '\n';
+    for (const auto &[_, strategy_name] : STRATEGY_AND_NAME_PAIRS) {
+        std::cout << fmt::format(
+            "{:<66}{:>14}\n", strategy_name + " total", name_to_total_num_models[strategy_name]);
+    }
+}
@@ -0,0 +1,99 @@
+#include "diagnose2/packed_si.hpp"
+
+#include <cassert>
+
+namespace magnon::diagnose2 {
+
+namespace {
+
+constexpr const char *GAPLESS = "G";
+constexpr const char *TRIVIAL_OR_GAPLESS = "TorG";
+
+}  // namespace
+
+SiGroup::SiGroup(const std::vector<int> &si_orders) : orders{si_orders}, num_elements_{1} {
+    for (const auto order : orders) {
+        assert(order >= 1);
+        assert(num_elements_ <= PackedSi::TRIVIAL_OR_GAPLESS_CODE / order);
+        num_elements_ *= order;
+    }
+
+    if (num_elements_ <= MAX_NUM_ELEMENTS_WITH_TABLE) {
+        sum_table.resize(num_elements_ * num_elements_);
+        for (PackedSi::Code lhs = 0; lhs < num_elements_; ++lhs) {
+            for (PackedSi::Code rhs = 0; rhs < num_elements_; ++rhs) {
+                sum_table[lhs * num_elements_ + rhs] = add_digitwise({lhs}, {rhs}).code;
+            }
+        }
+    }
+}
+
+PackedSi SiGroup::pack(const MatrixInt &si) const {
+    assert(si.size() == static_cast<int>(orders.size()));
+
+    PackedSi::Code code = 0;
+    for (int i = 0; i < static_cast<int>(orders.size()); ++i) {
+        const int order = orders[i];
+        code = code * order + ((si(i) % order) + order) % order;
+    }
+    return {code};
+}
+
+MatrixInt SiGroup::unpack(PackedSi si) const {
+    assert(si.code < num_elements_);
+
+    MatrixInt result(orders.size(), 1);
+    for (int i = static_cast<int>(orders.size()) - 1; i >= 0; --i) {
+        result(i) = si.code % orders[i];
+        si.code /= orders[i];
+    }
+    return result;
+}
+
+std::string SiGroup::to_string(const PackedSi si) const {
+    if (si.is_gapless()) {
+        return GAPLESS;
+    }
+    if (si == PackedSi::trivial_or_gapless()) {
+        return TRIVIAL_OR_GAPLESS;
+    }
+
+    const auto components = unpack(si);
+    std::string result;
+    for (int i = 0; i < components.size(); ++i) {
+        result += std::to_string(components(i));
+    }
+    return result;
+}
+
+PackedSi SiGroup::negate(PackedSi si) const {
+    assert(si.code < num_elements_);
+
+    PackedSi::Code result = 0;
+    PackedSi::Code place_value = 1;
+    for (int i = static_cast<int>(orders.size()) - 1; i >= 0; --i) {
+        const auto order = static_cast<PackedSi::Code>(orders[i]);
+        result += place_value * ((order - si.code % order) % order);
+        si.code /= order;
+        place_value *= order;
+    }
+    return {result};
+}
+
+PackedSi SiGroup::add_digitwise(PackedSi lhs, PackedSi rhs) const {
+    assert(lhs.code < num_elements_);
+    assert(rhs.code < num_elements_);
+
+    PackedSi::Code result = 0;
+    PackedSi::Code place_value = 1;
+    for (int i = static_cast<int>(orders.size()) - 1; i >= 0; --i) {
+        const auto order = static_cast<PackedSi::Code>(orders[i]);
+        result += place_value * ((lhs.code % order + rhs.code % order) % order);
+        lhs.code /= order;
+        rhs.code /= order;
+        place_value *= order;
+    }
+    return {result};
+}
+
+}  // namespace magnon::diagnose2
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <cstdint>
+#include <limits>
+#include <string>
+#include <vector>
+
+#include "diagnose2/utility.hpp"
+
+namespace magnon::diagnose2 {
+
+// A symmetry indicator packed into a mixed-radix integer, whose i-th digit (most significant
+// first) is the i-th SI component, with radix `si_orders[i]`. The trivial SI is packed as 0.
+//
+// The packing lets the inner loop of the search add, compare and hash SIs without allocating.
+// Converting from/to the matrix and string representations goes through `SiGroup`.
+struct PackedSi {
+    using Code = std::uint32_t;
+
+    // Codes reserved for the pseudo-SIs used when summarizing gaps. They compare greater than
+    // every genuine SI.
+    static constexpr Code TRIVIAL_OR_GAPLESS_CODE = std::numeric_limits<Code>::max() - 1;
+    static constexpr Code GAPLESS_CODE = std::numeric_limits<Code>::max();
+
+    static constexpr PackedSi trivial_or_gapless() { return {TRIVIAL_OR_GAPLESS_CODE}; }
+    static constexpr PackedSi gapless() { return {GAPLESS_CODE}; }
+
+    bool is_trivial() const { return code == 0; }
+    bool is_gapless() const { return code == GAPLESS_CODE; }
+
+    auto operator<=>(const PackedSi &) const = default;
+
+    Code code;
+};
+
+// The symmetry-indicator group Z_{n_1} x Z_{n_2} x ..., with a precomputed addition table.
+class SiGroup {
+ public:
+    SiGroup() : SiGroup(std::vector<int>{}) {}
+    explicit SiGroup(const std::vector<int> &si_orders);
+
+    int num_elements() const { return static_cast<int>(num_elements_); }
+
+    // Pack `si`, reducing each component modulo its order.
+    PackedSi pack(const MatrixInt &si) const;
+    MatrixInt unpack(PackedSi si) const;
+
+    // Concatenated decimal components, e.g. "0103", or "G"/"TorG" for the pseudo-SIs.
+    std::string to_string(PackedSi si) const;
+
+    PackedSi add(const PackedSi lhs, const PackedSi rhs) const {
+        if (!sum_table.empty()) {
+            return {sum_table[lhs.code * num_elements_ + rhs.code]};
+        }
+        return add_digitwise(lhs, rhs);
+    }
+
+    PackedSi negate(PackedSi si) const;
+
+ private:
+    PackedSi add_digitwise(PackedSi lhs, PackedSi rhs) const;
+
+    // The full addition table takes `num_elements^2` bytes; larger groups add digit by digit.
+    static constexpr PackedSi::Code MAX_NUM_ELEMENTS_WITH_TABLE = 256;
+
+    std::vector<int> orders;
+    PackedSi::Code num_elements_;
+    std::vector<std::uint8_t> sum_table;
+};
+
+}  // namespace magnon::diagnose2
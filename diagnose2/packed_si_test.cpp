@@ -0,0 +1,68 @@
+#include "diagnose2/packed_si.hpp"
+
+#include "gtest/gtest.h"
+
+namespace magnon::diagnose2 {
+
+MatrixInt make_si(const std::vector<int> &components) {
+    MatrixInt result(components.size(), 1);
+    for (int i = 0; i < static_cast<int>(components.size()); ++i) {
+        result(i) = components[i];
+    }
+    return result;
+}
+
+TEST(SiGroupTest, PacksAndUnpacks) {
+    const SiGroup group({2, 2, 2, 4});
+    EXPECT_EQ(group.num_elements(), 32);
+
+    EXPECT_TRUE(group.pack(make_si({0, 0, 0, 0})).is_trivial());
+    EXPECT_TRUE(group.pack(make_si({2, 4, -2, 8})).is_trivial());
+    EXPECT_EQ(group.pack(make_si({1, 0, 1, 3})), group.pack(make_si({3, 2, -1, 7})));
+
+    for (int code = 0; code < group.num_elements(); ++code) {
+        const PackedSi si{static_cast<PackedSi::Code>(code)};
+        EXPECT_EQ(group.pack(group.unpack(si)), si);
+    }
+}
+
+TEST(SiGroupTest, ConvertsToString) {
+    const SiGroup group({2, 12});
+
+    EXPECT_EQ(group.to_string(group.pack(make_si({1, 11}))), "111");
+    EXPECT_EQ(group.to_string(group.pack(make_si({0, 3}))), "03");
+    EXPECT_EQ(group.to_string(PackedSi::gapless()), "G");
+    EXPECT_EQ(group.to_string(PackedSi::trivial_or_gapless()), "TorG");
+}
+
+TEST(SiGroupTest, AddsModuloOrders) {
+    // The first group uses the addition table, the second adds digit by digit.
+    for (const auto &orders : {std::vector<int>{2, 3, 4}, std::vector<int>{12, 12, 6}}) {
+        const SiGroup group(orders);
+        for (int lhs = 0; lhs < group.num_elements(); lhs += 7) {
+            for (int rhs = 0; rhs < group.num_elements(); rhs += 5) {
+                const PackedSi lhs_si{static_cast<PackedSi::Code>(lhs)};
+                const PackedSi rhs_si{static_cast<PackedSi::Code>(rhs)};
+                EXPECT_EQ(group.add(lhs_si, rhs_si),
+                          group.pack(group.unpack(lhs_si) + group.unpack(rhs_si)));
+            }
+        }
+    }
+}
+
+TEST(SiGroupTest, Negates) {
+    const SiGroup group({2, 3, 4});
+    for (int code = 0; code < group.num_elements(); ++code) {
+        const PackedSi si{static_cast<PackedSi::Code>(code)};
+        EXPECT_TRUE(group.add(si, group.negate(si)).is_trivial());
+    }
+}
+
+TEST(SiGroupTest, PseudoSisCompareGreaterThanGenuineSis) {
+    const SiGroup group({6, 6, 6});
+    const PackedSi largest{static_cast<PackedSi::Code>(group.num_elements() - 1)};
+    EXPECT_LT(largest, PackedSi::trivial_or_gapless());
+    EXPECT_LT(PackedSi::trivial_or_gapless(), PackedSi::gapless());
+}
+
+}  // namespace magnon::diagnose2
@@ -0,0 +1,160 @@
+#include "diagnose2/prescreen.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "gap_si_evaluator.hpp"
+#include "witness.hpp"
+
+namespace magnon::diagnose2 {
+
+namespace {
+
+// Transpositions tried on a gap bracket, per submode of its spans, before giving it up
+constexpr long NUM_STEPS_PER_SUBMODE = 16;
+
+int count_trivial_or_gapless(const Vector<std::pair<bool, PackedSi>> &isgapped_and_sis) {
+    return std::count_if(isgapped_and_sis.begin(), isgapped_and_sis.end(), [](const auto &pair) {
+        const auto &[is_gapped, si] = pair;
+        return !is_gapped || si.is_trivial();
+    });
+}
+
+// Submodes `i`, ..., `j` of `span`, with `i <= j`.
+SubmodeRange range_of(const Subband &subband, const Span span, const int i, const int j) {
+    const int subk_idx = subband.get_data().sub_msg.irrepidx_to_kidx[span.front().subirrep_idx];
+    const int e_idx_begin = span.data() - subband.subk_idx_to_e_idx_to_submode[subk_idx].data();
+    return {subk_idx, e_idx_begin + i, e_idx_begin + j + 1};
+}
+
+// Reorder the spans of the gap bracket spanning gaps `gap_begin`, ..., `gap_end` towards a model
+// with all those gaps trivial or gapless, and return whether one was reached. Transpositions that
+// lower the number of trivial or gapless gaps are undone.
+bool settle_bracket(Subband &subband,
+                    const Vector<Span> &spans,
+                    const int gap_begin,
+                    const int gap_end,
+                    GapSiEvaluator &gap_si_evaluator,
+                    std::mt19937_64 &rng,
+                    CancellationPoll &poll) {
+    const int width = gap_end - gap_begin + 1;
+    long num_submodes = 0;
+    for (const auto &span : spans) {
+        std::shuffle(span.begin(), span.end(), rng);
+        subband.fix_antiunit_rels(span);
+        num_submodes += span.size();
+    }
+    int count = count_trivial_or_gapless(gap_si_evaluator.evaluate(gap_begin, gap_end));
+
+    Vector<SubmodeRange> changes(1);
+    for (long step = 0; count < width && step < NUM_STEPS_PER_SUBMODE * num_submodes; ++step) {
+        if (poll.should_stop()) {
+            return false;
+        }
+        const auto &span = spans[std::uniform_int_distribution<int>(0, spans.size() - 1)(rng)];
+        std::uniform_int_distribution<int> e_idx_distribution(0, span.size() - 1);
+        int i = e_idx_distribution(rng);
+        int j = e_idx_distribution(rng);
+        if (i > j) {
+            std::swap(i, j);
+        }
+        if (span[i] == span[j]) {
+            continue;
+        }
+
+        std::swap(span[i], span[j]);
+        subband.fix_antiunit_rels(span);
+        changes.front() = range_of(subband, span, i, j);
+        const int new_count =
+            count_trivial_or_gapless(gap_si_evaluator.evaluate(gap_begin, gap_end, changes));
+        if (new_count >= count) {
+            count = new_count;
+            continue;
+        }
+        std::swap(span[i], span[j]);
+        subband.fix_antiunit_rels(span);
+        gap_si_evaluator.evaluate(gap_begin, gap_end, changes);
+    }
+    return count == width;
+}
+
+// Draw a random ordering into `superband` and look for a model of it with all gaps trivial or
+// gapless. Any ordering of the supermodes at a k-point has the subband of the ordering the
+// enumeration visits with the same bags in the same order.
+std::optional<SearchResult::Witness> sample_ordering(Superband &superband,
+                                                     std::mt19937_64 &rng,
+                                                     CancellationPoll &poll) {
+    for (const auto k_idx : superband.permuted_k_idxs()) {
+        auto &supermodes = superband.k_idx_to_e_idx_to_supermode[k_idx];
+        std::shuffle(supermodes.begin(), supermodes.end(), rng);
+    }
+    superband.fix_antiunit_rels();
+
+    // The gaps of a bracket only depend on which submodes lie below it, not on their order, so the
+    // brackets can be settled one at a time, as the enumeration bounds them.
+    Subband subband = superband.make_subband();
+    GapSiEvaluator gap_si_evaluator(subband);
+    int gap_begin = 1;
+    for (const auto &[gaps, spans, _] : subband.gaps_allspanstopermute_done_tuples) {
+        const int gap_end = gaps.back();
+        assert(gap_end >= gap_begin);
+        if (!settle_bracket(subband, spans, gap_begin, gap_end, gap_si_evaluator, rng, poll)) {
+            return std::nullopt;
+        }
+        gap_begin = gap_end + 1;
+    }
+    if (gap_begin <= subband.get_num_bands()) {
+        return std::nullopt;
+    }
+    return make_witness(superband, subband, /*num_nontrivial_gaps=*/0);
+}
+
+}  // namespace
+
+std::optional<SearchResult::Witness> find_exclusion_witness(const Superband &superband,
+                                                            const long num_orderings,
+                                                            const int num_threads,
+                                                            const std::uint64_t seed,
+                                                            Cancellation &cancellation) {
+    std::mutex mutex;
+    std::optional<SearchResult::Witness> result;
+    std::atomic<bool> is_found = false;
+
+    const auto sample_orderings = [&](const int thread_idx) {
+        std::seed_seq seed_seq{seed, static_cast<std::uint64_t>(thread_idx)};
+        std::mt19937_64 rng(seed_seq);
+        Superband sampled = superband;
+        CancellationPoll poll(cancellation);
+        for (long i = thread_idx; i < num_orderings && !is_found; i += num_threads) {
+            if (poll.should_stop()) {
+                return;
+            }
+            if (auto witness = sample_ordering(sampled, rng, poll)) {
+                const std::lock_guard lock(mutex);
+                if (!result) {
+                    result = std::move(witness);
+                }
+                is_found = true;
+                return;
+            }
+        }
+    };
+
+    if (num_threads <= 1) {
+        sample_orderings(0);
+    } else {
+        std::vector<std::jthread> threads;
+        for (int thread_idx = 0; thread_idx < num_threads; ++thread_idx) {
+            threads.emplace_back(sample_orderings, thread_idx);
+        }
+    }
+    return result;
+}
+
+}  // namespace magnon::diagnose2
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+
+#include "diagnose2/cancellation.hpp"
+#include "diagnose2/search_result.pb.h"
+#include "diagnose2/spectrum_data.hpp"
+
+namespace magnon::diagnose2 {
+
+// Look for an energetics model with all its gaps trivial or gapless, which excludes the
+// perturbation, among `num_orderings` random superband orderings of the unpermuted `superband`.
+// The gap brackets of each ordering are settled one by one, by hill climbing over transpositions
+// within their spans from a random start. The orderings are shared out between `num_threads`
+// threads, each drawing them from its own generator seeded from `seed`.
+//
+// Return the first model found, which is one of those `analyze_perturbation()` enumerates, or
+// nothing if there is none among the samples or the search is cancelled first.
+std::optional<SearchResult::Witness> find_exclusion_witness(const Superband &superband,
+                                                            long num_orderings,
+                                                            int num_threads,
+                                                            std::uint64_t seed,
+                                                            Cancellation &cancellation);
+
+}  // namespace magnon::diagnose2
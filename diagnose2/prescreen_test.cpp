@@ -0,0 +1,55 @@
+#include "diagnose2/prescreen.hpp"
+
+#include <atomic>
+
+#include "diagnose2/test_structures.hpp"
+#include "diagnose2/witness.hpp"
+#include "gtest/gtest.h"
+
+namespace magnon::diagnose2 {
+
+Superband make_superband(const PerturbedBandStructure &structure, const SpectrumData &data) {
+    Superband result(positive_energy_irreps(structure), data);
+    result.fix_antiunit_rels();
+    return result;
+}
+
+TEST(PrescreenTest, FindsWitnessReplayingToAllGapsTrivialOrGapless) {
+    const auto structure = with_trivial_sis(read_structure());
+    const SpectrumData data(structure);
+    const auto superband = make_superband(structure, data);
+    for (const int num_threads : {1, 3}) {
+        Cancellation cancellation;
+        const auto witness =
+            find_exclusion_witness(superband, 16, num_threads, /*seed=*/0, cancellation);
+        ASSERT_TRUE(witness);
+        EXPECT_EQ(witness->num_nontrivial_gaps(), 0);
+
+        const auto model = replay_witness(*witness, data);
+        for (const auto &[gap, isgapped_and_si] : model->subband.calc_gap_sis()) {
+            const auto &[is_gapped, si] = isgapped_and_si;
+            EXPECT_TRUE(!is_gapped || si.is_trivial()) << "gap " << gap;
+        }
+    }
+}
+
+TEST(PrescreenTest, FindsNothingForPositiveDiagnosis) {
+    // The regression test case has a nontrivial gap in every model.
+    const auto structure = read_structure();
+    const SpectrumData data(structure);
+    Cancellation cancellation;
+    EXPECT_FALSE(find_exclusion_witness(
+        make_superband(structure, data), 64, 3, /*seed=*/0, cancellation));
+}
+
+TEST(PrescreenTest, FindsNothingOnceCancelled) {
+    const auto structure = with_trivial_sis(read_structure());
+    const SpectrumData data(structure);
+    const std::atomic<bool> interrupt = true;
+    Cancellation cancellation(std::nullopt, &interrupt, {});
+    ASSERT_TRUE(cancellation.check(Cancellation::Clock::now()));
+    EXPECT_FALSE(find_exclusion_witness(
+        make_superband(structure, data), 16, 1, /*seed=*/0, cancellation));
+}
+
+}  // namespace magnon::diagnose2
@@ -0,0 +1,113 @@
+#include "diagnose2/search_cache.hpp"
+
+#include <unistd.h>
+
+#include <atomic>
+#include <cassert>
+#include <cstdint>
+#include <fstream>
+#include <stdexcept>
+#include <utility>
+
+#include "fmt/core.h"
+
+#include "diagnose2/search_cache.pb.h"
+
+namespace magnon::diagnose2 {
+
+namespace {
+
+namespace fs = std::filesystem;
+
+// 64-bit FNV-1a
+std::uint64_t fnv1a_hash(const std::string &content) {
+    std::uint64_t result = 0xcbf29ce484222325;
+    for (const unsigned char c : content) {
+        result = (result ^ c) * 0x100000001b3;
+    }
+    return result;
+}
+
+}  // namespace
+
+SearchKey make_search_key(const SpectrumData &data,
+                          const std::vector<std::string> &positive_energy_irreps,
+                          const EnergeticsOrder energetics_order,
+                          const OrderingStrategy ordering_strategy) {
+    auto canonical_form = make_canonical_form(data, positive_energy_irreps);
+    auto content = fmt::format("{};{};{};{}",
+                               SEARCH_ENGINE_VERSION,
+                               static_cast<int>(energetics_order),
+                               static_cast<int>(ordering_strategy),
+                               canonical_form.content);
+    const std::uint64_t hash = fnv1a_hash(content);
+    return {.content = std::move(content),
+            .hash = fmt::format("{:016x}", hash),
+            .canonical_form = std::move(canonical_form)};
+}
+
+SearchCache::SearchCache(fs::path dir) : dir{std::move(dir)} {}
+
+std::optional<SearchResult> SearchCache::find(const SearchKey &key) const {
+    std::ifstream in(entry_path(key), std::ios::binary);
+    if (!in) {
+        return std::nullopt;
+    }
+    SearchCacheEntry entry{};
+    // A truncated or otherwise unreadable entry is a miss, and is overwritten by the next insert.
+    if (!entry.ParseFromIstream(&in) || entry.key_content() != key.content) {
+        return std::nullopt;
+    }
+    auto &result = *entry.mutable_search_result();
+    if (result.has_min_nontrivial_witness()) {
+        *result.mutable_min_nontrivial_witness() =
+            key.canonical_form.from_canonical(result.min_nontrivial_witness());
+    }
+    if (result.has_max_nontrivial_witness()) {
+        *result.mutable_max_nontrivial_witness() =
+            key.canonical_form.from_canonical(result.max_nontrivial_witness());
+    }
+    return std::move(result);
+}
+
+void SearchCache::insert(const SearchKey &key, const SearchResult &result) const {
+    assert(!result.is_timeout());
+    SearchCacheEntry entry{};
+    entry.set_key_content(key.content);
+    auto &search_result = *entry.mutable_search_result() = result;
+    search_result.clear_supergroup_number();
+    search_result.clear_supergroup_label();
+    search_result.clear_atomic_orbital();
+    search_result.clear_subgroup_number();
+    search_result.clear_subgroup_label();
+    search_result.clear_supergroup_from_subgroup_basis();
+    if (search_result.has_min_nontrivial_witness()) {
+        *search_result.mutable_min_nontrivial_witness() =
+            key.canonical_form.to_canonical(search_result.min_nontrivial_witness());
+    }
+    if (search_result.has_max_nontrivial_witness()) {
+        *search_result.mutable_max_nontrivial_witness() =
+            key.canonical_form.to_canonical(search_result.max_nontrivial_witness());
+    }
+
+    const fs::path path = entry_path(key);
+    fs::create_directories(path.parent_path());
+    // Unique among the threads and processes writing the same entry
+    static std::atomic<long> num_inserts = 0;
+    const fs::path tmp_path = fmt::format("{}.{}.{}.tmp", path.string(), getpid(), num_inserts++);
+    {
+        std::ofstream out(tmp_path, std::ios::binary);
+        if (!entry.SerializeToOstream(&out)) {
+            throw std::runtime_error(
+                fmt::format("Unable to write search cache entry \"{}\"", tmp_path.string()));
+        }
+    }
+    fs::rename(tmp_path, path);
+}
+
+fs::path SearchCache::entry_path(const SearchKey &key) const {
+    return dir / fmt::format("v{}", SEARCH_ENGINE_VERSION) / key.hash.substr(0, 2) /
+           (key.hash + ".pb");
+}
+
+}  // namespace magnon::diagnose2
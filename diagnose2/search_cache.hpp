@@ -0,0 +1,53 @@
+#pragma once
+
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "diagnose2/canonical_form.hpp"
+#include "diagnose2/search_result.pb.h"
+#include "diagnose2/spectrum_data.hpp"
+
+namespace magnon::diagnose2 {
+
+// Version of the search embedded in the cache keys. Bump it with any change to
+// `analyze_perturbation()` that changes its results, which retires all the cached ones.
+constexpr int SEARCH_ENGINE_VERSION = 2;
+
+// Identifies a search by everything its result depends on: the engine version, the energetics
+// order, the ordering strategy and the canonical form of the search problem. Structures whose
+// problems are isomorphic share their searches.
+struct SearchKey {
+    std::string content;
+    std::string hash;  // Hex digest of `content`
+    // Relates the structure to the canonical indices the witnesses of the cache entry are in.
+    CanonicalForm canonical_form;
+};
+
+SearchKey make_search_key(const SpectrumData &data,
+                          const std::vector<std::string> &positive_energy_irreps,
+                          EnergeticsOrder energetics_order,
+                          OrderingStrategy ordering_strategy = OrderingStrategy::Lexicographic);
+
+// Search results stored on disk by key, one file per search, which is safe to share between
+// concurrent processes: entries are written to a temporary file and renamed into place. Entries
+// hold their whole key, so that hash collisions are detected rather than returned.
+class SearchCache {
+ public:
+    explicit SearchCache(std::filesystem::path dir);
+
+    // The stored result of the search, without the fields describing the searched structure. Its
+    // witnesses are models of the structure `key` was made from, though not necessarily the ones
+    // its own search would find.
+    std::optional<SearchResult> find(const SearchKey &key) const;
+    // Store `result`, which must not be a timeout.
+    void insert(const SearchKey &key, const SearchResult &result) const;
+
+ private:
+    std::filesystem::path entry_path(const SearchKey &key) const;
+
+    std::filesystem::path dir;
+};
+
+}  // namespace magnon::diagnose2
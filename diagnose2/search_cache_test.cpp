@@ -0,0 +1,52 @@
+#include "diagnose2/search_cache.hpp"
+
+#include <filesystem>
+
+#include "diagnose2/test_structures.hpp"
+#include "gtest/gtest.h"
+
+namespace magnon::diagnose2 {
+
+SearchKey make_key(const PerturbedBandStructure &structure,
+                   const EnergeticsOrder energetics_order = EnergeticsOrder::Lexicographic) {
+    return make_search_key(
+        SpectrumData(structure), positive_energy_irreps(structure), energetics_order);
+}
+
+TEST(SearchKeyTest, DependsOnSearchRelevantContentOnly) {
+    const auto structure = read_structure();
+    const auto key = make_key(structure);
+    EXPECT_EQ(key.hash.size(), 16);
+
+    auto relabeled = structure;
+    relabeled.mutable_supergroup()->set_label("relabeled");
+    EXPECT_EQ(make_key(relabeled).content, key.content);
+
+    EXPECT_NE(make_key(structure, EnergeticsOrder::Transpositions).hash, key.hash);
+
+    EXPECT_NE(make_key(with_trivial_sis(structure)).hash, key.hash);
+}
+
+TEST(SearchCacheTest, StoresResultsWithoutStructureFields) {
+    const auto dir = std::filesystem::path(testing::TempDir()) / "search_cache_test";
+    std::filesystem::remove_all(dir);
+    const SearchCache cache(dir);
+    const auto key = make_key(read_structure());
+    EXPECT_FALSE(cache.find(key));
+
+    SearchResult result{};
+    result.set_supergroup_label("Pa\\bar{3}");
+    result.set_is_timeout(false);
+    result.set_is_negative_diagnosis(true);
+    cache.insert(key, result);
+
+    const auto cached_result = cache.find(key);
+    ASSERT_TRUE(cached_result);
+    EXPECT_FALSE(cached_result->has_supergroup_label());
+    EXPECT_TRUE(cached_result->is_negative_diagnosis());
+
+    // A key colliding with a stored one misses.
+    EXPECT_FALSE(cache.find({.content = "other", .hash = key.hash}));
+}
+
+}  // namespace magnon::diagnose2
@@ -0,0 +1,106 @@
+#include "diagnose2/search_space.hpp"
+
+#include <algorithm>
+#include <map>
+#include <string>
+#include <utility>
+
+#include "formula/replace_formulas.hpp"
+#include "spectrum_data.hpp"
+
+namespace magnon::diagnose2 {
+
+namespace {
+
+// Number of distinct orderings of the multiset `keys`: n! / (n_1! n_2! ...).
+double num_distinct_orderings(std::vector<int> keys) {
+    std::sort(keys.begin(), keys.end());
+    double result = 1.0;
+    int num_placed = 0;
+    for (auto it = keys.begin(); it != keys.end();) {
+        const auto next = std::upper_bound(it, keys.end(), *it);
+        for (int multiplicity = 1; it != next; ++it, ++multiplicity) {
+            result = result * (++num_placed) / multiplicity;
+        }
+    }
+    return result;
+}
+
+}  // namespace
+
+SearchSpaceEstimate estimate_search_space(const PerturbedBandStructure &perturbed_structure,
+                                          const long max_num_orderings) {
+    const auto structure = formula::maybe_with_alternative_si_formulas(perturbed_structure);
+    SearchSpaceEstimate result{};
+    if (structure.subgroup().symmetry_indicator_order_size() == 0) {
+        return result;
+    }
+
+    const SpectrumData data(structure);
+    std::vector<std::string> positive_energy_irreps;
+    for (const auto &irrep : structure.unperturbed_band_structure().supergroup_little_irrep()) {
+        positive_energy_irreps.push_back(irrep.label());
+    }
+    Superband superband(positive_energy_irreps, data);
+    superband.fix_antiunit_rels();
+
+    result.num_superband_orderings = 1.0;
+    for (const auto k_idx : superband.permuted_k_idxs()) {
+        std::vector<int> bag_idxs;
+        for (const auto &supermode : superband.k_idx_to_e_idx_to_supermode[k_idx]) {
+            bag_idxs.push_back(supermode.bag_idx);
+        }
+        const double num_orderings = num_distinct_orderings(std::move(bag_idxs));
+        result.k_points.push_back({.k_idx = k_idx, .num_orderings = num_orderings});
+        result.num_superband_orderings *= num_orderings;
+    }
+
+    // `Subband::next_energetics()` runs the span odometer of each bracket in turn, and yields one
+    // more model when it finishes the last one.
+    std::map<std::pair<int, int>, SearchSpaceEstimate::Bracket> gap_range_to_bracket;
+    double num_visited_models = 0.0;
+    Subband subband = superband.make_subband();
+    const auto next_ordering = [&]() {
+        if (!superband.cartesian_permute()) {
+            return false;
+        }
+        subband.rebase(superband, superband.last_changed_k_idx());
+        return true;
+    };
+    do {
+        int gap_begin = 1;
+        for (const auto &[gaps, allspanstopermute, _] :
+             subband.gaps_allspanstopermute_done_tuples) {
+            double num_models = 1.0;
+            for (const auto &span : allspanstopermute) {
+                std::vector<int> subirrep_idxs;
+                for (const auto &submode : span) {
+                    subirrep_idxs.push_back(submode.subirrep_idx);
+                }
+                num_models *= num_distinct_orderings(std::move(subirrep_idxs));
+            }
+
+            const int gap_end = gaps.back();
+            auto &bracket = gap_range_to_bracket[{gap_begin, gap_end}];
+            bracket.gap_begin = gap_begin;
+            bracket.gap_end = gap_end;
+            ++bracket.num_orderings;
+            bracket.num_models += num_models;
+            num_visited_models += num_models;
+            gap_begin = gap_end + 1;
+        }
+        num_visited_models += 1.0;
+        ++result.num_visited_orderings;
+    } while (result.num_visited_orderings < max_num_orderings && next_ordering());
+
+    for (const auto &[_, bracket] : gap_range_to_bracket) {
+        result.brackets.push_back(bracket);
+    }
+    result.is_exact = result.num_visited_orderings >= result.num_superband_orderings;
+    result.num_models = result.is_exact ? num_visited_models
+                                        : num_visited_models / result.num_visited_orderings *
+                                              result.num_superband_orderings;
+    return result;
+}
+
+}  // namespace magnon::diagnose2
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <vector>
+
+#include "diagnose2/perturbed_band_structure.pb.h"
+
+namespace magnon::diagnose2 {
+
+// Size of the space `analyze_perturbation()` enumerates. Counts are doubles, as they easily
+// exceed 64 bits; they are exact up to 2^53.
+struct SearchSpaceEstimate {
+    struct KPoint {
+        int k_idx;
+        // Distinct orderings of the supermodes at the k-point, with supermodes of the same bag
+        // tied: the multinomial coefficient of the bag multiplicities.
+        double num_orderings;
+    };
+
+    // Energetics models of the gap brackets spanning the same gaps, over all visited orderings.
+    struct Bracket {
+        int gap_begin;
+        int gap_end;
+        long num_orderings;  // Visited orderings with this bracket
+        double num_models;
+    };
+
+    // Supergroup k-points permuted by the enumeration, fastest-varying first.
+    std::vector<KPoint> k_points;
+    // Product of the per-k-point orderings.
+    double num_superband_orderings = 0.0;
+
+    // Brackets by increasing gaps.
+    std::vector<Bracket> brackets;
+    // Energetics models over all orderings, including the one per ordering that finishes it.
+    double num_models = 0.0;
+
+    // Whether every ordering was visited. Otherwise the models are extrapolated from the visited
+    // ones, the first in enumeration order.
+    bool is_exact = true;
+    long num_visited_orderings = 0;
+};
+
+// Count the superband orderings and energetics models `analyze_perturbation()` would enumerate,
+// without evaluating any of them. Only the first `max_num_orderings` orderings are visited to
+// count their models. Like the searches, use the alternative SI formulas of the subgroup if it has
+// any. Structures without SIs are not searched and have an empty search space.
+SearchSpaceEstimate estimate_search_space(const PerturbedBandStructure &perturbed_structure,
+                                          long max_num_orderings = 1'000'000);
+
+}  // namespace magnon::diagnose2
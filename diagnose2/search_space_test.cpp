@@ -0,0 +1,57 @@
+#include "diagnose2/search_space.hpp"
+
+#include <string>
+#include <vector>
+
+#include "diagnose2/spectrum_data.hpp"
+#include "diagnose2/test_structures.hpp"
+#include "gtest/gtest.h"
+
+namespace magnon::diagnose2 {
+
+TEST(EstimateSearchSpaceTest, MatchesEnumeration) {
+    const auto structure = make_copies(read_structure(), 2);
+    const SpectrumData data(structure);
+    const auto superirreps = positive_energy_irreps(structure);
+    Superband superband(superirreps, data);
+    superband.fix_antiunit_rels();
+
+    long num_orderings = 0;
+    long num_models = 0;
+    do {
+        ++num_orderings;
+        Subband subband = superband.make_subband();
+        do {
+            ++num_models;
+        } while (subband.next_energetics());
+    } while (superband.cartesian_permute());
+
+    const auto estimate = estimate_search_space(structure);
+    EXPECT_TRUE(estimate.is_exact);
+    EXPECT_EQ(estimate.num_visited_orderings, num_orderings);
+    EXPECT_EQ(estimate.num_superband_orderings, num_orderings);
+    EXPECT_EQ(estimate.num_models, num_models);
+
+    double num_bracket_models = 0.0;
+    for (const auto &bracket : estimate.brackets) {
+        EXPECT_LE(bracket.gap_begin, bracket.gap_end);
+        EXPECT_LE(bracket.num_orderings, num_orderings);
+        num_bracket_models += bracket.num_models;
+    }
+    // One more model per ordering finishes it.
+    EXPECT_EQ(num_bracket_models + num_orderings, num_models);
+}
+
+TEST(EstimateSearchSpaceTest, ExtrapolatesFromVisitedOrderings) {
+    const auto structure = make_copies(read_structure(), 2);
+    const auto exact = estimate_search_space(structure);
+    ASSERT_GT(exact.num_superband_orderings, 2);
+
+    const auto estimate = estimate_search_space(structure, 2);
+    EXPECT_FALSE(estimate.is_exact);
+    EXPECT_EQ(estimate.num_visited_orderings, 2);
+    EXPECT_EQ(estimate.num_superband_orderings, exact.num_superband_orderings);
+    EXPECT_GT(estimate.num_models, 0.0);
+}
+
+}  // namespace magnon::diagnose2
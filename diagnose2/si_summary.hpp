@@ -1,35 +1,70 @@
 #pragma once
 
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
 #include <iostream>
-#include <map>
+#include <utility>
+#include <vector>
 
-#include "spectrum_data.hpp"
+#include "packed_si.hpp"
 
 namespace magnon::diagnose2 {
 
+// Histogram of the SIs of the gaps of an energetics model, or bounds on it over several models.
+// The counts are kept densely, indexed by packed SI code, so that merging two summaries is an
+// element-wise operation over a small contiguous array. Summaries that are merged must have been
+// built for the same SI group.
 class SiSummary {
  private:
-    struct MatrixIntCompareLess {
-        bool operator()(const MatrixInt &a, const MatrixInt &b) const {
-            return std::lexicographical_compare(
-                a.data(), a.data() + a.size(), b.data(), b.data() + b.size());
-        }
-    };
-
     int gapless_count, trivialorgapless_count;
-    std::map<MatrixInt, int, MatrixIntCompareLess> si_to_count;
+    // Whether an SI was recorded at all is tracked separately, since a lower bound keeps the SIs
+    // whose count drops to 0.
+    std::vector<int> si_code_to_count;
+    std::vector<std::uint8_t> si_code_to_is_present;
 
     void increment_trivialorgapless() { ++trivialorgapless_count; }
 
  public:
-    SiSummary() : gapless_count{0}, trivialorgapless_count{0} {}
+    explicit SiSummary(const SiGroup &si_group)
+        : gapless_count{0},
+          trivialorgapless_count{0},
+          si_code_to_count(si_group.num_elements(), 0),
+          si_code_to_is_present(si_group.num_elements(), 0) {}
+
+    // Rebuild a summary from the values of the getters below.
+    SiSummary(const int gapless_count,
+              const int trivialorgapless_count,
+              std::vector<int> si_code_to_count,
+              std::vector<std::uint8_t> si_code_to_is_present)
+        : gapless_count{gapless_count},
+          trivialorgapless_count{trivialorgapless_count},
+          si_code_to_count(std::move(si_code_to_count)),
+          si_code_to_is_present(std::move(si_code_to_is_present)) {
+        assert(this->si_code_to_count.size() == this->si_code_to_is_present.size());
+    }
 
+    int get_gapless_count() const { return gapless_count; }
     int get_trivialorgapless_count() const { return trivialorgapless_count; }
+    const std::vector<int> &get_si_code_to_count() const { return si_code_to_count; }
+    const std::vector<std::uint8_t> &get_si_code_to_is_present() const {
+        return si_code_to_is_present;
+    }
+
+    // Reset to an empty summary, keeping the storage.
+    void clear() {
+        gapless_count = 0;
+        trivialorgapless_count = 0;
+        std::fill(si_code_to_count.begin(), si_code_to_count.end(), 0);
+        std::fill(si_code_to_is_present.begin(), si_code_to_is_present.end(), 0);
+    }
 
-    void increment_si(const MatrixInt &si) {
-        ++si_to_count[si];
+    void increment_si(const PackedSi si) {
+        assert(si.code < si_code_to_count.size());
+        ++si_code_to_count[si.code];
+        si_code_to_is_present[si.code] = 1;
 
-        if (si.isZero()) {
+        if (si.is_trivial()) {
             increment_trivialorgapless();
         }
     }
@@ -40,63 +75,68 @@ class SiSummary {
     }
 
     SiSummary &operator+=(const SiSummary &rhs) {
+        assert(si_code_to_count.size() == rhs.si_code_to_count.size());
+
         gapless_count += rhs.gapless_count;
         trivialorgapless_count += rhs.trivialorgapless_count;
-        for (const auto &[si, count] : rhs.si_to_count) {
-            si_to_count[si] += count;
+        for (std::size_t i = 0; i < si_code_to_count.size(); ++i) {
+            si_code_to_count[i] += rhs.si_code_to_count[i];
+            si_code_to_is_present[i] |= rhs.si_code_to_is_present[i];
         }
 
         return *this;
     }
 
-    void print(std::ostream &out) {
+    void print(std::ostream &out, const SiGroup &si_group) {
         out << "-----------------\n";
-        for (const auto &[si, count] : si_to_count) {
-            out << si.transpose() << ":\t" << count << '\n';
+        for (std::size_t i = 0; i < si_code_to_count.size(); ++i) {
+            if (si_code_to_is_present[i]) {
+                out << si_group.to_string({static_cast<PackedSi::Code>(i)}) << ":\t"
+                    << si_code_to_count[i] << '\n';
+            }
         }
         out << "gapless:\t" << gapless_count << '\n';
         out << "trivial or gapless:\t" << trivialorgapless_count << '\n';
         out << "-----------------\n";
     }
 
-    static SiSummary lower_bound(const SiSummary &l, const SiSummary &r) {
-        SiSummary result = l;
-
-        result.gapless_count = std::min(result.gapless_count, r.gapless_count);
-        result.trivialorgapless_count =
-            std::min(result.trivialorgapless_count, r.trivialorgapless_count);
+    // In-place versions of `lower_bound(*this, rhs)` and `upper_bound(*this, rhs)`.
+    SiSummary &merge_lower_bound(const SiSummary &rhs) {
+        assert(si_code_to_count.size() == rhs.si_code_to_count.size());
 
-        for (const auto &[si, count] : l.si_to_count) {
-            if (!r.si_to_count.contains(si)) {
-                result.si_to_count[si] = 0;
-            }
+        gapless_count = std::min(gapless_count, rhs.gapless_count);
+        trivialorgapless_count = std::min(trivialorgapless_count, rhs.trivialorgapless_count);
+        // An SI missing from either side has a count of 0 there.
+        for (std::size_t i = 0; i < si_code_to_count.size(); ++i) {
+            si_code_to_count[i] = std::min(si_code_to_count[i], rhs.si_code_to_count[i]);
+            si_code_to_is_present[i] |= rhs.si_code_to_is_present[i];
         }
 
-        for (const auto &[si, count] : r.si_to_count) {
-            auto &result_count = result.si_to_count[si];
+        return *this;
+    }
 
-            if (!l.si_to_count.contains(si)) {
-                result_count = 0;
-            }
+    SiSummary &merge_upper_bound(const SiSummary &rhs) {
+        assert(si_code_to_count.size() == rhs.si_code_to_count.size());
 
-            result_count = std::min(result_count, count);
+        gapless_count = std::max(gapless_count, rhs.gapless_count);
+        trivialorgapless_count = std::max(trivialorgapless_count, rhs.trivialorgapless_count);
+        for (std::size_t i = 0; i < si_code_to_count.size(); ++i) {
+            si_code_to_count[i] = std::max(si_code_to_count[i], rhs.si_code_to_count[i]);
+            si_code_to_is_present[i] |= rhs.si_code_to_is_present[i];
         }
 
+        return *this;
+    }
+
+    static SiSummary lower_bound(const SiSummary &l, const SiSummary &r) {
+        SiSummary result = l;
+        result.merge_lower_bound(r);
         return result;
     }
 
     static SiSummary upper_bound(const SiSummary &l, const SiSummary &r) {
         SiSummary result = l;
-
-        result.gapless_count = std::max(result.gapless_count, r.gapless_count);
-        result.trivialorgapless_count =
-            std::max(result.trivialorgapless_count, r.trivialorgapless_count);
-
-        for (const auto &[si, count] : r.si_to_count) {
-            auto &result_count = result.si_to_count[si];
-            result_count = std::max(result_count, count);
-        }
-
+        result.merge_upper_bound(r);
         return result;
     }
 };
@@ -0,0 +1,58 @@
+#include "diagnose2/si_summary.hpp"
+
+#include <sstream>
+#include <string>
+
+#include "gtest/gtest.h"
+
+namespace magnon::diagnose2 {
+
+std::string to_string(SiSummary summary, const SiGroup &group) {
+    std::ostringstream out;
+    summary.print(out, group);
+    return out.str();
+}
+
+TEST(SiSummaryTest, BoundsAreElementWise) {
+    const SiGroup group({2, 4});
+    const PackedSi trivial{0}, si1{1}, si5{5};
+
+    SiSummary lhs(group);
+    lhs.increment_si(si1);
+    lhs.increment_si(si1);
+    lhs.increment_si(trivial);
+    lhs.increment_gapless();
+
+    SiSummary rhs(group);
+    rhs.increment_si(si1);
+    rhs.increment_si(si5);
+
+    // An SI seen on one side only stays in the lower bound, with a count of 0.
+    EXPECT_EQ(to_string(SiSummary::lower_bound(lhs, rhs), group),
+              "-----------------\n"
+              "00:\t0\n"
+              "01:\t1\n"
+              "11:\t0\n"
+              "gapless:\t0\n"
+              "trivial or gapless:\t0\n"
+              "-----------------\n");
+    EXPECT_EQ(to_string(SiSummary::upper_bound(lhs, rhs), group),
+              "-----------------\n"
+              "00:\t1\n"
+              "01:\t2\n"
+              "11:\t1\n"
+              "gapless:\t1\n"
+              "trivial or gapless:\t2\n"
+              "-----------------\n");
+
+    lhs += rhs;
+    EXPECT_EQ(lhs.get_trivialorgapless_count(), 2);
+    lhs.clear();
+    EXPECT_EQ(to_string(lhs, group),
+              "-----------------\n"
+              "gapless:\t0\n"
+              "trivial or gapless:\t0\n"
+              "-----------------\n");
+}
+
+}  // namespace magnon::diagnose2
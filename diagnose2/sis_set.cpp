@@ -0,0 +1,52 @@
+#include "diagnose2/sis_set.hpp"
+
+#include <algorithm>
+#include <cassert>
+
+namespace magnon::diagnose2 {
+
+SisSet::Hash SisSet::hash(const std::span<const PackedSi> sis) {
+    Hash result = EMPTY_HASH;
+    for (const auto si : sis) {
+        result = extend_hash(result, si);
+    }
+    return result;
+}
+
+bool SisSet::insert(const std::span<const PackedSi> sis, const Hash hash) {
+    assert(static_cast<int>(sis.size()) == width_);
+
+    // Keep the load factor at most 1/2.
+    if (2 * (hashes.size() + 1) > slots.size()) {
+        grow();
+    }
+
+    const auto mask = slots.size() - 1;
+    for (auto slot = hash & mask;; slot = (slot + 1) & mask) {
+        const auto idx = slots[slot];
+        if (idx == EMPTY_SLOT) {
+            slots[slot] = static_cast<std::int32_t>(hashes.size());
+            hashes.push_back(hash);
+            arena.insert(arena.end(), sis.begin(), sis.end());
+            return true;
+        }
+        if (hashes[idx] == hash && std::ranges::equal((*this)[idx], sis)) {
+            return false;
+        }
+    }
+}
+
+void SisSet::grow() {
+    slots.assign(std::max<std::size_t>(16, 2 * slots.size()), EMPTY_SLOT);
+
+    const auto mask = slots.size() - 1;
+    for (int idx = 0; idx < size(); ++idx) {
+        auto slot = hashes[idx] & mask;
+        while (slots[slot] != EMPTY_SLOT) {
+            slot = (slot + 1) & mask;
+        }
+        slots[slot] = idx;
+    }
+}
+
+}  // namespace magnon::diagnose2
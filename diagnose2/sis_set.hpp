@@ -0,0 +1,71 @@
+#pragma once
+
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include "diagnose2/packed_si.hpp"
+
+namespace magnon::diagnose2 {
+
+// Set of the SI sequences of one gap bracket, all of the same length.
+//
+// The sequences are stored back to back in a single arena, indexed by an open-addressing hash
+// table, so that inserting one (usually a duplicate) allocates nothing. The hash is built by the
+// caller with `extend_hash()` while it scans the bracket.
+class SisSet {
+ public:
+    using Hash = std::uint64_t;
+    static constexpr Hash EMPTY_HASH = 0;
+
+    explicit SisSet(int width) : width_{width} {}
+
+    static Hash extend_hash(Hash hash, const PackedSi si) {
+        hash = (hash ^ si.code) * 0x9e3779b97f4a7c15;
+        return hash ^ (hash >> 29);
+    }
+    static Hash hash(std::span<const PackedSi> sis);
+
+    // Insert `sis`, whose hash is `hash`, and return whether it was new.
+    bool insert(std::span<const PackedSi> sis, Hash hash);
+    bool insert(std::span<const PackedSi> sis) { return insert(sis, hash(sis)); }
+
+    int width() const { return width_; }
+    int size() const { return static_cast<int>(hashes.size()); }
+    bool empty() const { return hashes.empty(); }
+
+    // The sequences, in insertion order.
+    std::span<const PackedSi> operator[](const int idx) const {
+        return {arena.data() + static_cast<std::size_t>(idx) * width_,
+                static_cast<std::size_t>(width_)};
+    }
+
+    class Iterator {
+     public:
+        Iterator(const SisSet &set, const int idx) : set{&set}, idx{idx} {}
+        std::span<const PackedSi> operator*() const { return (*set)[idx]; }
+        Iterator &operator++() {
+            ++idx;
+            return *this;
+        }
+        bool operator==(const Iterator &rhs) const { return idx == rhs.idx; }
+
+     private:
+        const SisSet *set;
+        int idx;
+    };
+    Iterator begin() const { return {*this, 0}; }
+    Iterator end() const { return {*this, size()}; }
+
+ private:
+    static constexpr std::int32_t EMPTY_SLOT = -1;
+
+    void grow();
+
+    int width_;
+    std::vector<PackedSi> arena;
+    std::vector<Hash> hashes;  // Hash of each sequence, by insertion order
+    std::vector<std::int32_t> slots;  // Index of the sequence in each slot, or `EMPTY_SLOT`
+};
+
+}  // namespace magnon::diagnose2
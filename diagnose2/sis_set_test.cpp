@@ -0,0 +1,44 @@
+#include "diagnose2/sis_set.hpp"
+
+#include <set>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+namespace magnon::diagnose2 {
+
+TEST(SisSetTest, KeepsDistinctSequences) {
+    constexpr int WIDTH = 3;
+    SisSet set(WIDTH);
+    std::set<std::vector<PackedSi>> expected;
+
+    // Enough sequences to make the table grow a few times, each inserted twice.
+    for (int round = 0; round < 2; ++round) {
+        for (PackedSi::Code i = 0; i < 200; ++i) {
+            const std::vector<PackedSi> sis{{i % 7}, PackedSi::gapless(), {i % 11}};
+            EXPECT_EQ(set.insert(sis), expected.insert(sis).second);
+        }
+    }
+
+    EXPECT_EQ(set.size(), static_cast<int>(expected.size()));
+    std::set<std::vector<PackedSi>> actual;
+    for (const auto sis : set) {
+        actual.emplace(sis.begin(), sis.end());
+    }
+    EXPECT_EQ(actual, expected);
+}
+
+TEST(SisSetTest, HashesIncrementally) {
+    const std::vector<PackedSi> sis{{3}, {0}, PackedSi::trivial_or_gapless()};
+    SisSet::Hash hash = SisSet::EMPTY_HASH;
+    for (const auto si : sis) {
+        hash = SisSet::extend_hash(hash, si);
+    }
+    EXPECT_EQ(hash, SisSet::hash(sis));
+
+    SisSet set(static_cast<int>(sis.size()));
+    EXPECT_TRUE(set.insert(sis, hash));
+    EXPECT_FALSE(set.insert(sis));
+}
+
+}  // namespace magnon::diagnose2
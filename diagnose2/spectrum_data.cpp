@@ -3,6 +3,7 @@
 #include <algorithm>
 #include <cassert>
 #include <iostream>
+#include <iterator>
 #include <numeric>
 #include <regex>
 #include <set>
@@ -235,8 +236,12 @@ SpectrumData::SpectrumData(const PerturbedBandStructure &spectrum) {
         for (const auto &[k1idx_k2idx, irrep1idx_to_irrep2idx] :
              k1idx_k2idx_to_irrep1idx_to_irrep2idx) {
             const auto &[k1idx, k2idx] = k1idx_k2idx;
+            std::vector<std::int16_t> irrep1idx_to_irrep2idx_table(result.irreps.size(), -1);
+            for (const auto &[irrep1_idx, irrep2_idx] : irrep1idx_to_irrep2idx) {
+                irrep1idx_to_irrep2idx_table[irrep1_idx] = irrep2_idx;
+            }
             result.k1idx_k2idx_irrep1idxtoirrep2idx_tuples.emplace_back(
-                std::tuple{k1idx, k2idx, irrep1idx_to_irrep2idx});
+                std::tuple{k1idx, k2idx, std::move(irrep1idx_to_irrep2idx_table)});
         }
 
         for (auto i = 0U; i < result.irreps.size(); ++i) {
@@ -317,6 +322,19 @@ SpectrumData::SpectrumData(const PerturbedBandStructure &spectrum) {
     std::sort(unique_bags.begin(), unique_bags.end());
     unique_bags.erase(std::unique(unique_bags.begin(), unique_bags.end()), unique_bags.end());
 
+    for (const auto &superirrep : super_msg.irreps) {
+        superirrep_idx_to_bag_idx.push_back(superirrep_to_all_subirreps.contains(superirrep)
+                                                ? bag_to_idx(Bag(superirrep, *this))
+                                                : static_cast<int>(Bag::invalid_idx));
+    }
+
+    sub_si_group = SiGroup(sub_msg.si_orders);
+    for (int irrep_idx = 0; irrep_idx < static_cast<int>(sub_msg.irreps.size()); ++irrep_idx) {
+        sub_irrepidx_to_packed_si.push_back(
+            sub_msg.si_matrix.size() == 0 ? PackedSi{0}
+                                          : sub_si_group.pack(sub_msg.si_matrix.col(irrep_idx)));
+    }
+
     const auto to_fraction = [](const double x) -> std::string {
         constexpr int MAX_DENOM = 10;
         int num = static_cast<int>(std::round(x));
@@ -364,16 +382,8 @@ Bag::Bag(const std::string &superirrep, const SpectrumData &data) {
     std::sort(subk_idx_and_subirrep_idx_pairs.begin(), subk_idx_and_subirrep_idx_pairs.end());
 }
 
-Supermode::Supermode(const std::string &superirrep, const SpectrumData &data) {
-    superirrep_idx = data.super_msg.irrep_to_idx(superirrep);
-
-    if (data.superirrep_to_all_subirreps.contains(superirrep)) {
-        bag_idx = data.bag_to_idx(Bag(superirrep, data));
-    } else {
-        bag_idx = Bag::invalid_idx;
-        static_assert(Bag::invalid_idx == -1);
-    }
-}
+Supermode::Supermode(const std::string &superirrep, const SpectrumData &data)
+    : Supermode(data.super_msg.irrep_to_idx(superirrep), data) {}
 
 const Bag &Supermode::get_bag(const SpectrumData &data) const { return data.unique_bags[bag_idx]; }
 
@@ -391,96 +401,385 @@ Superband::Superband(const std::vector<std::string> &superirreps, const Spectrum
                   k_idx_to_e_idx_to_supermode[k_idx].end());
     }
 
-    fix_antiunit_rels();
+    std::set<int> kidxs_to_skip;
+    for (const auto &[_, kidx2, __] : data.super_msg.k1idx_k2idx_irrep1idxtoirrep2idx_tuples) {
+        kidxs_to_skip.insert(kidx2);
+    }
+    for (int kidx = 0; kidx < static_cast<int>(k_idx_to_e_idx_to_supermode.size()); ++kidx) {
+        if (!kidxs_to_skip.contains(kidx)) {
+            kidxs_to_permute.push_back(kidx);
+        }
+    }
+
+    set_ordering_strategy(OrderingStrategy::Lexicographic);
+}
+
+namespace {
+
+// Whether the number of distinct orderings of `supermodes`, n! / (n_1! n_2! ...), is odd. By
+// Kummer's theorem, it is unless adding up the multiplicities in binary carries.
+bool has_odd_num_orderings(const std::vector<Supermode> &supermodes) {
+    std::map<int, int> bag_idx_to_multiplicity;
+    for (const auto &supermode : supermodes) {
+        ++bag_idx_to_multiplicity[supermode.bag_idx];
+    }
+    int sum = 0;
+    for (const auto &[_, multiplicity] : bag_idx_to_multiplicity) {
+        if ((sum & multiplicity) != 0) {
+            return false;
+        }
+        sum |= multiplicity;
+    }
+    return true;
+}
+
+}  // namespace
+
+void Superband::set_energetics_order(const EnergeticsOrder order) {
+    energetics_order = order;
+    reset_k_point_walks();
+}
+
+std::vector<Superband> Superband::split(const int min_num_chunks) const {
+    for (const auto kidx : kidxs_to_permute) {
+        assert(is_at_first_ordering(kidx));
+    }
+
+    // Above this many chunks, the bookkeeping outweighs the gain in load balancing.
+    constexpr long MAX_NUM_CHUNKS = 1 << 16;
+
+    const auto num_orderings = [this](const int kidx) {
+        // Number of distinct orderings of a multiset: n! / (n_1! n_2! ...)
+        auto supermodes = k_idx_to_e_idx_to_supermode[kidx];
+        std::sort(supermodes.begin(), supermodes.end());
+        long result = 1;
+        int num_placed = 0;
+        for (auto it = supermodes.begin(); it != supermodes.end();) {
+            const auto next = std::upper_bound(it, supermodes.end(), *it);
+            for (int multiplicity = 1; it != next; ++it, ++multiplicity) {
+                result = result * (++num_placed) / multiplicity;
+                if (result > MAX_NUM_CHUNKS) {
+                    return MAX_NUM_CHUNKS + 1;
+                }
+            }
+        }
+        return result;
+    };
+
+    int num_fixed = 0;
+    long num_chunks = 1;
+    while (num_fixed < static_cast<int>(kidxs_to_permute.size()) && num_chunks < min_num_chunks) {
+        const long new_num_chunks =
+            num_chunks * num_orderings(kidxs_to_permute.rbegin()[num_fixed]);
+        if (new_num_chunks > MAX_NUM_CHUNKS) {
+            break;
+        }
+        num_chunks = new_num_chunks;
+        ++num_fixed;
+    }
+
+    const auto first_fixed = std::prev(kidxs_to_permute.end(), num_fixed);
+
+    Superband prefixes = *this;
+    prefixes.kidxs_to_permute.assign(first_fixed, kidxs_to_permute.end());
+
+    // With `EnergeticsOrder::Transpositions`, each chunk starts where the previous one left the
+    // permuted k-points, some of them at the end of their walks, to walk them back.
+    Superband walked_to_end = *this;
+    if (energetics_order == EnergeticsOrder::Transpositions) {
+        for (auto it = kidxs_to_permute.begin(); it != first_fixed; ++it) {
+            walked_to_end.move_to_end_of_sweep(*it);
+        }
+    }
+
+    std::vector<Superband> result;
+    long chunk_idx = 0;
+    do {
+        auto &chunk = result.emplace_back(prefixes);
+        chunk.kidxs_to_permute.assign(kidxs_to_permute.begin(), first_fixed);
+
+        if (energetics_order == EnergeticsOrder::Transpositions) {
+            // A k-point walks back if the slower ones moved an odd number of times before: the
+            // chunk index times the number of orderings of the slower permuted k-points.
+            bool is_reversed = chunk_idx % 2 == 1;
+            for (auto it = std::make_reverse_iterator(first_fixed); it != kidxs_to_permute.rend();
+                 ++it) {
+                if (is_reversed) {
+                    chunk.k_idx_to_e_idx_to_supermode[*it] =
+                        walked_to_end.k_idx_to_e_idx_to_supermode[*it];
+                    chunk.k_idx_to_walk[*it] = walked_to_end.k_idx_to_walk[*it];
+                }
+                is_reversed =
+                    is_reversed && has_odd_num_orderings(k_idx_to_e_idx_to_supermode[*it]);
+            }
+            chunk.fix_antiunit_rels();
+        }
+        ++chunk_idx;
+    } while (prefixes.cartesian_permute());
+    assert(static_cast<long>(result.size()) == num_chunks);
+
+    return result;
+}
+
+void Superband::fix_slowest_k_points(const int num_permuted) {
+    assert(num_permuted >= 0);
+    assert(num_permuted <= num_permuted_k_points());
+    kidxs_to_permute.resize(num_permuted);
 }
 
 Subband Superband::make_subband() const {
     Subband subband(data);
-    subband.subk_idx_to_e_idx_to_submode.resize(data.sub_msg.ks.size());
+    subband.rebuild(*this);
+    return subband;
+}
+
+void Subband::rebuild(const Superband &superband) {
+    const int num_superks = superband.k_idx_to_e_idx_to_supermode.size();
+    const int num_subks = data.sub_msg.ks.size();
+
+    superk_idx_to_subk_idx_to_segment.assign(num_superks, Vector<Segment>(num_subks));
+    superk_idx_to_e_idx_to_bag_idx.resize(num_superks);
+
+    // Lay out the segments first, so that every k-point can then be written in place.
+    Vector<int> subk_idx_to_num_submodes(num_subks, 0);
+    Vector<int> subk_idx_to_num_bands(num_subks, 0);
+    for (int superk_idx = 0; superk_idx < num_superks; ++superk_idx) {
+        auto &segments = superk_idx_to_subk_idx_to_segment[superk_idx];
+        for (int subk_idx = 0; subk_idx < num_subks; ++subk_idx) {
+            segments[subk_idx].e_idx_begin = subk_idx_to_num_submodes[subk_idx];
+            segments[subk_idx].numbandsbelow = subk_idx_to_num_bands[subk_idx];
+        }
+
+        for (const auto &supermode : superband.k_idx_to_e_idx_to_supermode[superk_idx]) {
+            if (supermode.bag_idx == Bag::invalid_idx) {
+                break;
+            }
+            for (const auto &[subk_idx, subirrep_idx] :
+                 data.unique_bags[supermode.bag_idx].subk_idx_and_subirrep_idx_pairs) {
+                ++subk_idx_to_num_submodes[subk_idx];
+                subk_idx_to_num_bands[subk_idx] += data.sub_msg.dims[subirrep_idx];
+            }
+        }
+
+        for (int subk_idx = 0; subk_idx < num_subks; ++subk_idx) {
+            segments[subk_idx].e_idx_end = subk_idx_to_num_submodes[subk_idx];
+        }
+    }
 
-    for (auto &e_idx_to_submode : subband.subk_idx_to_e_idx_to_submode) {
-        e_idx_to_submode.clear();
+    subk_idx_to_e_idx_to_submode.resize(num_subks);
+    for (int subk_idx = 0; subk_idx < num_subks; ++subk_idx) {
+        subk_idx_to_e_idx_to_submode[subk_idx].assign(subk_idx_to_num_submodes[subk_idx],
+                                                      Submode(0));
     }
 
-    Vector<Vector<int>> subk_idx_to_span_idx_to_span_size(data.sub_msg.ks.size());
-    Vector<Vector<int>> subk_idx_to_span_idx_to_span_dim(data.sub_msg.ks.size());
+    for (int superk_idx = 0; superk_idx < num_superks; ++superk_idx) {
+        write_segments(
+            superband, superk_idx, 0, superband.k_idx_to_e_idx_to_supermode[superk_idx].size());
+    }
+
+    update_brackets();
+    fix_antiunit_rels();
+}
+
+bool Subband::write_segments(const Superband &superband,
+                             const int superk_idx,
+                             const int first,
+                             const int last) {
+    const auto &supermodes = superband.k_idx_to_e_idx_to_supermode[superk_idx];
+    auto &segments = superk_idx_to_subk_idx_to_segment[superk_idx];
+    const bool is_to_end = last == static_cast<int>(supermodes.size());
+
+    // Overwrite the entries of the segments in place, or append them to new ones.
+    bool spans_changed = false;
+    const auto write = [&spans_changed](auto &values, const int idx, const auto &value) {
+        if (idx == static_cast<int>(values.size())) {
+            values.push_back(value);
+            spans_changed = true;
+        } else if (values[idx] != value) {
+            values[idx] = value;
+            spans_changed = true;
+        }
+    };
 
-    for (const auto &e_idx_to_supermode : this->k_idx_to_e_idx_to_supermode) {
-        for (const auto &supermode : e_idx_to_supermode) {
-            const auto bag_idx = supermode.bag_idx;
-            if (bag_idx == Bag::invalid_idx) {
+    Vector<bool> is_attainable;
+    for (int subk_idx = 0; subk_idx < static_cast<int>(segments.size()); ++subk_idx) {
+        auto &segment = segments[subk_idx];
+        auto &submodes = subk_idx_to_e_idx_to_submode[subk_idx];
+        auto &offsets_list = segment.supermode_idx_to_offsets;
+
+        auto offsets = first == 0 ? Segment::Offsets{.e_idx = segment.e_idx_begin,
+                                                     .numbandsbelow = segment.numbandsbelow,
+                                                     .span_idx = 0,
+                                                     .possible_gap_idx = 0}
+                                  : offsets_list[first];
+        int supermode_idx = first;
+        for (; supermode_idx < last; ++supermode_idx) {
+            const auto &supermode = supermodes[supermode_idx];
+            if (supermode.bag_idx == Bag::invalid_idx) {
                 break;
             }
-            const auto &bag = data.unique_bags[bag_idx];
+            offsets_list.resize(std::max<int>(offsets_list.size(), supermode_idx + 1));
+            offsets_list[supermode_idx] = offsets;
+
+            const auto [first_pair, last_pair] = std::ranges::equal_range(
+                data.unique_bags[supermode.bag_idx].subk_idx_and_subirrep_idx_pairs,
+                subk_idx,
+                {},
+                &std::pair<int, int>::first);
+            if (first_pair == last_pair) {
+                continue;
+            }
 
-            for (auto &span_sizes : subk_idx_to_span_idx_to_span_size) {
-                span_sizes.push_back(0);
+            const auto span =
+                Span{submodes.data() + offsets.e_idx, static_cast<size_t>(last_pair - first_pair)};
+            int span_dim = 0;
+            for (auto it = first_pair; it != last_pair; ++it) {
+                submodes[offsets.e_idx++] = Submode(it->second);
+                span_dim += data.sub_msg.dims[it->second];
+            }
+            const auto spanistrivial = (span.size() <= 1) || all_equal(span);
+            write(segment.span_size_dim_istrivial_tuples,
+                  offsets.span_idx++,
+                  std::tuple<int, int, bool>{static_cast<int>(span.size()), span_dim, spanistrivial});
+
+            // The gaps within the span are the sums of the submode dims below them, so every sum
+            // of a nonempty subset of the dims is attainable by some permutation.
+            is_attainable.assign(span_dim + 1, false);
+            is_attainable[0] = true;
+            for (const auto &submode : span) {
+                const auto dim = data.sub_msg.dims[submode.subirrep_idx];
+                for (int sum = span_dim; sum >= dim; --sum) {
+                    is_attainable[sum] = is_attainable[sum] || is_attainable[sum - dim];
+                }
             }
-            for (auto &span_dims : subk_idx_to_span_idx_to_span_dim) {
-                span_dims.push_back(0);
+            for (int sum = 1; sum <= span_dim; ++sum) {
+                if (is_attainable[sum]) {
+                    write(segment.possible_gaps,
+                          offsets.possible_gap_idx++,
+                          offsets.numbandsbelow + sum);
+                }
             }
 
-            for (const auto &[subk_idx, subirrep_idx] : bag.subk_idx_and_subirrep_idx_pairs) {
-                subband.subk_idx_to_e_idx_to_submode[subk_idx].emplace_back(subirrep_idx);
+            offsets.numbandsbelow += span_dim;
+        }
 
-                subk_idx_to_span_idx_to_span_size[subk_idx].back() += 1;
-                subk_idx_to_span_idx_to_span_dim[subk_idx].back() +=
-                    data.sub_msg.dims[subirrep_idx];
+        if (is_to_end || supermode_idx < last) {
+            offsets_list.resize(supermode_idx + 1);
+            offsets_list.back() = offsets;
+            assert(offsets.e_idx == segment.e_idx_end);
+            // Drop what is left of a longer layout.
+            if (static_cast<int>(segment.span_size_dim_istrivial_tuples.size()) >
+                    offsets.span_idx ||
+                static_cast<int>(segment.possible_gaps.size()) > offsets.possible_gap_idx) {
+                segment.span_size_dim_istrivial_tuples.resize(offsets.span_idx);
+                segment.possible_gaps.resize(offsets.possible_gap_idx);
+                spans_changed = true;
             }
+        } else {
+            const auto &end_offsets = offsets_list[last];
+            assert(offsets.e_idx == end_offsets.e_idx);
+            assert(offsets.numbandsbelow == end_offsets.numbandsbelow);
+            assert(offsets.span_idx == end_offsets.span_idx);
+            assert(offsets.possible_gap_idx == end_offsets.possible_gap_idx);
+        }
+    }
 
-            for (int subk_idx = 0; subk_idx < static_cast<int>(data.sub_msg.ks.size());
-                 ++subk_idx) {
-                auto &span_sizes = subk_idx_to_span_idx_to_span_size[subk_idx];
-                auto &span_dims = subk_idx_to_span_idx_to_span_dim[subk_idx];
-                if (span_sizes.back() == 0) {
-                    assert(span_dims.back() == 0);
+    auto &bag_idxs = superk_idx_to_e_idx_to_bag_idx[superk_idx];
+    bag_idxs.resize(supermodes.size());
+    for (int supermode_idx = first; supermode_idx < last; ++supermode_idx) {
+        bag_idxs[supermode_idx] = supermodes[supermode_idx].bag_idx;
+    }
 
-                    span_sizes.pop_back();
-                    span_dims.pop_back();
-                }
+    return spans_changed;
+}
+
+std::optional<bool> Subband::write_transposed_segments(const Superband &superband,
+                                                       const int changed_k_idx) {
+    const auto [first, last] = superband.last_changed_e_idxs();
+    Vector<int> superk_idxs{changed_k_idx};
+    for (const auto &[k1idx, k2idx, _] : data.super_msg.k1idx_k2idx_irrep1idxtoirrep2idx_tuples) {
+        if (k1idx == changed_k_idx) {
+            superk_idxs.push_back(k2idx);
+        }
+    }
+
+    bool spans_changed = false;
+    for (const auto superk_idx : superk_idxs) {
+        const auto &supermodes = superband.k_idx_to_e_idx_to_supermode[superk_idx];
+        auto &segments = superk_idx_to_subk_idx_to_segment[superk_idx];
+        // An invalid bag cuts the supermodes at its k-point short, and the offsets with it.
+        if (segments[0].supermode_idx_to_offsets.size() != supermodes.size() + 1) {
+            return std::nullopt;
+        }
+        spans_changed = write_segments(superband, superk_idx, first, last) || spans_changed;
+
+        for (int subk_idx = 0; subk_idx < static_cast<int>(segments.size()); ++subk_idx) {
+            const auto &offsets_list = segments[subk_idx].supermode_idx_to_offsets;
+            const int e_idx_begin = offsets_list[first].e_idx;
+            const int e_idx_end = offsets_list[last].e_idx;
+            if (e_idx_begin < e_idx_end) {
+                fix_antiunit_rels(Span{subk_idx_to_e_idx_to_submode[subk_idx].data() + e_idx_begin,
+                                       static_cast<size_t>(e_idx_end - e_idx_begin)});
             }
         }
     }
+    return spans_changed;
+}
 
+void Subband::update_brackets() {
     std::map<int, Spans> gap_to_localspans;
     std::map<int, Spans> gap_to_globalspans;
+    Vector<int> possible_gaps;
 
     for (int subk_idx = 0; subk_idx < static_cast<int>(data.sub_msg.ks.size()); ++subk_idx) {
-        const auto &span_sizes = subk_idx_to_span_idx_to_span_size[subk_idx];
-        const auto &span_dims = subk_idx_to_span_idx_to_span_dim[subk_idx];
-
-        assert(span_sizes.size() == span_dims.size());
-
-        auto submode_begin = subband.subk_idx_to_e_idx_to_submode[subk_idx].begin();
-        int prev_gap_end = 0;
-        for (int span_idx = 0; span_idx < static_cast<int>(span_sizes.size()); ++span_idx) {
-            const auto span_size = span_sizes[span_idx];
-            const auto span_dim = span_dims[span_idx];
-
-            const auto submode_end = std::next(submode_begin, span_size);
-            const int gap_end = prev_gap_end + span_dim;
-
-            const auto span = Span{submode_begin, submode_end};
-            const auto spanistrivial = (span_size <= 1) || all_equal(span);
-
-            if (spanistrivial == false) {
-                assert(span_dim >= 2);
-                assert(span_size >= 2);
-
-                if (span_dim == 2) {
-                    const int gap = prev_gap_end + 1;
-                    gap_to_localspans[gap].push_back(span);
-                } else {
-                    for (int gap = prev_gap_end + 1; gap < gap_end; ++gap) {
-                        gap_to_globalspans[gap].push_back(span);
+        auto &submodes = subk_idx_to_e_idx_to_submode[subk_idx];
+
+        Vector<int> subk_possible_gaps;
+        for (const auto &subk_idx_to_segment : superk_idx_to_subk_idx_to_segment) {
+            const auto &segment = subk_idx_to_segment[subk_idx];
+
+            int e_idx = segment.e_idx_begin;
+            int prev_gap_end = segment.numbandsbelow;
+            for (const auto &[span_size, span_dim, spanistrivial] :
+                 segment.span_size_dim_istrivial_tuples) {
+                const auto span = Span{submodes.data() + e_idx, static_cast<size_t>(span_size)};
+                const int gap_end = prev_gap_end + span_dim;
+
+                if (spanistrivial == false) {
+                    assert(span_dim >= 2);
+                    assert(span_size >= 2);
+
+                    if (span_dim == 2) {
+                        const int gap = prev_gap_end + 1;
+                        gap_to_localspans[gap].push_back(span);
+                    } else {
+                        for (int gap = prev_gap_end + 1; gap < gap_end; ++gap) {
+                            gap_to_globalspans[gap].push_back(span);
+                        }
                     }
                 }
+
+                e_idx += span_size;
+                prev_gap_end = gap_end;
             }
 
-            submode_begin = submode_end;
-            prev_gap_end = gap_end;
+            // Segments, and the spans within them, follow each other, so this stays sorted.
+            subk_possible_gaps.insert(subk_possible_gaps.end(),
+                                      segment.possible_gaps.begin(),
+                                      segment.possible_gaps.end());
+        }
+
+        if (subk_idx == 0) {
+            possible_gaps = std::move(subk_possible_gaps);
+        } else {
+            Vector<int> tmp;
+            std::set_intersection(possible_gaps.begin(),
+                                  possible_gaps.end(),
+                                  subk_possible_gaps.begin(),
+                                  subk_possible_gaps.end(),
+                                  std::back_inserter(tmp));
+            possible_gaps = std::move(tmp);
         }
-        // std::cout << "subk_idx: " << subk_idx << " last_gap_end: " << prev_gap_end << '\n';
     }
 
     auto remove_antidepend_spans = [this](auto &spans) {
@@ -506,56 +805,22 @@ Subband Superband::make_subband() const {
         remove_antidepend_spans(spans);
     }
 
-    Vector<std::set<int>> subk_idx_to_possible_gaps(data.sub_msg.ks.size());
-    for (int subk_idx = 0; subk_idx < static_cast<int>(data.sub_msg.ks.size()); ++subk_idx) {
-        const auto &span_sizes = subk_idx_to_span_idx_to_span_size[subk_idx];
-        const auto &span_dims = subk_idx_to_span_idx_to_span_dim[subk_idx];
-
-        auto submode_begin = subband.subk_idx_to_e_idx_to_submode[subk_idx].begin();
-        int prev_gap_end = 0;
-        for (int span_idx = 0; span_idx < static_cast<int>(span_sizes.size()); ++span_idx) {
-            const auto span_size = span_sizes[span_idx];
-            const auto span_dim = span_dims[span_idx];
-
-            const auto submode_end = std::next(submode_begin, span_size);
-            const int gap_end = prev_gap_end + span_dim;
-
-            const auto span = Span{submode_begin, submode_end};
-            Vector<int> span_subdims;
-            for (const auto &submode : span) {
-                span_subdims.push_back(data.sub_msg.dims[submode.subirrep_idx]);
-            }
-            std::sort(span_subdims.begin(), span_subdims.end());
-            do {
-                int gap = 0;
-                for (const auto &delta_gap : span_subdims) {
-                    gap += delta_gap;
-                    subk_idx_to_possible_gaps[subk_idx].insert(prev_gap_end + gap);
-                }
-            } while (std::next_permutation(span_subdims.begin(), span_subdims.end()));
-
-            submode_begin = submode_end;
-            prev_gap_end = gap_end;
-        }
-    }
-
-    Vector<int> possible_gaps = intersect(subk_idx_to_possible_gaps);
     assert(!possible_gaps.empty());
 
-    subband.num_bands = std::accumulate(subband.subk_idx_to_e_idx_to_submode[0].begin(),
-                                        subband.subk_idx_to_e_idx_to_submode[0].end(),
-                                        0,
-                                        [this](const int lhs, const auto &submode) {
-                                            return lhs + data.sub_msg.dims[submode.subirrep_idx];
-                                        });
-    assert(subband.num_bands == possible_gaps.back());
+    num_bands = std::accumulate(subk_idx_to_e_idx_to_submode[0].begin(),
+                                subk_idx_to_e_idx_to_submode[0].end(),
+                                0,
+                                [this](const int lhs, const auto &submode) {
+                                    return lhs + data.sub_msg.dims[submode.subirrep_idx];
+                                });
+    assert(num_bands == possible_gaps.back());
 
     Vector<std::tuple<Vector<int>, Vector<Span>>> gaps_sharedspans_pairs;
 
     {
         Vector<int> gaps;
         Vector<Span> sharedspans;
-        for (int gap = 1; gap <= subband.num_bands; ++gap) {
+        for (int gap = 1; gap <= num_bands; ++gap) {
             if (!gap_to_globalspans.contains(gap)) {
                 if (!gaps.empty()) {
                     gaps_sharedspans_pairs.emplace_back(gaps, sharedspans);
@@ -590,6 +855,7 @@ Subband Superband::make_subband() const {
         }
     }
 
+    gaps_allspanstopermute_done_tuples.clear();
     for (const auto &[gaps, sharedspans] : gaps_sharedspans_pairs) {
         Vector<Span> allspanstopermute{sharedspans};
         for (const auto &gap : gaps) {
@@ -599,40 +865,327 @@ Subband Superband::make_subband() const {
                     allspanstopermute.end(), localspans.begin(), localspans.end());
             }
         }
-        subband.gaps_allspanstopermute_done_tuples.emplace_back(gaps, allspanstopermute, false);
+        gaps_allspanstopermute_done_tuples.emplace_back(gaps, allspanstopermute, false);
         assert(is_cartesian_sorted(allspanstopermute));
     }
 
     Vector<int> test1;
-    for (const auto &[gaps, _, __] : subband.gaps_allspanstopermute_done_tuples) {
+    for (const auto &[gaps, _, __] : gaps_allspanstopermute_done_tuples) {
         test1.insert(test1.end(), gaps.begin(), gaps.end());
     }
     assert(test1 == possible_gaps);
-    subband.all_possible_gaps = possible_gaps;
+    all_possible_gaps = possible_gaps;
 
-    subband.fix_antiunit_rels();
+    reset_span_walks();
+}
 
-    return subband;
+bool Subband::rebase(const Superband &superband, const int changed_k_idx) {
+    // Put the spans of an unfinished energetics enumeration back in their initial, sorted order.
+    for (auto &[_, allspanstopermute, done] : gaps_allspanstopermute_done_tuples) {
+        if (!done) {
+            for (auto &span : allspanstopermute) {
+                std::sort(span.begin(), span.end());
+            }
+        }
+        done = false;
+    }
+
+    bool spans_changed = false;
+    const auto rewrite_if_changed = [&](const int superk_idx) {
+        const auto &supermodes = superband.k_idx_to_e_idx_to_supermode[superk_idx];
+        const auto &bag_idxs = superk_idx_to_e_idx_to_bag_idx[superk_idx];
+        if (std::ranges::equal(supermodes, bag_idxs, {}, &Supermode::bag_idx)) {
+            return true;
+        }
+        // An invalid bag cuts the supermodes at its k-point short, which moves the segments.
+        if (std::ranges::find(bag_idxs, Bag::invalid_idx) != bag_idxs.end() ||
+            std::ranges::find(supermodes, Bag::invalid_idx, &Supermode::bag_idx) !=
+                supermodes.end()) {
+            return false;
+        }
+        spans_changed =
+            write_segments(superband, superk_idx, 0, supermodes.size()) || spans_changed;
+        return true;
+    };
+
+    if (superband.get_energetics_order() == EnergeticsOrder::Transpositions) {
+        // Only the transposed supermodes and their mirror images moved.
+        const auto transposed_spans_changed = write_transposed_segments(superband, changed_k_idx);
+        if (!transposed_spans_changed) {
+            rebuild(superband);
+            return true;
+        }
+        if (*transposed_spans_changed) {
+            update_brackets();
+        } else {
+            reset_span_walks();
+        }
+        return *transposed_spans_changed;
+    }
+
+    // `cartesian_permute()` only touches `changed_k_idx`, the faster-varying k-points it resets,
+    // and the k-points mirroring them.
+    bool is_in_place = true;
+    for (const auto superk_idx : superband.permuted_k_idxs()) {
+        is_in_place = is_in_place && rewrite_if_changed(superk_idx);
+        if (superk_idx == changed_k_idx) {
+            break;
+        }
+    }
+    for (const auto &[_, k2idx, __] : data.super_msg.k1idx_k2idx_irrep1idxtoirrep2idx_tuples) {
+        is_in_place = is_in_place && rewrite_if_changed(k2idx);
+    }
+
+    if (!is_in_place) {
+        rebuild(superband);
+        return true;
+    }
+
+    if (spans_changed) {
+        update_brackets();
+    } else {
+        reset_span_walks();
+    }
+    fix_antiunit_rels();
+
+    return spans_changed;
+}
+
+namespace {
+
+Vector<int> bag_idxs_of(const std::vector<Supermode> &supermodes) {
+    Vector<int> result;
+    for (const auto &supermode : supermodes) {
+        result.push_back(supermode.bag_idx);
+    }
+    return result;
+}
+
+// Deal out the sorted `supermodes` one of each bag in turn, e.g. the bags (1, 1, 1, 2, 2, 3) as
+// (1, 2, 3, 1, 2, 1).
+void deal_out_bags(std::vector<Supermode> &supermodes) {
+    const std::size_t num_supermodes = supermodes.size();
+    std::vector<std::vector<Supermode>> runs;
+    for (const auto &supermode : supermodes) {
+        if (runs.empty() || runs.back().front() < supermode) {
+            runs.emplace_back();
+        }
+        runs.back().push_back(supermode);
+    }
+    supermodes.clear();
+    for (std::size_t turn = 0; supermodes.size() < num_supermodes; ++turn) {
+        for (const auto &run : runs) {
+            if (turn < run.size()) {
+                supermodes.push_back(run[turn]);
+            }
+        }
+    }
+}
+
+// Number of distinct orderings of the multiset `pattern`: n! / (n_1! n_2! ...).
+double num_distinct_orderings(const Vector<int> &pattern) {
+    std::map<int, int> element_to_multiplicity;
+    double result = 1.0;
+    for (int i = 0; i < static_cast<int>(pattern.size()); ++i) {
+        result = result * (i + 1) / ++element_to_multiplicity[pattern[i]];
+    }
+    return result;
 }
 
+// Number of distinct orderings of the multiset `keys` that come before `keys` in lexicographic
+// order.
+double lexicographic_rank(const Vector<int> &keys) {
+    std::map<int, int> element_to_multiplicity;
+    for (const auto key : keys) {
+        ++element_to_multiplicity[key];
+    }
+    double num_orderings_left = num_distinct_orderings(keys);
+    double result = 0.0;
+    for (int num_left = static_cast<int>(keys.size()); const auto key : keys) {
+        // Orderings of the elements left that start with a smaller element
+        for (const auto &[element, multiplicity] : element_to_multiplicity) {
+            if (element >= key) {
+                break;
+            }
+            result += num_orderings_left * multiplicity / num_left;
+        }
+        num_orderings_left = num_orderings_left * element_to_multiplicity[key] / num_left;
+        if (--element_to_multiplicity[key] == 0) {
+            element_to_multiplicity.erase(key);
+        }
+        --num_left;
+    }
+    return result;
+}
+
+// Number of distinct orderings of `supermodes` by the SI contributions and dimensions of their
+// bags, the orderings that can change the SIs of the gaps.
+double num_si_orderings(const std::vector<Supermode> &supermodes, const SpectrumData &data) {
+    std::map<std::tuple<bool, PackedSi, int>, int> key_to_idx;
+    Vector<int> pattern;
+    for (const auto &supermode : supermodes) {
+        PackedSi si{0};
+        if (supermode.bag_idx != Bag::invalid_idx) {
+            for (const auto &[_, subirrep_idx] :
+                 supermode.get_bag(data).subk_idx_and_subirrep_idx_pairs) {
+                si = data.sub_si_group.add(si, data.sub_irrepidx_to_packed_si[subirrep_idx]);
+            }
+        }
+        const auto key = std::tuple{supermode.bag_idx == Bag::invalid_idx,
+                                    si,
+                                    data.super_msg.dims[supermode.superirrep_idx]};
+        pattern.push_back(key_to_idx.emplace(key, key_to_idx.size()).first->second);
+    }
+    return num_distinct_orderings(pattern);
+}
+
+}  // namespace
+
 bool Subband::next_energetics() {
+    last_changes_.clear();
+    return energetics_order == EnergeticsOrder::Transpositions
+               ? next_energetics_by_transpositions()
+               : next_energetics_lexicographic();
+}
+
+bool Subband::next_energetics_lexicographic() {
     for (auto &[gaps, allspanstopermute, done] : gaps_allspanstopermute_done_tuples) {
         if (!done) {
-            if (cartesian_permute(allspanstopermute)) {
-                fix_antiunit_rels();
-                return true;
-            } else {
-                done = true;
-                fix_antiunit_rels();
+            // Same odometer as `cartesian_permute(allspanstopermute)`, but only the spans it
+            // touches get their mirror images rewritten.
+            for (auto &span : allspanstopermute) {
+                const bool advanced = std::next_permutation(span.begin(), span.end());
+                fix_antiunit_rels(span);
+                last_changes_.push_back(range_of(span));
+                if (advanced) {
+                    return true;
+                }
+            }
+            last_changes_.clear();
+            done = true;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+bool Subband::next_energetics_by_transpositions() {
+    for (std::size_t bracket_idx = 0; bracket_idx < gaps_allspanstopermute_done_tuples.size();
+         ++bracket_idx) {
+        auto &[gaps, allspanstopermute, done] = gaps_allspanstopermute_done_tuples[bracket_idx];
+        if (done) {
+            continue;
+        }
+
+        auto &span_walks = bracket_idx_to_span_walks[bracket_idx];
+        for (std::size_t i = 0; i < allspanstopermute.size(); ++i) {
+            if (step_span_walk(allspanstopermute[i], span_walks[i])) {
                 return true;
             }
+            // The span is at an end of its walk. It walks back once a slower span has moved.
+            span_walks[i].is_reversed = !span_walks[i].is_reversed;
         }
+
+        // All the spans are at an end of their walks. Sort them, as the lexicographic order leaves
+        // them, so that both orders agree on the following models.
+        finish_bracket(bracket_idx);
+        return true;
     }
 
-    fix_antiunit_rels();
     return false;
 }
 
+bool Subband::skip_bracket() {
+    last_changes_.clear();
+    for (std::size_t bracket_idx = 0; bracket_idx < gaps_allspanstopermute_done_tuples.size();
+         ++bracket_idx) {
+        if (!std::get<2>(gaps_allspanstopermute_done_tuples[bracket_idx])) {
+            finish_bracket(bracket_idx);
+            return true;
+        }
+    }
+    return false;
+}
+
+void Subband::finish_bracket(const std::size_t bracket_idx) {
+    auto &[gaps, allspanstopermute, done] = gaps_allspanstopermute_done_tuples[bracket_idx];
+    for (std::size_t i = 0; i < allspanstopermute.size(); ++i) {
+        std::sort(allspanstopermute[i].begin(), allspanstopermute[i].end());
+        fix_antiunit_rels(allspanstopermute[i]);
+        if (!bracket_idx_to_span_walks.empty()) {
+            auto &span_walk = bracket_idx_to_span_walks[bracket_idx][i];
+            span_walk.step = 0;
+            span_walk.is_reversed = false;
+        }
+    }
+    done = true;
+}
+
+bool Subband::step_span_walk(const Span span, WalkPosition &walk) {
+    const auto [first, last] = walk.advance(span);
+    if (first == last) {
+        return false;
+    }
+    fix_antiunit_rels(span.subspan(first, last - first));
+    const auto [subk_idx, e_idx_begin, _] = range_of(span);
+    last_changes_.push_back({subk_idx, e_idx_begin + first, e_idx_begin + last});
+    return true;
+}
+
+SubmodeRange Subband::range_of(const Span span) const {
+    const auto subk_idx = data.sub_msg.irrepidx_to_kidx[span.front().subirrep_idx];
+    const int e_idx_begin = span.data() - subk_idx_to_e_idx_to_submode[subk_idx].data();
+    return {subk_idx, e_idx_begin, e_idx_begin + static_cast<int>(span.size())};
+}
+
+void Subband::set_energetics_order(const EnergeticsOrder order) {
+    energetics_order = order;
+    reset_span_walks();
+}
+
+void Subband::reset_span_walks() {
+    bracket_idx_to_span_walks.clear();
+    if (energetics_order != EnergeticsOrder::Transpositions) {
+        return;
+    }
+
+    for (const auto &[_, allspanstopermute, __] : gaps_allspanstopermute_done_tuples) {
+        auto &walks = bracket_idx_to_span_walks.emplace_back();
+        for (const auto &span : allspanstopermute) {
+            walks.push_back(transposition_walks.start(span));
+        }
+    }
+}
+
+Vector<std::pair<long, bool>> Subband::get_span_walks() const {
+    Vector<std::pair<long, bool>> result;
+    for (const auto &span_walks : bracket_idx_to_span_walks) {
+        for (const auto &span_walk : span_walks) {
+            result.emplace_back(span_walk.step, span_walk.is_reversed);
+        }
+    }
+    return result;
+}
+
+bool Subband::set_span_walks(const Vector<std::pair<long, bool>> &step_isreversed_pairs) {
+    if (step_isreversed_pairs.size() != get_span_walks().size()) {
+        return false;
+    }
+    auto it = step_isreversed_pairs.begin();
+    for (auto &span_walks : bracket_idx_to_span_walks) {
+        for (auto &span_walk : span_walks) {
+            const auto [step, is_reversed] = *it++;
+            if (step < 0 || step > span_walk.num_steps()) {
+                return false;
+            }
+            span_walk.step = step;
+            span_walk.is_reversed = is_reversed;
+        }
+    }
+    return true;
+}
+
 Vector<short> Subband::make_br(const Vector<int> &e_idxs_beg,
                                const Vector<int> &e_idxs_end,
                                const SpectrumData &data) {
@@ -680,19 +1233,157 @@ Vector<Vector<int>> Subband::dimvalid_e_idxs() {
     return result;
 }
 
-bool Superband::cartesian_permute() {
-    std::set<int> kidxs_to_skip;
-    for (const auto &[_, kidx2, __] : data.super_msg.k1idx_k2idx_irrep1idxtoirrep2idx_tuples) {
-        kidxs_to_skip.insert(kidx2);
+void Superband::set_ordering_strategy(const OrderingStrategy strategy) {
+    std::sort(kidxs_to_permute.begin(), kidxs_to_permute.end());
+    for (const auto kidx : kidxs_to_permute) {
+        auto &supermodes = k_idx_to_e_idx_to_supermode[kidx];
+        std::sort(supermodes.begin(), supermodes.end());
+        if (strategy == OrderingStrategy::ImpactFirstInterleaved) {
+            deal_out_bags(supermodes);
+        }
+    }
+    if (strategy != OrderingStrategy::Lexicographic) {
+        std::map<int, double> kidx_to_impact;
+        for (const auto kidx : kidxs_to_permute) {
+            kidx_to_impact[kidx] = num_si_orderings(k_idx_to_e_idx_to_supermode[kidx], data);
+        }
+        std::stable_sort(kidxs_to_permute.begin(),
+                         kidxs_to_permute.end(),
+                         [&](const int lhs, const int rhs) {
+                             return kidx_to_impact[lhs] > kidx_to_impact[rhs];
+                         });
     }
 
-    for (int kidx = 0; kidx < static_cast<int>(k_idx_to_e_idx_to_supermode.size()); ++kidx) {
-        if (kidxs_to_skip.contains(kidx)) {
+    k_idx_to_first_ordering = k_idx_to_e_idx_to_supermode;
+    reset_k_point_walks();
+    fix_antiunit_rels();
+}
+
+bool Superband::is_at_first_ordering(const int k_idx) const {
+    return std::ranges::equal(k_idx_to_e_idx_to_supermode[k_idx],
+                              k_idx_to_first_ordering[k_idx],
+                              {},
+                              &Supermode::bag_idx,
+                              &Supermode::bag_idx);
+}
+
+void Superband::reset_k_point_walks() {
+    k_idx_to_walk.assign(k_idx_to_e_idx_to_supermode.size(), WalkPosition{});
+    k_idx_to_first_step.assign(k_idx_to_e_idx_to_supermode.size(), 0);
+    if (energetics_order != EnergeticsOrder::Transpositions) {
+        return;
+    }
+
+    TranspositionWalks walks;
+    for (const auto kidx : kidxs_to_permute) {
+        auto supermodes = k_idx_to_e_idx_to_supermode[kidx];
+        std::sort(supermodes.begin(), supermodes.end());
+        auto &walk = k_idx_to_walk[kidx];
+        walk = walks.start(supermodes);
+        if (walk.transpositions == nullptr) {
             continue;
         }
+        while (!std::ranges::equal(
+            supermodes, k_idx_to_first_ordering[kidx], {}, &Supermode::bag_idx, &Supermode::bag_idx)) {
+            walk.advance(supermodes);
+        }
+        k_idx_to_first_step[kidx] = walk.step;
+    }
+}
+
+std::pair<int, int> Superband::step_k_point(const int k_idx) {
+    auto &supermodes = k_idx_to_e_idx_to_supermode[k_idx];
+    auto &walk = k_idx_to_walk[k_idx];
+    const int num_supermodes = static_cast<int>(supermodes.size());
+
+    if (walk.transpositions == nullptr) {
+        // Too many orderings for a walk. Step lexicographically around from the first ordering.
+        if (walk.is_reversed) {
+            if (is_at_first_ordering(k_idx)) {
+                return {0, 0};
+            }
+            std::prev_permutation(supermodes.begin(), supermodes.end());
+        } else {
+            std::next_permutation(supermodes.begin(), supermodes.end());
+            if (is_at_first_ordering(k_idx)) {
+                std::prev_permutation(supermodes.begin(), supermodes.end());
+                return {0, 0};
+            }
+        }
+        return {0, num_supermodes};
+    }
+
+    const long first_step = k_idx_to_first_step[k_idx];
+    const long last_step = first_step == 0 ? walk.num_steps() : first_step - 1;
+    if (walk.step == (walk.is_reversed ? first_step : last_step)) {
+        return {0, 0};
+    }
+    // Jump between the ends of the walk, unless the sweep starts at the sorted supermodes.
+    if (!walk.is_reversed && walk.step == walk.num_steps()) {
+        std::sort(supermodes.begin(), supermodes.end());
+        walk.step = 0;
+        return {0, num_supermodes};
+    }
+    if (walk.is_reversed && walk.step == 0) {
+        walk.move_to_end(supermodes);
+        return {0, num_supermodes};
+    }
+    return walk.advance(supermodes);
+}
+
+void Superband::move_to_end_of_sweep(const int k_idx) {
+    auto &supermodes = k_idx_to_e_idx_to_supermode[k_idx];
+    auto &walk = k_idx_to_walk[k_idx];
+    walk.is_reversed = true;
+    if (walk.transpositions == nullptr) {
+        supermodes = k_idx_to_first_ordering[k_idx];
+        std::prev_permutation(supermodes.begin(), supermodes.end());
+        return;
+    }
+
+    const long first_step = k_idx_to_first_step[k_idx];
+    if (first_step == 0) {
+        walk.move_to_end(supermodes);
+        return;
+    }
+    std::sort(supermodes.begin(), supermodes.end());
+    walk.step = 0;
+    while (walk.step < first_step - 1) {
+        walk.advance(supermodes);
+    }
+}
+
+bool Superband::cartesian_permute() {
+    if (energetics_order == EnergeticsOrder::Transpositions) {
+        for (const auto kidx : kidxs_to_permute) {
+            const auto [first, last] = step_k_point(kidx);
+            if (first < last) {
+                last_changed_k_idx_ = kidx;
+                last_changed_e_idxs_ = {first, last};
+                fix_antiunit_rels(kidx, first, last);
+                return true;
+            }
+            // The k-point is at an end of its sweep. It sweeps back once a slower one has moved.
+            k_idx_to_walk[kidx].is_reversed = !k_idx_to_walk[kidx].is_reversed;
+        }
+
+        // All the k-points are at an end of their sweeps. Start over from the first orderings, as
+        // the lexicographic order does.
+        for (const auto kidx : kidxs_to_permute) {
+            k_idx_to_e_idx_to_supermode[kidx] = k_idx_to_first_ordering[kidx];
+            k_idx_to_walk[kidx].step = k_idx_to_first_step[kidx];
+            k_idx_to_walk[kidx].is_reversed = false;
+        }
+        fix_antiunit_rels();
+        return false;
+    }
 
+    for (const auto kidx : kidxs_to_permute) {
         auto &supermodes = k_idx_to_e_idx_to_supermode[kidx];
-        if (std::next_permutation(supermodes.begin(), supermodes.end())) {
+        last_changed_k_idx_ = kidx;
+        // From the sorted ordering, `std::next_permutation()` goes on to the first one again.
+        std::next_permutation(supermodes.begin(), supermodes.end());
+        if (!is_at_first_ordering(kidx)) {
             fix_antiunit_rels();
             return true;
         }
@@ -702,12 +1393,77 @@ bool Superband::cartesian_permute() {
     return false;
 }
 
-std::map<int, std::pair<bool, MatrixInt>> Subband::calc_gap_sis() const {
-    std::map<int, std::pair<bool, MatrixInt>> result;
+Vector<std::pair<long, bool>> Superband::get_k_point_walks() const {
+    Vector<std::pair<long, bool>> result;
+    if (energetics_order != EnergeticsOrder::Transpositions) {
+        return result;
+    }
+    for (const auto kidx : kidxs_to_permute) {
+        result.emplace_back(k_idx_to_walk[kidx].step, k_idx_to_walk[kidx].is_reversed);
+    }
+    return result;
+}
+
+bool Superband::set_k_point_walks(const Vector<std::pair<long, bool>> &step_isreversed_pairs) {
+    if (step_isreversed_pairs.size() != get_k_point_walks().size()) {
+        return false;
+    }
+    for (std::size_t i = 0; i < step_isreversed_pairs.size(); ++i) {
+        auto &walk = k_idx_to_walk[kidxs_to_permute[i]];
+        const auto [step, is_reversed] = step_isreversed_pairs[i];
+        if (step < 0 || step > walk.num_steps()) {
+            return false;
+        }
+        walk.step = step;
+        walk.is_reversed = is_reversed;
+    }
+    return true;
+}
+
+double Superband::num_orderings() const {
+    double result = 1.0;
+    for (const auto kidx : kidxs_to_permute) {
+        result *= num_distinct_orderings(bag_idxs_of(k_idx_to_e_idx_to_supermode[kidx]));
+    }
+    return result;
+}
+
+double Superband::ordering_rank() const {
+    // A mixed-radix number, with the fastest-varying k-point as its lowest digit. In
+    // `EnergeticsOrder::Transpositions`, a digit counts the steps taken along its sweep in the
+    // current direction, as in a reflected Gray code.
+    double result = 0.0;
+    double num_faster_orderings = 1.0;
+    for (const auto kidx : kidxs_to_permute) {
+        const auto bag_idxs = bag_idxs_of(k_idx_to_e_idx_to_supermode[kidx]);
+        const double num_orderings = num_distinct_orderings(bag_idxs);
+        // Ranks counted from the first ordering, wrapping around past the last one
+        double rank = lexicographic_rank(bag_idxs) -
+                      lexicographic_rank(bag_idxs_of(k_idx_to_first_ordering[kidx]));
+        if (energetics_order == EnergeticsOrder::Transpositions) {
+            const auto &walk = k_idx_to_walk[kidx];
+            if (walk.transpositions != nullptr) {
+                rank = static_cast<double>(walk.step - k_idx_to_first_step[kidx]);
+            }
+        }
+        if (rank < 0.0) {
+            rank += num_orderings;
+        }
+        if (energetics_order == EnergeticsOrder::Transpositions && k_idx_to_walk[kidx].is_reversed) {
+            rank = num_orderings - 1.0 - rank;
+        }
+        result += rank * num_faster_orderings;
+        num_faster_orderings *= num_orderings;
+    }
+    return result;
+}
+
+std::map<int, std::pair<bool, PackedSi>> Subband::calc_gap_sis() const {
+    std::map<int, std::pair<bool, PackedSi>> result;
 
     assert(num_bands >= 1);
 
-    MatrixInt si = 0 * data.sub_msg.si_matrix.col(0);
+    PackedSi si{0};
     MatrixInt cr = 0 * data.sub_msg.comp_rels_matrix.col(0);
 
     Vector<int> subk_idx_to_numbandsbelow(data.sub_msg.ks.size(), 0);
@@ -725,7 +1481,7 @@ std::map<int, std::pair<bool, MatrixInt>> Subband::calc_gap_sis() const {
 
                 numbandsbelow += data.sub_msg.dims[cur_subirrep_idx];
 
-                si += data.sub_msg.si_matrix.col(cur_subirrep_idx);
+                si = data.sub_si_group.add(si, data.sub_irrepidx_to_packed_si[cur_subirrep_idx]);
                 cr += data.sub_msg.comp_rels_matrix.col(cur_subirrep_idx);
 
                 ++submode_it;
@@ -745,14 +1501,7 @@ std::map<int, std::pair<bool, MatrixInt>> Subband::calc_gap_sis() const {
             }
         }
 
-        result[gap].first = gapped;
-        if (gapped) {
-            assert(si.size() == static_cast<int>(data.sub_msg.si_orders.size()));
-            for (int i = 0; i < si.size(); ++i) {
-                si(i) %= data.sub_msg.si_orders[i];
-            }
-            result[gap].second = si;
-        }
+        result[gap] = {gapped, si};
     }
 
     return result;
@@ -768,7 +1517,8 @@ bool Superband::satisfies_antiunit_rels() const {
         for (int e_idx = 0; e_idx < static_cast<int>(first_e_idx_to_supermode.size()); ++e_idx) {
             const auto irrep1_idx = first_e_idx_to_supermode[e_idx].superirrep_idx;
             const auto irrep2_idx = second_e_idx_to_supermode[e_idx].superirrep_idx;
-            if (irrep1idx_to_irrep2idx.at(irrep1_idx) != irrep2_idx) {
+            assert(irrep1idx_to_irrep2idx[irrep1_idx] >= 0);
+            if (irrep1idx_to_irrep2idx[irrep1_idx] != irrep2_idx) {
                 return false;
             }
         }
@@ -787,7 +1537,8 @@ bool Subband::satisfies_antiunit_rels() const {
         for (int e_idx = 0; e_idx < static_cast<int>(first_e_idx_to_submode.size()); ++e_idx) {
             const auto irrep1_idx = first_e_idx_to_submode[e_idx].subirrep_idx;
             const auto irrep2_idx = second_e_idx_to_submode[e_idx].subirrep_idx;
-            if (irrep1idx_to_irrep2idx.at(irrep1_idx) != irrep2_idx) {
+            assert(irrep1idx_to_irrep2idx[irrep1_idx] >= 0);
+            if (irrep1idx_to_irrep2idx[irrep1_idx] != irrep2_idx) {
                 return false;
             }
         }
@@ -802,7 +1553,25 @@ void Subband::fix_antiunit_rels() {
         const auto &submodes1 = subk_idx_to_e_idx_to_submode[k1idx];
         auto &submodes2 = subk_idx_to_e_idx_to_submode[k2idx];
         for (int i = 0; i < static_cast<int>(submodes1.size()); ++i) {
-            submodes2[i] = Submode(irrepidx1_to_irrepidx2.at(submodes1[i].subirrep_idx));
+            assert(irrepidx1_to_irrepidx2[submodes1[i].subirrep_idx] >= 0);
+            submodes2[i] = Submode(irrepidx1_to_irrepidx2[submodes1[i].subirrep_idx]);
+        }
+    }
+}
+
+void Subband::fix_antiunit_rels(const Span span) {
+    const auto k_idx = data.sub_msg.irrepidx_to_kidx[span.front().subirrep_idx];
+    for (const auto &[k1idx, k2idx, irrepidx1_to_irrepidx2] :
+         data.sub_msg.k1idx_k2idx_irrep1idxtoirrep2idx_tuples) {
+        if (k1idx != k_idx) {
+            continue;
+        }
+        const auto &submodes1 = subk_idx_to_e_idx_to_submode[k1idx];
+        auto &submodes2 = subk_idx_to_e_idx_to_submode[k2idx];
+        const auto first_e_idx = span.data() - submodes1.data();
+        for (int i = 0; i < static_cast<int>(span.size()); ++i) {
+            assert(irrepidx1_to_irrepidx2[span[i].subirrep_idx] >= 0);
+            submodes2[first_e_idx + i] = Submode(irrepidx1_to_irrepidx2[span[i].subirrep_idx]);
         }
     }
 }
@@ -813,9 +1582,25 @@ void Superband::fix_antiunit_rels() {
         const auto &supermodes1 = k_idx_to_e_idx_to_supermode[k1idx];
         auto &supermodes2 = k_idx_to_e_idx_to_supermode[k2idx];
         for (int i = 0; i < static_cast<int>(supermodes1.size()); ++i) {
-            supermodes2[i] = Supermode(
-                data.super_msg.irreps[irrepidx1_to_irrepidx2.at(supermodes1[i].superirrep_idx)],
-                data);
+            const auto partner_idx = irrepidx1_to_irrepidx2[supermodes1[i].superirrep_idx];
+            assert(partner_idx >= 0);
+            supermodes2[i] = Supermode(partner_idx, data);
+        }
+    }
+}
+
+void Superband::fix_antiunit_rels(const int k_idx, const int first, const int last) {
+    for (const auto &[k1idx, k2idx, irrepidx1_to_irrepidx2] :
+         data.super_msg.k1idx_k2idx_irrep1idxtoirrep2idx_tuples) {
+        if (k1idx != k_idx) {
+            continue;
+        }
+        const auto &supermodes1 = k_idx_to_e_idx_to_supermode[k1idx];
+        auto &supermodes2 = k_idx_to_e_idx_to_supermode[k2idx];
+        for (int i = first; i < last; ++i) {
+            const auto partner_idx = irrepidx1_to_irrepidx2[supermodes1[i].superirrep_idx];
+            assert(partner_idx >= 0);
+            supermodes2[i] = Supermode(partner_idx, data);
         }
     }
 }
@@ -1,6 +1,8 @@
 #pragma once
 
+#include <cstdint>
 #include <map>
+#include <optional>
 #include <span>
 #include <string>
 #include <tuple>
@@ -9,13 +11,16 @@
 
 #include "Eigen/Core"
 
+#include "diagnose2/packed_si.hpp"
 #include "diagnose2/perturbed_band_structure.pb.h"
+#include "diagnose2/transposition_walk.hpp"
 #include "diagnose2/utility.hpp"
 #include "utils/comparable.hpp"
 
 namespace magnon::diagnose2 {
 
 class Bag;
+class Superband;
 
 struct SpectrumData {
     SpectrumData() = default;
@@ -33,7 +38,10 @@ struct SpectrumData {
         std::vector<std::string> ks;
         std::vector<std::string> kcoords;
 
-        std::vector<std::tuple<int, int, std::map<int, int>>>
+        // For each pair of antiunitarily related k-points, the permutation table mapping an irrep
+        // index at the first k-point to the related irrep index at the second one, indexed by
+        // irrep index (-1 for irreps at other k-points).
+        std::vector<std::tuple<int, int, std::vector<std::int16_t>>>
             k1idx_k2idx_irrep1idxtoirrep2idx_tuples;
 
         std::map<std::string,
@@ -71,6 +79,15 @@ struct SpectrumData {
 
     std::vector<Bag> unique_bags;
 
+    // Index of the bag of each supergroup irrep in `unique_bags`, by irrep index
+    // (`Bag::invalid_idx` if it has none)
+    std::vector<int> superirrep_idx_to_bag_idx;
+
+    // Symmetry indicator group of the subgroup, and the packed SI contribution of each subgroup
+    // irrep.
+    SiGroup sub_si_group;
+    std::vector<PackedSi> sub_irrepidx_to_packed_si;
+
     std::string firstsiteirrep_and_wp_as_strkey() const;
     std::string site_irreps_as_str() const;
     std::string make_br_label() const;
@@ -101,6 +118,8 @@ class Bag {
 class Supermode {
  public:
     Supermode(const std::string &superirrep, const SpectrumData &data);
+    Supermode(int superirrep_idx, const SpectrumData &data)
+        : superirrep_idx{superirrep_idx}, bag_idx{data.superirrep_idx_to_bag_idx[superirrep_idx]} {}
 
     const Bag &get_bag(const SpectrumData &data) const;
 
@@ -130,6 +149,25 @@ class Submode {
 using Span = std::span<Submode>;
 using Spans = Vector<std::span<Submode>>;
 
+// Submodes `e_idx_begin`, ..., `e_idx_end - 1` at a subgroup k-point.
+struct SubmodeRange {
+    int subk_idx;
+    int e_idx_begin;
+    int e_idx_end;
+};
+
+// Order in which `Subband::next_energetics()` visits the orderings of the spans of a bracket, and
+// `Superband::cartesian_permute()` the orderings of the supermodes at the k-points. Both visit the
+// same models.
+enum class EnergeticsOrder {
+    // Each span or k-point in lexicographic order, with them as the digits of an odometer.
+    Lexicographic,
+    // Each step transposes two submodes of one span, or two supermodes at one k-point, at most two
+    // positions apart (see `make_transposition_walk()`), so that only the gaps between them change.
+    // The spans or k-points are the digits of a reflected (Gray-code) odometer.
+    Transpositions
+};
+
 class Subband {
  public:
     Subband(const SpectrumData &data) : data{data} {}
@@ -141,17 +179,49 @@ class Subband {
                           const Vector<int> &e_idxs_end,
                           const SpectrumData &data);
 
-    std::map<int, std::pair<bool, MatrixInt>> calc_gap_sis() const;
+    std::map<int, std::pair<bool, PackedSi>> calc_gap_sis() const;
 
     bool next_energetics();
+    // Finish the bracket being enumerated without visiting its remaining models, as
+    // `next_energetics()` does after its last model. Return false if all brackets were done.
+    bool skip_bracket();
+    // Submodes reordered by the last `next_energetics()`, mirror images excluded. They always lie
+    // within the spans of the bracket being enumerated. Empty after a bracket was finished, which
+    // puts its spans back in sorted order.
+    const Vector<SubmodeRange> &last_changes() const { return last_changes_; }
+
+    // Restarts the enumeration of the unfinished brackets.
+    void set_energetics_order(EnergeticsOrder order);
+    EnergeticsOrder get_energetics_order() const { return energetics_order; }
+
+    // Position of each span of each bracket in the `EnergeticsOrder::Transpositions` enumeration,
+    // as (step, is reversed) pairs, brackets first. Empty in lexicographic order, where the
+    // submode order alone determines the position.
+    Vector<std::pair<long, bool>> get_span_walks() const;
+    // Return false if the positions do not fit the spans.
+    bool set_span_walks(const Vector<std::pair<long, bool>> &step_isreversed_pairs);
+
     bool satisfies_antiunit_rels() const;
     void fix_antiunit_rels();
 
+    // Rewrite the mirror images of `span` only. Enough after permuting submodes within `span`.
+    void fix_antiunit_rels(Span span);
+
     int get_num_bands() const {
         assert(num_bands >= 1);
         return num_bands;
     };
 
+    const SpectrumData &get_data() const { return data; }
+
+    // Bring the subband in line with `superband` after `Superband::cartesian_permute()` advanced
+    // the supermodes at `changed_k_idx`, and reset those at the faster-varying k-points. Only the
+    // submodes contributed by the changed k-points are rewritten, in place, and the gap brackets
+    // are only rebuilt if the span layout changed. With `EnergeticsOrder::Transpositions`, only the
+    // submodes of the two transposed supermodes and those between them are. The result is the same
+    // as `superband.make_subband()`. Return whether the brackets or spans changed.
+    bool rebase(const Superband &superband, int changed_k_idx);
+
  public:
     Vector<Vector<Submode>> subk_idx_to_e_idx_to_submode;
 
@@ -160,19 +230,128 @@ class Subband {
     Vector<int> all_possible_gaps;
 
  private:
+    // The submodes that the supermodes at one supergroup k-point contribute at one subgroup
+    // k-point. Reordering the supermodes at a k-point leaves the extent of the segment unchanged.
+    struct Segment {
+        int e_idx_begin = 0;
+        int e_idx_end = 0;
+        int numbandsbelow = 0;
+
+        // (size, dim, is trivial) of the span of each supermode with submodes in the segment
+        Vector<std::tuple<int, int, bool>> span_size_dim_istrivial_tuples;
+        // Gaps attainable within the segment by permuting the submodes of its spans
+        Vector<int> possible_gaps;
+
+        // Where the submodes of each supermode at the k-point start in the segment, the bands
+        // below them, and their first entries in the two vectors above, and where the last
+        // supermode with a bag ends. Lets the segment be rewritten in part.
+        struct Offsets {
+            int e_idx;
+            int numbandsbelow;
+            int span_idx;
+            int possible_gap_idx;
+        };
+        Vector<Offsets> supermode_idx_to_offsets;
+    };
+
+    bool next_energetics_lexicographic();
+    bool next_energetics_by_transpositions();
+    // Move `span` and its mirror images one step along `walk`, and return false if `span` is at the
+    // end of the walk.
+    bool step_span_walk(Span span, WalkPosition &walk);
+    // Put the spans of the bracket back in sorted order, at the start of their walks, and mark it
+    // done.
+    void finish_bracket(std::size_t bracket_idx);
+    SubmodeRange range_of(Span span) const;
+    // Put the walks of all spans at their start, which the sorted spans are in.
+    void reset_span_walks();
+
+    void rebuild(const Superband &superband);
+    // Rewrite the segments of the supermodes `first`, ..., `last - 1` at `superk_idx`, or up to
+    // the first one without a bag, and return whether their spans changed. The extent of the
+    // segments must be unchanged, and so must that of the parts rewritten unless `last` is the
+    // number of supermodes.
+    bool write_segments(const Superband &superband, int superk_idx, int first, int last);
+    // Rewrite the segments that `superband.last_changed_e_idxs()` transposed, and return
+    // whether their spans changed, or nullopt if the supermodes at the k-point are cut short.
+    std::optional<bool> write_transposed_segments(const Superband &superband, int changed_k_idx);
+    void update_brackets();
+
     const SpectrumData &data;
     int num_bands = -1;
+
+    Vector<Vector<Segment>> superk_idx_to_subk_idx_to_segment;
+    Vector<Vector<int>> superk_idx_to_e_idx_to_bag_idx;  // Supermodes the segments were built from
+
+    EnergeticsOrder energetics_order = EnergeticsOrder::Lexicographic;
+    Vector<SubmodeRange> last_changes_;
+    Vector<Vector<WalkPosition>> bracket_idx_to_span_walks;
+    TranspositionWalks transposition_walks;
+
     friend class Superband;
 };
 
+// Order in which `Superband::cartesian_permute()` visits the superband orderings. All visit every
+// ordering once; they differ in how soon a search reaches the ones that exclude a perturbation.
+enum class OrderingStrategy {
+    // The k-points vary in index order, fastest first, each from its sorted supermodes.
+    Lexicographic,
+    // The k-points whose orderings reorder the most SI contributions vary fastest, so that the
+    // slowest ones, whose orderings are kept the longest, matter the least.
+    ImpactFirst,
+    // As `ImpactFirst`, with each k-point starting from its bags dealt out in turn rather than
+    // grouped, and wrapping around through the sorted ordering back to it.
+    ImpactFirstInterleaved,
+};
+
 class Superband {
  public:
     Superband(const std::vector<std::string> &superirreps, const SpectrumData &data);
 
+    // Must be called on a superband that has not been permuted yet. Both are lexicographic by
+    // default, and can be set in either order.
+    void set_energetics_order(EnergeticsOrder order);
+    EnergeticsOrder get_energetics_order() const { return energetics_order; }
+    void set_ordering_strategy(OrderingStrategy strategy);
+
     friend std::ostream &operator<<(std::ostream &out, const Superband &b);
     bool cartesian_permute();
+    // k-point whose supermodes the last `cartesian_permute()` advanced
+    int last_changed_k_idx() const { return last_changed_k_idx_; }
+    // With `EnergeticsOrder::Transpositions`, the energy indices of the supermodes the last
+    // `cartesian_permute()` reordered at `last_changed_k_idx()`, as a half-open interval. The
+    // supermodes at the other k-points are left as they were, mirror images aside.
+    std::pair<int, int> last_changed_e_idxs() const { return last_changed_e_idxs_; }
+
+    // Position of each permuted k-point in its `EnergeticsOrder::Transpositions` walk, as
+    // (step, is reversed) pairs, fastest-varying first. Empty in lexicographic order, where the
+    // supermode order alone determines the position.
+    Vector<std::pair<long, bool>> get_k_point_walks() const;
+    // Return false if the positions do not fit the permuted k-points.
+    bool set_k_point_walks(const Vector<std::pair<long, bool>> &step_isreversed_pairs);
+
+    // Split the orderings visited by `cartesian_permute()` into disjoint chunks by fixing the
+    // supermode order at the slowest-varying k-points. Each returned superband only permutes the
+    // remaining k-points, and the chunks are returned in the order a serial enumeration visits
+    // them. Must be called on a superband that has not been permuted yet.
+    std::vector<Superband> split(int min_num_chunks) const;
+
+    // k-points permuted by `cartesian_permute()`, fastest-varying first.
+    const std::vector<int> &permuted_k_idxs() const { return kidxs_to_permute; }
+    int num_permuted_k_points() const { return static_cast<int>(kidxs_to_permute.size()); }
+    // Keep the supermodes at all but the `num_permuted` fastest-varying k-points fixed.
+    void fix_slowest_k_points(int num_permuted);
+
+    // Number of orderings `cartesian_permute()` visits from the first one, and the number of them
+    // it visits before the current ordering. Doubles, as they easily exceed 64 bits; they
+    // are exact up to 2^53.
+    double num_orderings() const;
+    double ordering_rank() const;
+
     bool satisfies_antiunit_rels() const;
     void fix_antiunit_rels();
+    // Rewrite the mirror images of the supermodes `first`, ..., `last - 1` at `k_idx` only.
+    void fix_antiunit_rels(int k_idx, int first, int last);
 
     int num_supermodes() const;
 
@@ -181,6 +360,33 @@ class Superband {
  public:
     std::vector<std::vector<Supermode>> k_idx_to_e_idx_to_supermode;
     const SpectrumData &data;
+
+ private:
+    // k-points permuted by `cartesian_permute()`, fastest-varying first. k-points whose supermodes
+    // are fixed by antiunitary relations are excluded.
+    std::vector<int> kidxs_to_permute;
+    int last_changed_k_idx_ = -1;
+    // The first ordering `cartesian_permute()` visits at each k-point, which it returns to once it
+    // went through all of them.
+    std::vector<std::vector<Supermode>> k_idx_to_first_ordering;
+
+    EnergeticsOrder energetics_order = EnergeticsOrder::Lexicographic;
+    std::pair<int, int> last_changed_e_idxs_;
+    // With `EnergeticsOrder::Transpositions`, the walks go from the sorted supermodes. Each k-point
+    // starts at the step of its first ordering, goes on to the end of the walk, jumps back to its
+    // start, and stops before the first ordering again.
+    Vector<WalkPosition> k_idx_to_walk;
+    Vector<long> k_idx_to_first_step;
+
+    bool is_at_first_ordering(int k_idx) const;
+    // Put the walks at the first orderings.
+    void reset_k_point_walks();
+    // Move `k_idx` one step along its sweep through its orderings, and return the energy indices
+    // of the supermodes it reordered as a half-open interval, or an empty one at the end of the
+    // sweep.
+    std::pair<int, int> step_k_point(int k_idx);
+    // Move `k_idx` to the end of its forward sweep, to walk it back.
+    void move_to_end_of_sweep(int k_idx);
 };
 
 }  // namespace magnon::diagnose2
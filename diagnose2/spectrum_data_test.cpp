@@ -0,0 +1,388 @@
+#include "diagnose2/spectrum_data.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <set>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include "diagnose2/test_structures.hpp"
+#include "gtest/gtest.h"
+
+namespace magnon::diagnose2 {
+
+// Brackets as (gaps, (subk_idx, first e_idx, size) of each span) tuples, comparable across
+// subbands.
+auto brackets_of(const Subband &subband) {
+    const auto &data = subband.get_data();
+    using SpanPosition = std::tuple<int, long, long>;
+    std::vector<std::tuple<Vector<int>, Vector<SpanPosition>>> result;
+    for (const auto &[gaps, spans, __] : subband.gaps_allspanstopermute_done_tuples) {
+        auto &[_, result_spans] = result.emplace_back(gaps, Vector<SpanPosition>{});
+        for (const auto &span : spans) {
+            const auto subk_idx = data.sub_msg.irrepidx_to_kidx[span.front().subirrep_idx];
+            result_spans.emplace_back(
+                subk_idx,
+                span.data() - subband.subk_idx_to_e_idx_to_submode[subk_idx].data(),
+                span.size());
+        }
+    }
+    return result;
+}
+
+void check_rebase_matches_make_subband(const EnergeticsOrder order) {
+    // Every supermode twice, so that the spans differ between orderings.
+    const auto structure = make_copies(read_structure(), 2);
+    const SpectrumData data(structure);
+
+    Superband superband(positive_energy_irreps(structure), data);
+    superband.set_energetics_order(order);
+
+    Subband subband = superband.make_subband();
+    int num_orderings = 0;
+    do {
+        // Leave the energetics enumeration unfinished now and then.
+        for (int i = 0; i < num_orderings % 3 && subband.next_energetics(); ++i) {
+        }
+
+        if (num_orderings > 0) {
+            subband.rebase(superband, superband.last_changed_k_idx());
+        }
+        const Subband expected = superband.make_subband();
+
+        ASSERT_TRUE(subband.subk_idx_to_e_idx_to_submode == expected.subk_idx_to_e_idx_to_submode);
+        ASSERT_EQ(subband.all_possible_gaps, expected.all_possible_gaps);
+        ASSERT_EQ(subband.get_num_bands(), expected.get_num_bands());
+        ASSERT_EQ(brackets_of(subband), brackets_of(expected));
+        for (const auto &[_, __, done] : subband.gaps_allspanstopermute_done_tuples) {
+            ASSERT_FALSE(done);
+        }
+        ++num_orderings;
+    } while (superband.cartesian_permute());
+
+    EXPECT_GT(num_orderings, 1);
+}
+
+TEST(SubbandTest, RebaseMatchesMakeSubband) {
+    check_rebase_matches_make_subband(EnergeticsOrder::Lexicographic);
+    check_rebase_matches_make_subband(EnergeticsOrder::Transpositions);
+}
+
+TEST(SubbandTest, TranspositionsVisitSameModels) {
+    const auto structure = make_copies(read_structure(), 2);
+    const SpectrumData data(structure);
+
+    Superband superband(positive_energy_irreps(structure), data);
+
+    Subband lexicographic = superband.make_subband();
+    Subband transpositions = superband.make_subband();
+    transpositions.set_energetics_order(EnergeticsOrder::Transpositions);
+    do {
+        std::vector<Vector<Vector<Submode>>> expected_models;
+        do {
+            expected_models.push_back(lexicographic.subk_idx_to_e_idx_to_submode);
+        } while (lexicographic.next_energetics());
+
+        std::vector<Vector<Vector<Submode>>> models;
+        do {
+            models.push_back(transpositions.subk_idx_to_e_idx_to_submode);
+            ASSERT_TRUE(transpositions.satisfies_antiunit_rels());
+        } while (transpositions.next_energetics());
+
+        // Both end on the same model, from which the next ordering is rebased.
+        ASSERT_TRUE(models.back() == expected_models.back());
+        std::sort(expected_models.begin(), expected_models.end());
+        std::sort(models.begin(), models.end());
+        ASSERT_TRUE(models == expected_models);
+
+        if (superband.cartesian_permute()) {
+            lexicographic.rebase(superband, superband.last_changed_k_idx());
+            transpositions.rebase(superband, superband.last_changed_k_idx());
+        } else {
+            break;
+        }
+    } while (true);
+}
+
+TEST(SubbandTest, SkipBracketMatchesFinishingIt) {
+    const auto structure = make_copies(read_structure(), 2);
+    const SpectrumData data(structure);
+
+    const Superband superband(positive_energy_irreps(structure), data);
+
+    for (const auto order : {EnergeticsOrder::Lexicographic, EnergeticsOrder::Transpositions}) {
+        // Made apart, as the brackets of a copy would still point into the original.
+        Subband finished = superband.make_subband();
+        Subband skipped = superband.make_subband();
+        finished.set_energetics_order(order);
+        skipped.set_energetics_order(order);
+        ASSERT_FALSE(finished.gaps_allspanstopermute_done_tuples.empty());
+        const auto &first_done = std::get<2>(finished.gaps_allspanstopermute_done_tuples.front());
+        int num_steps = 0;
+        while (!first_done) {
+            ASSERT_TRUE(finished.next_energetics());
+            ++num_steps;
+        }
+        ASSERT_GT(num_steps, 2);
+
+        // Skip the first bracket partway through its models.
+        ASSERT_TRUE(skipped.next_energetics());
+        ASSERT_TRUE(skipped.skip_bracket());
+        EXPECT_TRUE(skipped.last_changes().empty());
+        EXPECT_TRUE(skipped.subk_idx_to_e_idx_to_submode == finished.subk_idx_to_e_idx_to_submode);
+        EXPECT_EQ(skipped.get_span_walks(), finished.get_span_walks());
+
+        // Both go on alike.
+        bool has_next = true;
+        while (has_next) {
+            ASSERT_TRUE(skipped.subk_idx_to_e_idx_to_submode ==
+                        finished.subk_idx_to_e_idx_to_submode);
+            has_next = finished.next_energetics();
+            ASSERT_EQ(skipped.next_energetics(), has_next);
+        }
+        EXPECT_FALSE(skipped.skip_bracket());
+    }
+}
+
+// Bags of the supermodes at each k-point
+Vector<Vector<int>> bags_of(const Superband &superband) {
+    Vector<Vector<int>> result;
+    for (const auto &supermodes : superband.k_idx_to_e_idx_to_supermode) {
+        auto &bag_idxs = result.emplace_back();
+        for (const auto &supermode : supermodes) {
+            bag_idxs.push_back(supermode.bag_idx);
+        }
+    }
+    return result;
+}
+
+// The test structure has a single k-point with more than one ordering. Give two more k-points the
+// supermodes of that one, or a part of them, to walk several k-points through their orderings.
+Superband make_multi_k_superband(const SpectrumData &data, const PerturbedBandStructure &structure) {
+    Superband result(positive_energy_irreps(structure), data);
+    auto &k_idx_to_e_idx_to_supermode = result.k_idx_to_e_idx_to_supermode;
+    const auto &k_idxs = result.permuted_k_idxs();
+    assert(k_idxs.size() >= 3);
+    const auto supermodes = k_idx_to_e_idx_to_supermode[k_idxs[0]];
+    k_idx_to_e_idx_to_supermode[k_idxs[1]] = supermodes;
+    k_idx_to_e_idx_to_supermode[k_idxs[2]] = {supermodes.front(), supermodes.back()};
+    result.set_ordering_strategy(OrderingStrategy::Lexicographic);
+    return result;
+}
+
+Vector<Vector<Vector<int>>> visit_orderings(Superband &superband) {
+    Vector<Vector<Vector<int>>> result;
+    do {
+        result.push_back(bags_of(superband));
+    } while (superband.cartesian_permute());
+    return result;
+}
+
+TEST(SuperbandTest, TranspositionsVisitSameOrderings) {
+    const auto structure = make_copies(read_structure(), 2);
+    const SpectrumData data(structure);
+
+    Superband lexicographic = make_multi_k_superband(data, structure);
+    Superband transpositions = lexicographic;
+    transpositions.set_energetics_order(EnergeticsOrder::Transpositions);
+
+    auto expected_orderings = visit_orderings(lexicographic);
+    Vector<Vector<Vector<int>>> orderings{bags_of(transpositions)};
+    while (transpositions.cartesian_permute()) {
+        const auto k_idx = transpositions.last_changed_k_idx();
+        const auto [first, last] = transpositions.last_changed_e_idxs();
+        ASSERT_GE(last - first, 2);
+        ASSERT_LE(last - first, 3);
+
+        // Only the transposed supermodes moved.
+        auto expected = orderings.back();
+        std::swap(expected[k_idx][first], expected[k_idx][last - 1]);
+        orderings.push_back(bags_of(transpositions));
+        ASSERT_EQ(orderings.back(), expected);
+    }
+    // Both start over from the first ordering.
+    EXPECT_EQ(bags_of(transpositions), orderings.front());
+    EXPECT_EQ(bags_of(lexicographic), expected_orderings.front());
+
+    EXPECT_EQ(expected_orderings.size(), 6 * 6 * 2);
+    std::sort(expected_orderings.begin(), expected_orderings.end());
+    std::sort(orderings.begin(), orderings.end());
+    EXPECT_EQ(orderings, expected_orderings);
+}
+
+TEST(SuperbandTest, SplitFollowsSerialWalk) {
+    const auto structure = make_copies(read_structure(), 2);
+    const SpectrumData data(structure);
+
+    for (const auto order : {EnergeticsOrder::Lexicographic, EnergeticsOrder::Transpositions}) {
+        Superband superband = make_multi_k_superband(data, structure);
+        superband.set_energetics_order(order);
+        const auto chunks = superband.split(1);
+        const auto expected_orderings = visit_orderings(superband);
+
+        for (const int min_num_chunks : {2, 6, 7, 36, 72}) {
+            Vector<Vector<Vector<int>>> orderings;
+            for (auto chunk : superband.split(min_num_chunks)) {
+                const auto chunk_orderings = visit_orderings(chunk);
+                orderings.insert(orderings.end(), chunk_orderings.begin(), chunk_orderings.end());
+            }
+            EXPECT_EQ(orderings, expected_orderings) << "min_num_chunks: " << min_num_chunks;
+        }
+    }
+}
+
+TEST(SuperbandTest, RestoresKPointWalks) {
+    const auto structure = make_copies(read_structure(), 2);
+    const SpectrumData data(structure);
+
+    Superband superband = make_multi_k_superband(data, structure);
+    superband.set_energetics_order(EnergeticsOrder::Transpositions);
+    EXPECT_EQ(superband.get_k_point_walks().size(), superband.permuted_k_idxs().size());
+    for (int i = 0; i < 20; ++i) {
+        ASSERT_TRUE(superband.cartesian_permute());
+    }
+
+    // A copy of the supermodes with the walk positions continues the same way.
+    Superband restored = make_multi_k_superband(data, structure);
+    restored.set_energetics_order(EnergeticsOrder::Transpositions);
+    restored.k_idx_to_e_idx_to_supermode = superband.k_idx_to_e_idx_to_supermode;
+    ASSERT_TRUE(restored.set_k_point_walks(superband.get_k_point_walks()));
+    EXPECT_EQ(visit_orderings(restored), visit_orderings(superband));
+
+    EXPECT_FALSE(restored.set_k_point_walks({}));
+    EXPECT_FALSE(restored.set_k_point_walks(
+        Vector<std::pair<long, bool>>(superband.get_k_point_walks().size(), {1000, false})));
+
+    Superband lexicographic = make_multi_k_superband(data, structure);
+    EXPECT_TRUE(lexicographic.get_k_point_walks().empty());
+    EXPECT_TRUE(lexicographic.set_k_point_walks({}));
+}
+
+TEST(SuperbandTest, OrderingRankCountsVisitedOrderings) {
+    const auto structure = make_copies(read_structure(), 2);
+    const SpectrumData data(structure);
+
+    for (const auto order : {EnergeticsOrder::Lexicographic, EnergeticsOrder::Transpositions}) {
+        Superband superband = make_multi_k_superband(data, structure);
+        superband.set_energetics_order(order);
+
+        Superband permuted = superband;
+        double rank = 0.0;
+        do {
+            ASSERT_EQ(permuted.ordering_rank(), rank++);
+        } while (permuted.cartesian_permute());
+        EXPECT_EQ(rank, superband.num_orderings());
+
+        // The chunks share the orderings out, each starting at its first.
+        double num_chunk_orderings = 0.0;
+        for (const auto &chunk : superband.split(4)) {
+            EXPECT_EQ(chunk.ordering_rank(), 0.0);
+            num_chunk_orderings += chunk.num_orderings();
+        }
+        EXPECT_EQ(num_chunk_orderings, superband.num_orderings());
+    }
+}
+
+TEST(SuperbandTest, OrderingStrategiesVisitEveryOrderingOnce) {
+    const auto structure = make_copies(read_structure(), 3);
+    const SpectrumData data(structure);
+
+    // The bags at each k-point of each ordering visited, in order, checking the subband along
+    const auto visit_and_rebase = [](Superband superband) {
+        Vector<Vector<Vector<int>>> result;
+        Subband subband = superband.make_subband();
+        do {
+            if (!result.empty()) {
+                subband.rebase(superband, superband.last_changed_k_idx());
+            }
+            const Subband expected = superband.make_subband();
+            EXPECT_TRUE(subband.subk_idx_to_e_idx_to_submode ==
+                        expected.subk_idx_to_e_idx_to_submode);
+            EXPECT_EQ(superband.ordering_rank(), static_cast<double>(result.size()));
+            result.push_back(bags_of(superband));
+        } while (superband.cartesian_permute());
+        return result;
+    };
+
+    for (const auto order : {EnergeticsOrder::Lexicographic, EnergeticsOrder::Transpositions}) {
+        Superband lexicographic(positive_energy_irreps(structure), data);
+        lexicographic.set_energetics_order(order);
+        const auto expected_orderings = visit_and_rebase(lexicographic);
+        const std::set expected_ordering_set(expected_orderings.begin(), expected_orderings.end());
+        ASSERT_EQ(expected_ordering_set.size(), expected_orderings.size());
+
+        for (const auto strategy :
+             {OrderingStrategy::ImpactFirst, OrderingStrategy::ImpactFirstInterleaved}) {
+            Superband superband(positive_energy_irreps(structure), data);
+            superband.set_ordering_strategy(strategy);
+            superband.set_energetics_order(order);
+            const auto orderings = visit_and_rebase(superband);
+            EXPECT_EQ(std::set(orderings.begin(), orderings.end()), expected_ordering_set);
+            EXPECT_EQ(orderings.size(), expected_orderings.size());
+            if (strategy == OrderingStrategy::ImpactFirstInterleaved) {
+                EXPECT_NE(orderings.front(), expected_orderings.front());
+            }
+
+            // The chunks visit the same orderings in the same order.
+            Vector<Vector<Vector<int>>> chunk_orderings;
+            for (const auto &chunk : superband.split(4)) {
+                const auto orderings_of_chunk = visit_and_rebase(chunk);
+                chunk_orderings.insert(
+                    chunk_orderings.end(), orderings_of_chunk.begin(), orderings_of_chunk.end());
+            }
+            EXPECT_EQ(chunk_orderings, orderings);
+        }
+    }
+}
+
+TEST(SuperbandTest, FixesEachAntiunitPartnerByItsOwnTable) {
+    // The test structure has no antiunitary relations. Relate one k-point to two others, by
+    // different tables, and give those two the supermodes of the first to be overwritten.
+    const auto structure = read_structure();
+    SpectrumData data(structure);
+    Superband superband(positive_energy_irreps(structure), data);
+    const auto &k_idxs = superband.permuted_k_idxs();
+    ASSERT_GE(k_idxs.size(), 3);
+    const int k1_idx = k_idxs[0];
+    auto &supermodes1 = superband.k_idx_to_e_idx_to_supermode[k1_idx];
+    std::set<int> irrep_idx_set;
+    for (const auto &supermode : supermodes1) {
+        irrep_idx_set.insert(supermode.superirrep_idx);
+    }
+    ASSERT_GE(irrep_idx_set.size(), 2);
+    const Vector<int> irrep_idxs(irrep_idx_set.begin(), irrep_idx_set.end());
+
+    // The identity, and a rotation of the irreps at the first k-point
+    const auto num_irreps = data.super_msg.irreps.size();
+    std::vector<std::int16_t> identity(num_irreps, -1), rotation(num_irreps, -1);
+    for (int i = 0; i < static_cast<int>(irrep_idxs.size()); ++i) {
+        identity[irrep_idxs[i]] = irrep_idxs[i];
+        rotation[irrep_idxs[i]] = irrep_idxs[(i + 1) % irrep_idxs.size()];
+    }
+    data.super_msg.k1idx_k2idx_irrep1idxtoirrep2idx_tuples = {{k1_idx, k_idxs[1], identity},
+                                                              {k1_idx, k_idxs[2], rotation}};
+    superband.k_idx_to_e_idx_to_supermode[k_idxs[1]] = supermodes1;
+    superband.k_idx_to_e_idx_to_supermode[k_idxs[2]] = supermodes1;
+    std::reverse(supermodes1.begin(), supermodes1.end());
+
+    const auto expect_partners = [&]() {
+        for (int e_idx = 0; e_idx < static_cast<int>(supermodes1.size()); ++e_idx) {
+            const auto irrep_idx = supermodes1[e_idx].superirrep_idx;
+            EXPECT_EQ(superband.k_idx_to_e_idx_to_supermode[k_idxs[1]][e_idx].superirrep_idx,
+                      identity[irrep_idx]);
+            EXPECT_EQ(superband.k_idx_to_e_idx_to_supermode[k_idxs[2]][e_idx].superirrep_idx,
+                      rotation[irrep_idx]);
+        }
+        EXPECT_TRUE(superband.satisfies_antiunit_rels());
+    };
+    superband.fix_antiunit_rels();
+    expect_partners();
+
+    std::swap(supermodes1.front(), supermodes1.back());
+    superband.fix_antiunit_rels(k1_idx, 0, static_cast<int>(supermodes1.size()));
+    expect_partners();
+}
+
+}  // namespace magnon::diagnose2
@@ -0,0 +1,61 @@
+#include "diagnose2/subband_fingerprints.hpp"
+
+#include <algorithm>
+#include <utility>
+
+namespace magnon::diagnose2 {
+
+Vector<int> make_fingerprint(const Subband &subband) {
+    const auto &data = subband.get_data();
+    Vector<int> result;
+    for (const auto &submodes : subband.subk_idx_to_e_idx_to_submode) {
+        result.push_back(static_cast<int>(submodes.size()));
+        for (const auto &submode : submodes) {
+            result.push_back(submode.subirrep_idx);
+        }
+    }
+    for (const auto &[gaps, spans, _] : subband.gaps_allspanstopermute_done_tuples) {
+        result.push_back(gaps.back());
+        result.push_back(static_cast<int>(spans.size()));
+        for (const auto &span : spans) {
+            const int subk_idx = data.sub_msg.irrepidx_to_kidx[span.front().subirrep_idx];
+            result.push_back(subk_idx);
+            const auto &submodes = subband.subk_idx_to_e_idx_to_submode[subk_idx];
+            result.push_back(static_cast<int>(span.data() - submodes.data()));
+            result.push_back(static_cast<int>(span.size()));
+        }
+    }
+    return result;
+}
+
+std::size_t SubbandFingerprints::Hash::operator()(const Vector<int> &fingerprint) const {
+    std::uint64_t result = 0;
+    for (const auto element : fingerprint) {
+        result = (result ^ static_cast<std::uint32_t>(element)) * 0x9e3779b97f4a7c15;
+        result ^= result >> 29;
+    }
+    return result;
+}
+
+bool SubbandFingerprints::contains(const Vector<int> &fingerprint, const long chunk_idx) const {
+    const std::lock_guard lock(mutex);
+    const auto it = fingerprint_to_chunk_idx.find(fingerprint);
+    return it != fingerprint_to_chunk_idx.end() && it->second <= chunk_idx;
+}
+
+void SubbandFingerprints::insert(Vector<int> fingerprint, const long chunk_idx) {
+    const std::lock_guard lock(mutex);
+    if (const auto it = fingerprint_to_chunk_idx.find(fingerprint);
+        it != fingerprint_to_chunk_idx.end()) {
+        it->second = std::min(it->second, chunk_idx);
+    } else if (fingerprint_to_chunk_idx.size() < capacity) {
+        fingerprint_to_chunk_idx.emplace(std::move(fingerprint), chunk_idx);
+    }
+}
+
+std::size_t SubbandFingerprints::size() const {
+    const std::lock_guard lock(mutex);
+    return fingerprint_to_chunk_idx.size();
+}
+
+}  // namespace magnon::diagnose2
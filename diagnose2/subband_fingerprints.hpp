@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <unordered_map>
+
+#include "diagnose2/spectrum_data.hpp"
+
+namespace magnon::diagnose2 {
+
+// What the energetics models of a subband depend on: the subgroup irreps of the submodes at each
+// subgroup k-point in energy order, and the gaps and span positions of its gap brackets. Superband
+// orderings whose subbands have equal fingerprints have the same models. Taken before the
+// energetics of the subband are enumerated, when its spans are sorted.
+Vector<int> make_fingerprint(const Subband &subband);
+
+// The fingerprints of the subbands enumerated so far, shared between the threads enumerating the
+// chunks of a search, each with the first chunk in enumeration order it was enumerated in. Holds
+// at most `capacity` fingerprints; once full, no more are added.
+class SubbandFingerprints {
+ public:
+    explicit SubbandFingerprints(std::size_t capacity) : capacity{capacity} {}
+
+    // Whether a subband with `fingerprint` was enumerated in chunk `chunk_idx` or an earlier one,
+    // whose models come first in the serial enumeration.
+    bool contains(const Vector<int> &fingerprint, long chunk_idx) const;
+    void insert(Vector<int> fingerprint, long chunk_idx);
+
+    std::size_t size() const;
+
+ private:
+    struct Hash {
+        std::size_t operator()(const Vector<int> &fingerprint) const;
+    };
+
+    std::size_t capacity;
+    mutable std::mutex mutex;
+    std::unordered_map<Vector<int>, long, Hash> fingerprint_to_chunk_idx;
+};
+
+}  // namespace magnon::diagnose2
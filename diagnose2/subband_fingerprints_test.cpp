@@ -0,0 +1,63 @@
+#include "diagnose2/subband_fingerprints.hpp"
+
+#include <set>
+#include <vector>
+
+#include "diagnose2/test_structures.hpp"
+#include "gtest/gtest.h"
+
+namespace magnon::diagnose2 {
+
+TEST(SubbandFingerprintsTest, RebasedSubbandsMatchFreshOnes) {
+    const auto structure = make_copies(read_structure(), 3);
+    const SpectrumData data(structure);
+
+    for (const auto order : {EnergeticsOrder::Lexicographic, EnergeticsOrder::Transpositions}) {
+        Superband superband(positive_energy_irreps(structure), data);
+        superband.set_energetics_order(order);
+
+        Subband subband = superband.make_subband();
+        std::set<Vector<int>> fingerprints;
+        int num_orderings = 0;
+        do {
+            if (num_orderings > 0) {
+                subband.rebase(superband, superband.last_changed_k_idx());
+            }
+            const auto fingerprint = make_fingerprint(subband);
+            ASSERT_EQ(fingerprint, make_fingerprint(superband.make_subband()));
+            fingerprints.insert(fingerprint);
+            ++num_orderings;
+            // Enumerating the energetics leaves the spans sorted again.
+            while (subband.next_energetics()) {
+            }
+            ASSERT_EQ(make_fingerprint(subband), fingerprint);
+        } while (superband.cartesian_permute());
+
+        // The orderings only move submodes within spans, which start out sorted, so they all share
+        // a subband.
+        EXPECT_GT(num_orderings, 1);
+        EXPECT_EQ(fingerprints.size(), 1);
+    }
+}
+
+TEST(SubbandFingerprintsTest, FindsFingerprintsOfSameOrEarlierChunks) {
+    SubbandFingerprints fingerprints(2);
+    fingerprints.insert({1, 2, 3}, 5);
+    EXPECT_FALSE(fingerprints.contains({1, 2, 3}, 4));
+    EXPECT_TRUE(fingerprints.contains({1, 2, 3}, 5));
+    EXPECT_TRUE(fingerprints.contains({1, 2, 3}, 6));
+    EXPECT_FALSE(fingerprints.contains({1, 2}, 6));
+
+    // The earliest chunk is kept.
+    fingerprints.insert({1, 2, 3}, 2);
+    fingerprints.insert({1, 2, 3}, 7);
+    EXPECT_TRUE(fingerprints.contains({1, 2, 3}, 2));
+
+    // Once full, no more fingerprints are added.
+    fingerprints.insert({4}, 0);
+    fingerprints.insert({5}, 0);
+    EXPECT_EQ(fingerprints.size(), 2);
+    EXPECT_FALSE(fingerprints.contains({5}, 0));
+}
+
+}  // namespace magnon::diagnose2
@@ -0,0 +1,87 @@
+// Measures the cost of rebuilding the supermodes at antiunitarily mirrored k-points, which
+// `Superband::fix_antiunit_rels()` does after every `Superband::cartesian_permute()` step.
+//
+// Usage: supermode_benchmark [processed_tables.txtpb]
+
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "fmt/core.h"
+
+#include "diagnose2/spectrum_data.hpp"
+#include "utils/proto_text_format.hpp"
+
+namespace {
+
+constexpr const char *DEFAULT_PROCESSED_TABLES_PATH =
+    "diagnose2/test_data/processed_tables_205_33_4a_2_4.txtpb";
+constexpr int NUM_REPETITIONS = 100000;
+
+using magnon::diagnose2::Bag;
+using magnon::diagnose2::SpectrumData;
+using magnon::diagnose2::Superband;
+using magnon::diagnose2::Supermode;
+
+// Time `step` and return the average nanoseconds per call.
+double time_ns_per_call(const auto &step) {
+    const auto start_time = std::chrono::steady_clock::now();
+    for (int i = 0; i < NUM_REPETITIONS; ++i) {
+        step();
+    }
+    const std::chrono::duration<double, std::nano> elapsed =
+        std::chrono::steady_clock::now() - start_time;
+    return elapsed.count() / NUM_REPETITIONS;
+}
+
+}  // namespace
+
+int main(int argc, const char **argv) {
+    const std::string path = argc > 1 ? argv[1] : DEFAULT_PROCESSED_TABLES_PATH;
+    magnon::diagnose2::PerturbedBandStructure structure{};
+    magnon::utils::proto::read_from_text_file(path, structure);
+    const SpectrumData data(structure);
+
+    std::vector<int> superirrep_idxs;
+    for (const auto &irrep : structure.unperturbed_band_structure().supergroup_little_irrep()) {
+        superirrep_idxs.push_back(data.super_msg.irrep_to_idx(irrep.label()));
+    }
+
+    // Before: look the irrep up by label, build its bag and search for it among the unique bags.
+    std::vector<Supermode> supermodes;
+    const double by_label_ns = time_ns_per_call([&]() {
+        supermodes.clear();
+        for (const auto superirrep_idx : superirrep_idxs) {
+            const auto &superirrep = data.super_msg.irreps[superirrep_idx];
+            auto &supermode = supermodes.emplace_back(superirrep, data);
+            supermode.bag_idx = data.superirrep_to_all_subirreps.contains(superirrep)
+                                    ? data.bag_to_idx(Bag(superirrep, data))
+                                    : static_cast<int>(Bag::invalid_idx);
+        }
+    });
+
+    // After: two array loads per supermode.
+    const double by_index_ns = time_ns_per_call([&]() {
+        supermodes.clear();
+        for (const auto superirrep_idx : superirrep_idxs) {
+            supermodes.emplace_back(superirrep_idx, data);
+        }
+    });
+
+    std::vector<std::string> superirreps;
+    for (const auto &irrep : structure.unperturbed_band_structure().supergroup_little_irrep()) {
+        superirreps.push_back(irrep.label());
+    }
+    Superband superband(superirreps, data);
+    const double fix_antiunit_rels_ns =
+        time_ns_per_call([&superband]() { superband.fix_antiunit_rels(); });
+
+    std::cout << fmt::format("{} supermodes, {} antiunitarily related k-point pairs\n",
+                             superirrep_idxs.size(),
+                             data.super_msg.k1idx_k2idx_irrep1idxtoirrep2idx_tuples.size());
+    std::cout << fmt::format("{:<32}{:10.1f} ns/step\n", "Supermodes by label:", by_label_ns);
+    std::cout << fmt::format("{:<32}{:10.1f} ns/step\n", "Supermodes by index:", by_index_ns);
+    std::cout << fmt::format(
+        "{:<32}{:10.1f} ns/step\n", "Superband::fix_antiunit_rels():", fix_antiunit_rels_ns);
+}
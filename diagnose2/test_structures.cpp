@@ -0,0 +1,71 @@
+#include "diagnose2/test_structures.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+
+#include "utils/proto_text_format.hpp"
+
+namespace magnon::diagnose2 {
+
+namespace {
+
+constexpr const char *PROCESSED_TABLES_PATH =
+    "diagnose2/test_data/processed_tables_205_33_4a_2_4.txtpb";
+
+}  // namespace
+
+PerturbedBandStructure read_structure() {
+    PerturbedBandStructure structure{};
+    if (!magnon::utils::proto::read_from_text_file(PROCESSED_TABLES_PATH, structure)) {
+        throw std::runtime_error("Cannot read the test structure");
+    }
+    return structure;
+}
+
+PerturbedBandStructure make_copies(PerturbedBandStructure structure, const int num_copies) {
+    auto &band_structure = *structure.mutable_unperturbed_band_structure();
+    const auto irreps = band_structure.supergroup_little_irrep();
+    for (int i = 1; i < num_copies; ++i) {
+        for (const auto &irrep : irreps) {
+            *band_structure.add_supergroup_little_irrep() = irrep;
+        }
+    }
+    return structure;
+}
+
+PerturbedBandStructure with_supermodes(PerturbedBandStructure structure,
+                                       const std::vector<std::string> &labels) {
+    auto &band_structure = *structure.mutable_unperturbed_band_structure();
+    band_structure.clear_supergroup_little_irrep();
+    for (const auto &label : labels) {
+        const auto &irreps = structure.supergroup().little_irrep();
+        const auto irrep = std::find_if(irreps.begin(), irreps.end(), [&](const auto &irrep) {
+            return irrep.label() == label;
+        });
+        if (irrep == irreps.end()) {
+            throw std::runtime_error("Unknown supergroup irrep " + label);
+        }
+        auto &supermode = *band_structure.add_supergroup_little_irrep();
+        supermode.set_label(label);
+        supermode.set_dimension(irrep->dimension());
+    }
+    return structure;
+}
+
+PerturbedBandStructure with_trivial_sis(PerturbedBandStructure structure) {
+    auto &si_matrix = *structure.mutable_subgroup()->mutable_symmetry_indicator_matrix();
+    for (int i = 0; i < si_matrix.entry_size(); ++i) {
+        si_matrix.set_entry(i, 0);
+    }
+    return structure;
+}
+
+std::vector<std::string> positive_energy_irreps(const PerturbedBandStructure &structure) {
+    std::vector<std::string> result;
+    for (const auto &irrep : structure.unperturbed_band_structure().supergroup_little_irrep()) {
+        result.push_back(irrep.label());
+    }
+    return result;
+}
+
+}  // namespace magnon::diagnose2
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "diagnose2/perturbed_band_structure.pb.h"
+
+namespace magnon::diagnose2 {
+
+// Structures for tests and benchmarks, derived from the one in `diagnose2/test_data`.
+
+// The processed tables of the perturbation 205.33 -> 2.4 in `diagnose2/test_data`.
+PerturbedBandStructure read_structure();
+
+// `structure` with its supermodes repeated, `num_copies` times in all.
+PerturbedBandStructure make_copies(PerturbedBandStructure structure, int num_copies);
+
+// `structure` with the supermodes of the supergroup irreps `labels`, in this order.
+PerturbedBandStructure with_supermodes(PerturbedBandStructure structure,
+                                       const std::vector<std::string> &labels);
+
+// `structure` with all the SIs of its subgroup trivial, which excludes the perturbation.
+PerturbedBandStructure with_trivial_sis(PerturbedBandStructure structure);
+
+// Labels of the supergroup irreps of the supermodes of `structure`, as `Superband` takes them.
+std::vector<std::string> positive_energy_irreps(const PerturbedBandStructure &structure);
+
+}  // namespace magnon::diagnose2
@@ -0,0 +1,121 @@
+#include "diagnose2/transposition_walk.hpp"
+
+namespace magnon::diagnose2 {
+
+namespace {
+
+// The orderings of s zeros and t ones are listed by two sequences of bit strings, each of which
+// changes by one transposition per step:
+//
+//   X(s, t) = 1 reverse(X(s, t - 1)), 0 Y(s - 1, t)    from 1 0^s 1^(t-1) to 0^s 1^t,
+//   Y(s, t) = 1 X(s, t - 1),          0 X(s - 1, t)    from 1^t 0^s to 0^s 1^t,
+//
+// with the single string 1^t 0^s if s or t is 0. Joining the two halves swaps the first bit with
+// the second one, or with the third one in X if t > 1, which then is a one. So a swap two positions
+// apart has a copy of one of the swapped bits in between.
+
+void append_y(int s, int t, int offset, bool is_reversed, Vector<std::pair<int, int>> &result);
+
+// Append the transpositions walking X(s, t) at `offset`, or walking it backward.
+void append_x(const int s,
+              const int t,
+              const int offset,
+              const bool is_reversed,
+              Vector<std::pair<int, int>> &result) {
+    if (s == 0 || t == 0) {
+        return;
+    }
+    const std::pair join{offset, offset + (t == 1 ? 1 : 2)};
+    if (is_reversed) {
+        append_y(s - 1, t, offset + 1, true, result);
+        result.push_back(join);
+        append_x(s, t - 1, offset + 1, false, result);
+    } else {
+        append_x(s, t - 1, offset + 1, true, result);
+        result.push_back(join);
+        append_y(s - 1, t, offset + 1, false, result);
+    }
+}
+
+// Append the transpositions walking Y(s, t) at `offset`, or walking it backward.
+void append_y(const int s,
+              const int t,
+              const int offset,
+              const bool is_reversed,
+              Vector<std::pair<int, int>> &result) {
+    if (s == 0 || t == 0) {
+        return;
+    }
+    const std::pair join{offset, offset + 1};
+    if (is_reversed) {
+        append_x(s - 1, t, offset + 1, true, result);
+        result.push_back(join);
+        append_x(s, t - 1, offset + 1, true, result);
+    } else {
+        append_x(s, t - 1, offset + 1, false, result);
+        result.push_back(join);
+        append_x(s - 1, t, offset + 1, false, result);
+    }
+}
+
+// Number of distinct orderings of a multiset with `counts[v]` copies of each element v:
+// n! / (counts[0]! counts[1]! ...).
+double num_distinct_orderings(const Vector<int> &counts) {
+    double result = 1.0;
+    int num_placed = 0;
+    for (const auto count : counts) {
+        for (int multiplicity = 1; multiplicity <= count; ++multiplicity) {
+            result = result * (++num_placed) / multiplicity;
+        }
+    }
+    return result;
+}
+
+}  // namespace
+
+Vector<std::pair<int, int>> make_transposition_walk(const Vector<int> &counts) {
+    // The elements are added a value at a time, the largest last, as the ones of the bit strings
+    // and the elements added before as the zeros. The bit strings walk backward through X, from
+    // 0^s 1^t to 1 0^s 1^(t-1), and forward again, between the consecutive orderings of the
+    // elements added before, in which the zeros are contiguous.
+    Vector<std::pair<int, int>> result;
+    int size = 0;
+    for (const auto count : counts) {
+        if (size == 0) {
+            size = count;
+            continue;
+        }
+
+        Vector<std::pair<int, int>> placements;
+        append_x(size, count, 0, true, placements);
+        const auto others = std::move(result);
+        result.clear();
+        for (std::size_t i = 0; i <= others.size(); ++i) {
+            if (i % 2 == 0) {
+                result.insert(result.end(), placements.begin(), placements.end());
+            } else {
+                result.insert(result.end(), placements.rbegin(), placements.rend());
+            }
+            if (i < others.size()) {
+                // The zeros are at 1, ..., s after a forward walk, and at 0, ..., s - 1 after a
+                // backward one.
+                const int shift = i % 2 == 0 ? 1 : 0;
+                result.emplace_back(others[i].first + shift, others[i].second + shift);
+            }
+        }
+        size += count;
+    }
+    return result;
+}
+
+std::shared_ptr<const Vector<std::pair<int, int>>> TranspositionWalks::get(
+    const Vector<int> &counts) {
+    const auto [it, is_new] = counts_to_walk.try_emplace(counts);
+    if (is_new && num_distinct_orderings(counts) <= MAX_NUM_STEPS) {
+        it->second =
+            std::make_shared<const Vector<std::pair<int, int>>>(make_transposition_walk(counts));
+    }
+    return it->second;
+}
+
+}  // namespace magnon::diagnose2
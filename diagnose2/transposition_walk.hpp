@@ -0,0 +1,113 @@
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <iterator>
+#include <map>
+#include <memory>
+#include <utility>
+
+#include "diagnose2/utility.hpp"
+
+namespace magnon::diagnose2 {
+
+// Transpositions (i, j), i < j, that walk the sorted ordering of a multiset with `counts[v]` copies
+// of its v-th smallest element through all its distinct orderings, once each. No transposition
+// swaps elements more than two positions apart. Adjacent transpositions alone cannot do this for
+// most multisets; {0, 0, 1, 1} already has no such walk.
+Vector<std::pair<int, int>> make_transposition_walk(const Vector<int> &counts);
+
+// Position of a range in its walk through the distinct orderings of its elements, forward from the
+// sorted ordering to the end of the walk, and back once reversed.
+struct WalkPosition {
+    // Transpositions of the walk, or null for ranges with more than
+    // `TranspositionWalks::MAX_NUM_STEPS` orderings. These step with `std::next_permutation()`
+    // forward and `std::prev_permutation()` backward instead.
+    std::shared_ptr<const Vector<std::pair<int, int>>> transpositions;
+    long step = 0;
+    bool is_reversed = false;
+
+    long num_steps() const { return transpositions == nullptr ? 0 : transpositions->size(); }
+
+    // Move `range`, which must be at this position, one step along the walk, and return the
+    // positions it reordered as a half-open interval. At the end of the walk, return an empty
+    // interval and leave `range` as it is.
+    template <typename Range>
+    std::pair<int, int> advance(Range &&range);
+
+    // Move `range`, which must be at this position, to the end of the forward walk.
+    template <typename Range>
+    void move_to_end(Range &&range);
+};
+
+// Transposition walks by the multiplicities of the walked elements, made on first use.
+class TranspositionWalks {
+ public:
+    static constexpr double MAX_NUM_STEPS = 1 << 16;
+
+    // Start of the walk of the sorted `range`
+    template <typename Range>
+    WalkPosition start(const Range &range);
+
+ private:
+    std::shared_ptr<const Vector<std::pair<int, int>>> get(const Vector<int> &counts);
+
+    std::map<Vector<int>, std::shared_ptr<const Vector<std::pair<int, int>>>> counts_to_walk;
+};
+
+template <typename Range>
+std::pair<int, int> WalkPosition::advance(Range &&range) {
+    const auto first = std::begin(range);
+    const auto last = std::end(range);
+    if (transpositions == nullptr) {
+        const auto is_at_end = is_reversed
+                                   ? std::is_sorted(first, last)
+                                   : std::is_sorted(std::make_reverse_iterator(last),
+                                                    std::make_reverse_iterator(first));
+        if (is_at_end) {
+            return {0, 0};
+        }
+        if (is_reversed) {
+            std::prev_permutation(first, last);
+        } else {
+            std::next_permutation(first, last);
+        }
+        return {0, static_cast<int>(std::distance(first, last))};
+    }
+
+    if (is_reversed ? step == 0 : step == num_steps()) {
+        return {0, 0};
+    }
+    const auto [i, j] = (*transpositions)[is_reversed ? --step : step++];
+    std::iter_swap(std::next(first, i), std::next(first, j));
+    return {i, j + 1};
+}
+
+template <typename Range>
+void WalkPosition::move_to_end(Range &&range) {
+    const auto first = std::begin(range);
+    const auto last = std::end(range);
+    if (transpositions == nullptr) {
+        std::sort(std::make_reverse_iterator(last), std::make_reverse_iterator(first));
+        return;
+    }
+    for (; step < num_steps(); ++step) {
+        const auto [i, j] = (*transpositions)[step];
+        std::iter_swap(std::next(first, i), std::next(first, j));
+    }
+}
+
+template <typename Range>
+WalkPosition TranspositionWalks::start(const Range &range) {
+    assert(std::is_sorted(std::begin(range), std::end(range)));
+    Vector<int> counts;
+    for (auto it = std::begin(range); it != std::end(range); ++it) {
+        if (it == std::begin(range) || *std::prev(it) < *it) {
+            counts.push_back(0);
+        }
+        ++counts.back();
+    }
+    return WalkPosition{.transpositions = get(counts)};
+}
+
+}  // namespace magnon::diagnose2
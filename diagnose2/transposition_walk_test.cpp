@@ -0,0 +1,92 @@
+#include "diagnose2/transposition_walk.hpp"
+
+#include <algorithm>
+#include <iterator>
+#include <set>
+#include <utility>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+namespace magnon::diagnose2 {
+
+// Sorted multiset with `counts[v]` copies of each element v
+std::vector<int> make_multiset(const Vector<int> &counts) {
+    std::vector<int> result;
+    for (int value = 0; value < static_cast<int>(counts.size()); ++value) {
+        result.insert(result.end(), counts[value], value);
+    }
+    return result;
+}
+
+TEST(MakeTranspositionWalkTest, VisitsEveryOrderingOnce) {
+    const std::vector<Vector<int>> counts_list{
+        {1}, {4}, {1, 1}, {2, 2}, {1, 3}, {3, 1}, {1, 1, 1}, {2, 1, 2}, {1, 2, 3}, {3, 3, 2},
+        {1, 1, 1, 1}, {2, 2, 2, 2}, {1, 3, 1, 2}, {1, 1, 1, 1, 1, 1, 1}, {5, 4}};
+    for (const auto &counts : counts_list) {
+        auto multiset = make_multiset(counts);
+        std::set<std::vector<int>> orderings{multiset};
+        for (const auto &[i, j] : make_transposition_walk(counts)) {
+            ASSERT_LT(i, j);
+            ASSERT_LE(j - i, 2);
+            ASSERT_NE(multiset[i], multiset[j]);
+            std::swap(multiset[i], multiset[j]);
+            ASSERT_TRUE(orderings.insert(multiset).second);
+        }
+
+        auto expected = make_multiset(counts);
+        long num_orderings = 0;
+        do {
+            ++num_orderings;
+        } while (std::next_permutation(expected.begin(), expected.end()));
+        EXPECT_EQ(static_cast<long>(orderings.size()), num_orderings);
+    }
+}
+
+TEST(WalkPositionTest, WalksForwardAndBack) {
+    TranspositionWalks walks;
+    // 30 orderings, and 9! / 2 = 181440, too many for a transposition walk
+    const std::vector<std::pair<Vector<int>, bool>> counts_islong_pairs{
+        {{2, 1, 2}, false}, {{1, 1, 1, 1, 1, 1, 1, 2}, true}};
+    for (const auto &[counts, is_long] : counts_islong_pairs) {
+        auto multiset = make_multiset(counts);
+        auto position = walks.start(multiset);
+        EXPECT_EQ(position.transpositions == nullptr, is_long);
+
+        std::vector<std::vector<int>> orderings{multiset};
+        while (true) {
+            const auto [first, last] = position.advance(multiset);
+            if (first == last) {
+                break;
+            }
+            orderings.push_back(multiset);
+            if (position.transpositions != nullptr) {
+                ASSERT_LE(last - first, 3);
+            }
+        }
+
+        auto end = make_multiset(counts);
+        walks.start(end).move_to_end(end);
+        EXPECT_EQ(multiset, end);
+
+        position.is_reversed = true;
+        for (auto it = std::next(orderings.rbegin()); it != orderings.rend(); ++it) {
+            const auto [first, last] = position.advance(multiset);
+            ASSERT_LT(first, last);
+            ASSERT_EQ(multiset, *it);
+        }
+        const auto [first, last] = position.advance(multiset);
+        EXPECT_EQ(first, last);
+    }
+}
+
+TEST(TranspositionWalksTest, SharesWalksOfEqualMultiplicities) {
+    TranspositionWalks walks;
+    const std::vector<int> lhs{1, 1, 3, 4, 4};
+    const std::vector<int> rhs{0, 0, 5, 7, 7};
+    EXPECT_EQ(walks.start(lhs).transpositions, walks.start(rhs).transpositions);
+    const std::vector<int> other{1, 3, 4, 4, 4};
+    EXPECT_NE(walks.start(lhs).transpositions, walks.start(other).transpositions);
+}
+
+}  // namespace magnon::diagnose2
@@ -0,0 +1,112 @@
+#include "diagnose2/witness.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace magnon::diagnose2 {
+
+SearchResult::Witness make_witness(
+    const Superband &superband,
+    const std::vector<std::vector<int>> &subk_idx_to_e_idx_to_subirrep_idx,
+    const int num_nontrivial_gaps) {
+    SearchResult::Witness result{};
+    result.set_num_nontrivial_gaps(num_nontrivial_gaps);
+    for (const auto &supermodes : superband.k_idx_to_e_idx_to_supermode) {
+        auto &super_k_point = *result.add_super_k_point();
+        for (const auto &supermode : supermodes) {
+            super_k_point.add_irrep_idx(supermode.superirrep_idx);
+        }
+    }
+    for (const auto &subirrep_idxs : subk_idx_to_e_idx_to_subirrep_idx) {
+        auto &sub_k_point = *result.add_sub_k_point();
+        for (const auto subirrep_idx : subirrep_idxs) {
+            sub_k_point.add_irrep_idx(subirrep_idx);
+        }
+    }
+    return result;
+}
+
+SearchResult::Witness make_witness(const Superband &superband,
+                                   const Subband &subband,
+                                   const int num_nontrivial_gaps) {
+    std::vector<std::vector<int>> subk_idx_to_e_idx_to_subirrep_idx;
+    for (const auto &submodes : subband.subk_idx_to_e_idx_to_submode) {
+        auto &subirrep_idxs = subk_idx_to_e_idx_to_subirrep_idx.emplace_back();
+        for (const auto &submode : submodes) {
+            subirrep_idxs.push_back(submode.subirrep_idx);
+        }
+    }
+    return make_witness(superband, subk_idx_to_e_idx_to_subirrep_idx, num_nontrivial_gaps);
+}
+
+bool is_reordering(const google::protobuf::RepeatedField<std::int32_t> &idxs,
+                   std::vector<int> expected_idxs) {
+    std::vector<int> sorted_idxs(idxs.begin(), idxs.end());
+    std::sort(sorted_idxs.begin(), sorted_idxs.end());
+    std::sort(expected_idxs.begin(), expected_idxs.end());
+    return sorted_idxs == expected_idxs;
+}
+
+std::unique_ptr<const WitnessModel> replay_witness(const SearchResult::Witness &witness,
+                                                   const SpectrumData &data) {
+    std::vector<std::string> superirreps;
+    for (const auto &super_k_point : witness.super_k_point()) {
+        for (const auto superirrep_idx : super_k_point.irrep_idx()) {
+            if (superirrep_idx < 0 ||
+                superirrep_idx >= static_cast<int>(data.super_msg.irreps.size())) {
+                throw std::invalid_argument("Witness holds an unknown supergroup irrep");
+            }
+            superirreps.push_back(data.super_msg.irreps[superirrep_idx]);
+        }
+    }
+
+    Superband superband(superirreps, data);
+    auto &k_idx_to_e_idx_to_supermode = superband.k_idx_to_e_idx_to_supermode;
+    if (witness.super_k_point_size() != static_cast<int>(k_idx_to_e_idx_to_supermode.size())) {
+        throw std::invalid_argument("Witness does not match the supergroup k-points");
+    }
+    for (int k_idx = 0; k_idx < witness.super_k_point_size(); ++k_idx) {
+        auto &supermodes = k_idx_to_e_idx_to_supermode[k_idx];
+        const auto &idxs = witness.super_k_point(k_idx).irrep_idx();
+        std::vector<int> expected_idxs;
+        for (const auto &supermode : supermodes) {
+            expected_idxs.push_back(supermode.superirrep_idx);
+        }
+        if (!is_reordering(idxs, std::move(expected_idxs))) {
+            throw std::invalid_argument("Witness does not match the supermodes");
+        }
+        for (int e_idx = 0; e_idx < idxs.size(); ++e_idx) {
+            supermodes[e_idx] = Supermode(idxs[e_idx], data);
+        }
+    }
+    if (!superband.satisfies_antiunit_rels()) {
+        throw std::invalid_argument("Witness holds an invalid superband ordering");
+    }
+
+    // Built in place, as the gap brackets of the subband hold spans into its submodes.
+    std::unique_ptr<WitnessModel> result(new WitnessModel{superband, superband.make_subband()});
+    auto &subk_idx_to_e_idx_to_submode = result->subband.subk_idx_to_e_idx_to_submode;
+    if (witness.sub_k_point_size() != static_cast<int>(subk_idx_to_e_idx_to_submode.size())) {
+        throw std::invalid_argument("Witness does not match the subgroup k-points");
+    }
+    for (int subk_idx = 0; subk_idx < witness.sub_k_point_size(); ++subk_idx) {
+        auto &submodes = subk_idx_to_e_idx_to_submode[subk_idx];
+        const auto &idxs = witness.sub_k_point(subk_idx).irrep_idx();
+        std::vector<int> expected_idxs;
+        for (const auto &submode : submodes) {
+            expected_idxs.push_back(submode.subirrep_idx);
+        }
+        if (!is_reordering(idxs, std::move(expected_idxs))) {
+            throw std::invalid_argument("Witness does not match the submodes");
+        }
+        std::copy(idxs.begin(), idxs.end(), submodes.begin());
+    }
+    if (!result->subband.satisfies_antiunit_rels()) {
+        throw std::invalid_argument("Witness holds an invalid energetics model");
+    }
+    return result;
+}
+
+}  // namespace magnon::diagnose2
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "diagnose2/search_result.pb.h"
+#include "diagnose2/spectrum_data.hpp"
+
+namespace magnon::diagnose2 {
+
+// The energetics model a witness records.
+struct WitnessModel {
+    Superband superband;
+    Subband subband;
+};
+
+// The witness of the model with the supermodes of `superband` and the subgroup irrep indices
+// `subk_idx_to_e_idx_to_subirrep_idx`, which has `num_nontrivial_gaps` nontrivial gaps.
+SearchResult::Witness make_witness(
+    const Superband &superband,
+    const std::vector<std::vector<int>> &subk_idx_to_e_idx_to_subirrep_idx,
+    int num_nontrivial_gaps);
+// Same with the submodes of `subband`
+SearchResult::Witness make_witness(const Superband &superband,
+                                   const Subband &subband,
+                                   int num_nontrivial_gaps);
+
+// Whether `idxs` holds the same irrep indices as `expected_idxs`, in any order.
+bool is_reordering(const google::protobuf::RepeatedField<std::int32_t> &idxs,
+                   std::vector<int> expected_idxs);
+
+// Rebuild the model `witness` records on `data`, the spectrum data of the searched structure.
+// Throw `std::invalid_argument` if the witness does not fit the structure.
+std::unique_ptr<const WitnessModel> replay_witness(const SearchResult::Witness &witness,
+                                                   const SpectrumData &data);
+
+}  // namespace magnon::diagnose2
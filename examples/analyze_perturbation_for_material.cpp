@@ -1,5 +1,10 @@
+#include <cstdlib>
 #include <fstream>
+#include <iostream>
+#include <optional>
+#include <vector>
 
+#include "boost/program_options.hpp"
 #include "fmt/color.h"
 #include "fmt/core.h"
 
@@ -12,12 +17,22 @@ constexpr double TIMEOUT_S = 1.0e+10;
 constexpr const char *PROCESSED_TABLES_PATH = "/tmp/intermediate_result_1.txtpb";
 constexpr const char *OUTPUT_PATH = "/tmp/intermediate_result_2.txtpb";
 
-int main() {
+struct Args {
+    Args(const int argc, const char *const argv[]);
+
+    int num_jobs{};
+    std::string cache_dir{};
+};
+
+int main(const int argc, const char *const argv[]) {
+    const Args args{argc, argv};
     magnon::diagnose2::PerturbedBandStructures structures{};
     magnon::utils::proto::read_from_text_file(PROCESSED_TABLES_PATH, structures);
 
     std::ofstream out(OUTPUT_PATH);
-    for (const auto &structure : structures.structure()) {
+    const auto write_result = [&](const std::size_t idx,
+                                  const magnon::diagnose2::SearchResult &result) {
+        const auto &structure = structures.structure(idx);
         std::string wp_labels{};
         for (const auto &atomic_orbital : structure.unperturbed_band_structure().atomic_orbital()) {
             wp_labels = wp_labels + "+" + atomic_orbital.wyckoff_position().label();
@@ -28,7 +43,6 @@ int main() {
                                  wp_labels,
                                  structure.subgroup().label(),
                                  structure.subgroup().number());
-        const auto result = magnon::diagnose2::analyze_perturbation(structure, TIMEOUT_S);
         if (result.is_timeout()) {
             std::cerr << fmt::format(fmt::bg(fmt::color::blue), "Timeout!") << '\n';
         } else if (result.is_negative_diagnosis()) {
@@ -42,5 +56,43 @@ int main() {
         std::string output;
         assert(google::protobuf::TextFormat::PrintToString(results, &output));
         out << output << std::endl;
+    };
+    const std::vector<magnon::diagnose2::PerturbedBandStructure> structure_list(
+        structures.structure().begin(), structures.structure().end());
+    std::optional<magnon::diagnose2::SearchCache> cache;
+    if (!args.cache_dir.empty()) {
+        cache.emplace(args.cache_dir);
+    }
+    magnon::diagnose2::analyze_perturbations(
+        structure_list,
+        {.num_jobs = args.num_jobs,
+         .search_options = {.timeout_s = TIMEOUT_S, .cache = cache ? &*cache : nullptr},
+         .on_result = write_result});
+}
+
+Args::Args(const int argc, const char *const argv[]) {
+    namespace po = boost::program_options;
+
+    po::options_description desc{};
+    // clang-format off
+    desc.add_options()
+        ("help", "Print help message.")
+        ("jobs", po::value(&num_jobs)->default_value(1),
+         "Number of perturbations searched at once")
+        ("cache_dir", po::value(&cache_dir),
+         "Directory of the search result cache, shared by concurrent processes");
+    // clang-format on
+
+    try {
+        po::variables_map vm{};
+        po::store(po::parse_command_line(argc, argv, desc), vm);
+        if (vm.count("help")) {
+            std::cout << desc;
+            std::exit(EXIT_SUCCESS);
+        }
+        po::notify(vm);
+    } catch (const po::error &e) {
+        std::cerr << "Error: " << e.what() << '\n';
+        std::exit(EXIT_SUCCESS);
     }
 }
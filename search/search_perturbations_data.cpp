@@ -1,5 +1,17 @@
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <condition_variable>
 #include <cstdlib>
 #include <fstream>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <stop_token>
+#include <thread>
+#include <vector>
 
 #include "boost/program_options.hpp"
 #include "fmt/color.h"
@@ -7,39 +19,89 @@
 
 #include "diagnose2/analyze_perturbation.hpp"
 #include "diagnose2/search_result.pb.h"
+#include "diagnose2/search_space.hpp"
 #include "formula/replace_formulas.hpp"
 #include "google/protobuf/text_format.h"
+#include "search/work_queue.hpp"
 #include "utils/proto_text_format.hpp"
 
+const std::map<std::string, magnon::diagnose2::OrderingStrategy> NAME_TO_ORDERING_STRATEGY = {
+    {"lexicographic", magnon::diagnose2::OrderingStrategy::Lexicographic},
+    {"impact_first", magnon::diagnose2::OrderingStrategy::ImpactFirst},
+    {"impact_first_interleaved", magnon::diagnose2::OrderingStrategy::ImpactFirstInterleaved},
+};
+
 struct Args {
     Args(const int argc, const char *const argv[]);
 
     std::string input_filename{};
     std::string output_filename{};
+    int num_threads{};
+    int num_jobs{};
+    bool estimate_only{};
+    bool diagnosis_only{};
+    long num_prescreen_orderings{};
+    std::string ordering_strategy{};
+
+    std::string shard_mode{};
+    std::string queue_dir{};
+    int unit_size{};
+    int lease_timeout_s{};
+
+    std::string cache_dir{};
 };
 
+void print_estimate(const magnon::diagnose2::SearchSpaceEstimate &estimate) {
+    std::cerr << fmt::format("{:.6g} superband orderings, {}{:.6g} energetics models\n",
+                             estimate.num_superband_orderings,
+                             estimate.is_exact ? "" : "~",
+                             estimate.num_models);
+    for (const auto &[k_idx, num_orderings] : estimate.k_points) {
+        std::cerr << fmt::format("    k-point {}: {:.6g} orderings\n", k_idx, num_orderings);
+    }
+    for (const auto &[gap_begin, gap_end, num_orderings, num_models] : estimate.brackets) {
+        std::cerr << fmt::format("    Gaps {}-{}: {:.6g} models in {} orderings\n",
+                                 gap_begin,
+                                 gap_end,
+                                 num_models,
+                                 num_orderings);
+    }
+    if (!estimate.is_exact) {
+        std::cerr << fmt::format("    Extrapolated from the first {} orderings\n",
+                                 estimate.num_visited_orderings);
+    }
+}
+
+void print_description(const magnon::diagnose2::PerturbedBandStructure &perturbed_structure) {
+    std::string wp_labels{};
+    for (const auto &atomic_orbital :
+         perturbed_structure.unperturbed_band_structure().atomic_orbital()) {
+        wp_labels = wp_labels + "+" + atomic_orbital.wyckoff_position().label();
+    }
+    std::cerr << fmt::format("{} ({}), WPs {} -> {} ({}): ",
+                             perturbed_structure.supergroup().label(),
+                             perturbed_structure.supergroup().number(),
+                             wp_labels,
+                             perturbed_structure.subgroup().label(),
+                             perturbed_structure.subgroup().number());
+}
+
 constexpr double TIMEOUT_S = 1.0e+10;
-int main(const int argc, const char *const argv[]) {
+
+// Search `perturbed_structures`, stopping each search as if it timed out once a stop is requested
+// through `stop_token`.
+magnon::diagnose2::SearchResults search_structures(
+    const magnon::diagnose2::PerturbedBandStructures &perturbed_structures,
+    const Args &args,
+    const std::stop_token stop_token = {}) {
     using namespace magnon;
-    const Args args{argc, argv};
-    diagnose2::PerturbedBandStructures perturbed_structures{};
-    utils::proto::read_from_text_file(args.input_filename, perturbed_structures);
-    diagnose2::SearchResults results{};
 
+    std::vector<diagnose2::PerturbedBandStructure> structures{};
     for (const auto &perturbed_structure : perturbed_structures.structure()) {
-        std::string wp_labels{};
-        for (const auto &atomic_orbital :
-             perturbed_structure.unperturbed_band_structure().atomic_orbital()) {
-            wp_labels = wp_labels + "+" + atomic_orbital.wyckoff_position().label();
-        }
-        std::cerr << fmt::format("{} ({}), WPs {} -> {} ({}): ",
-                                 perturbed_structure.supergroup().label(),
-                                 perturbed_structure.supergroup().number(),
-                                 wp_labels,
-                                 perturbed_structure.subgroup().label(),
-                                 perturbed_structure.subgroup().number());
-        const auto result = diagnose2::analyze_perturbation(
-            formula::maybe_with_alternative_si_formulas(perturbed_structure), TIMEOUT_S);
+        structures.push_back(formula::maybe_with_alternative_si_formulas(perturbed_structure));
+    }
+    const auto print_result = [&](const std::size_t idx, const diagnose2::SearchResult &result) {
+        print_description(perturbed_structures.structure(idx));
         if (result.is_timeout()) {
             std::cerr << fmt::format(fmt::bg(fmt::color::blue), "Timeout!") << '\n';
         } else if (result.is_negative_diagnosis()) {
@@ -47,11 +109,110 @@ int main(const int argc, const char *const argv[]) {
         } else {
             std::cerr << fmt::format(fmt::bg(fmt::color::green), "Positive!!!") << '\n';
         }
+    };
+    std::optional<diagnose2::SearchCache> cache;
+    if (!args.cache_dir.empty()) {
+        cache.emplace(args.cache_dir);
+    }
+    diagnose2::SearchResults results{};
+    for (auto &result : diagnose2::analyze_perturbations(
+             structures,
+             {.num_jobs = args.num_jobs,
+              .search_options = {.timeout_s = TIMEOUT_S,
+                                 .num_threads = args.num_threads,
+                                 .ordering_strategy =
+                                     NAME_TO_ORDERING_STRATEGY.at(args.ordering_strategy),
+                                 .mode = args.diagnosis_only
+                                             ? diagnose2::SearchMode::DiagnosisOnly
+                                             : diagnose2::SearchMode::Full,
+                                 .num_prescreen_orderings = args.num_prescreen_orderings,
+                                 .stop_token = stop_token,
+                                 .cache = cache ? &*cache : nullptr},
+              .on_result = print_result})) {
+        *results.add_search_result() = std::move(result);
+    }
+    return results;
+}
+
+// Search the units of the work queue until all of them have results, holding a lease on the unit
+// being searched. A unit whose lease expires is dropped, as another worker may have claimed it.
+void work(const Args &args) {
+    using namespace magnon;
+
+    const search::WorkQueue queue(args.queue_dir, std::chrono::seconds{args.lease_timeout_s});
+    const std::string worker_id = [&]() {
+        std::array<char, 256> hostname{};
+        gethostname(hostname.data(), hostname.size() - 1);
+        return fmt::format("{}.{}", hostname.data(), getpid());
+    }();
+    const auto renew_interval = std::chrono::seconds{std::max(1, args.lease_timeout_s / 4)};
+
+    while (!queue.is_done()) {
+        const auto claim = queue.claim(worker_id);
+        if (!claim) {
+            // Wait for the other workers to finish, or for their claims to expire.
+            std::this_thread::sleep_for(renew_interval);
+            continue;
+        }
+        std::cerr << fmt::format("Work unit {}\n", claim->unit_idx);
+
+        diagnose2::SearchResults results{};
+        std::stop_source lease_lost;
+        {
+            std::jthread lease_renewer([&](const std::stop_token stop) {
+                std::mutex mutex;
+                std::condition_variable_any stopped;
+                std::unique_lock lock(mutex);
+                while (!stopped.wait_for(lock, stop, renew_interval, [] { return false; }) &&
+                       !stop.stop_requested()) {
+                    if (!queue.renew(*claim)) {
+                        lease_lost.request_stop();
+                        return;
+                    }
+                }
+            });
+            results = search_structures(claim->structures, args, lease_lost.get_token());
+        }
+        if (lease_lost.stop_requested()) {
+            std::cerr << fmt::format("Lost the lease on work unit {}\n", claim->unit_idx);
+            continue;
+        }
+        queue.complete(*claim, results);
+    }
+}
 
-        *results.add_search_result() = result;
+int main(const int argc, const char *const argv[]) {
+    using namespace magnon;
+    const Args args{argc, argv};
+
+    if (args.shard_mode == "work") {
+        work(args);
+        return EXIT_SUCCESS;
+    }
+    if (args.shard_mode == "merge") {
+        const search::WorkQueue queue(args.queue_dir, std::chrono::seconds{args.lease_timeout_s});
+        std::ofstream(args.output_filename) << utils::proto::to_text_format(queue.merge_results());
+        return EXIT_SUCCESS;
     }
+
+    diagnose2::PerturbedBandStructures perturbed_structures{};
+    utils::proto::read_from_text_file(args.input_filename, perturbed_structures);
+
+    if (args.shard_mode == "split") {
+        search::WorkQueue::create(args.queue_dir, perturbed_structures, args.unit_size);
+        return EXIT_SUCCESS;
+    }
+
+    if (args.estimate_only) {
+        for (const auto &perturbed_structure : perturbed_structures.structure()) {
+            print_description(perturbed_structure);
+            print_estimate(diagnose2::estimate_search_space(perturbed_structure));
+        }
+        return EXIT_SUCCESS;
+    }
+
     std::ofstream out(args.output_filename);
-    out << utils::proto::to_text_format(results);
+    out << utils::proto::to_text_format(search_structures(perturbed_structures, args));
 }
 
 Args::Args(const int argc, const char *const argv[]) {
@@ -61,8 +222,33 @@ Args::Args(const int argc, const char *const argv[]) {
     // clang-format off
     desc.add_options()
         ("help", "Print help message.")
-        ("input_file", po::value(&input_filename)->required(), "Perturbations filename")
-        ("output_file", po::value(&output_filename)->required(), "Search result output filename");
+        ("input_file", po::value(&input_filename), "Perturbations filename")
+        ("output_file", po::value(&output_filename), "Search result output filename")
+        ("num_threads", po::value(&num_threads)->default_value(1),
+         "Number of threads searching each perturbation")
+        ("jobs", po::value(&num_jobs)->default_value(1),
+         "Number of perturbations searched at once")
+        ("estimate_only", po::bool_switch(&estimate_only),
+         "Print the size of each search space instead of searching")
+        ("diagnosis_only", po::bool_switch(&diagnosis_only),
+         "Only decide the diagnosis of each perturbation, without its possible gap counts and SIs")
+        ("prescreen_orderings", po::value(&num_prescreen_orderings)->default_value(0),
+         "Number of random superband orderings sampled for an exclusion before each search")
+        ("ordering_strategy", po::value(&ordering_strategy)->default_value("lexicographic"),
+         "Order of the superband orderings: \"lexicographic\", \"impact_first\" or "
+         "\"impact_first_interleaved\"")
+        ("cache_dir", po::value(&cache_dir),
+         "Directory of the search result cache, shared by concurrent processes")
+        ("shard_mode", po::value(&shard_mode),
+         "Search through the work queue `queue_dir` shared by several processes: \"split\" the "
+         "input file into it, \"work\" on its units, or \"merge\" their results into the "
+         "output file")
+        ("queue_dir", po::value(&queue_dir), "Work queue directory")
+        ("unit_size", po::value(&unit_size)->default_value(1),
+         "Number of perturbations in each work unit")
+        ("lease_timeout_s", po::value(&lease_timeout_s)->default_value(600),
+         "Time after which the work unit of a worker that stopped renewing its claim is searched "
+         "again");
     // clang-format on
 
     try {
@@ -73,6 +259,23 @@ Args::Args(const int argc, const char *const argv[]) {
             std::exit(EXIT_SUCCESS);
         }
         po::notify(vm);
+        if (!shard_mode.empty() && shard_mode != "split" && shard_mode != "work" &&
+            shard_mode != "merge") {
+            throw po::invalid_option_value(shard_mode);
+        }
+        if (!NAME_TO_ORDERING_STRATEGY.contains(ordering_strategy)) {
+            throw po::invalid_option_value(ordering_strategy);
+        }
+        if (!shard_mode.empty() && queue_dir.empty()) {
+            throw po::required_option("queue_dir");
+        }
+        if (input_filename.empty() && (shard_mode.empty() || shard_mode == "split")) {
+            throw po::required_option("input_file");
+        }
+        if (output_filename.empty() &&
+            (shard_mode.empty() ? !estimate_only : shard_mode == "merge")) {
+            throw po::required_option("output_file");
+        }
     } catch (const po::error &e) {
         std::cerr << "Error: " << e.what() << '\n';
         std::exit(EXIT_SUCCESS);
@@ -0,0 +1,188 @@
+#include "search/work_queue.hpp"
+
+#include <algorithm>
+#include <fstream>
+#include <stdexcept>
+#include <system_error>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "fmt/core.h"
+
+#include "utils/proto_text_format.hpp"
+
+namespace magnon::search {
+
+namespace {
+
+namespace fs = std::filesystem;
+
+constexpr const char *NUM_UNITS_FILENAME = "num_units.txt";
+constexpr const char *UNIT_SUFFIX = ".pb.txt";
+// How often to look for the number of units of a queue still being split
+constexpr std::chrono::milliseconds SPLIT_POLL_INTERVAL{100};
+
+// Write `message` to `path` through a temporary file renamed over it, so that readers never see
+// a partial file. `tmp_suffix` must be unique among the concurrent writers of `path`.
+void write_atomically(const fs::path &path,
+                      const ::google::protobuf::Message &message,
+                      const std::string &tmp_suffix) {
+    const fs::path tmp_path = path.string() + "." + tmp_suffix + ".tmp";
+    {
+        std::ofstream out(tmp_path);
+        out << utils::proto::to_text_format(message);
+        if (!out) {
+            throw std::runtime_error(fmt::format("Unable to write \"{}\"", tmp_path.string()));
+        }
+    }
+    fs::rename(tmp_path, path);
+}
+
+template <typename Message>
+Message read(const fs::path &path) {
+    Message result{};
+    if (!utils::proto::read_from_text_file(path.string(), result)) {
+        throw std::runtime_error(
+            fmt::format("Unable to read proto file! Pathname: \"{}\".", path.string()));
+    }
+    return result;
+}
+
+// Names of the files in `dir`, sorted.
+std::vector<std::string> list_filenames(const fs::path &dir) {
+    std::vector<std::string> result;
+    for (const auto &entry : fs::directory_iterator(dir)) {
+        result.push_back(entry.path().filename().string());
+    }
+    std::sort(result.begin(), result.end());
+    return result;
+}
+
+}  // namespace
+
+WorkQueue::WorkQueue(fs::path dir, const std::chrono::seconds lease_timeout)
+    : dir{std::move(dir)}, lease_timeout{lease_timeout} {}
+
+void WorkQueue::create(const fs::path &dir,
+                       const diagnose2::PerturbedBandStructures &structures,
+                       const int unit_size) {
+    if (unit_size < 1) {
+        throw std::invalid_argument("Work units must hold at least one structure");
+    }
+    if (fs::exists(dir) && !fs::is_empty(dir)) {
+        throw std::runtime_error(fmt::format("Work queue \"{}\" already exists", dir.string()));
+    }
+    for (const auto *subdir : {"pending", "claimed", "results"}) {
+        fs::create_directories(dir / subdir);
+    }
+
+    const WorkQueue queue(dir, std::chrono::seconds{0});
+    int num_units = 0;
+    for (int begin = 0; begin < structures.structure_size(); begin += unit_size) {
+        diagnose2::PerturbedBandStructures unit{};
+        for (int i = begin; i < std::min(begin + unit_size, structures.structure_size()); ++i) {
+            *unit.add_structure() = structures.structure(i);
+        }
+        write_atomically(queue.unit_path("pending", num_units++), unit, "create");
+    }
+    // Written last, so that workers do not start on a partially split input.
+    const fs::path num_units_tmp_path = (dir / NUM_UNITS_FILENAME).string() + ".create.tmp";
+    std::ofstream(num_units_tmp_path) << num_units << '\n';
+    fs::rename(num_units_tmp_path, dir / NUM_UNITS_FILENAME);
+}
+
+std::optional<WorkQueue::Claim> WorkQueue::claim(const std::string &worker_id) const {
+    return_expired_claims();
+    for (const auto &filename : list_filenames(dir / "pending")) {
+        if (!filename.ends_with(UNIT_SUFFIX)) {  // Being written
+            continue;
+        }
+        const fs::path pending_path = dir / "pending" / filename;
+        const fs::path claimed_path = dir / "claimed" / (filename + "." + worker_id);
+        // Start the lease before the rename, which keeps the modification time, so that no other
+        // worker sees the new claim as expired.
+        std::error_code error;
+        fs::last_write_time(pending_path, fs::file_time_type::clock::now(), error);
+        fs::rename(pending_path, claimed_path, error);
+        if (error) {  // Claimed by another worker
+            continue;
+        }
+        const int unit_idx = std::stoi(filename.substr(std::string("unit_").size()));
+        return Claim{.unit_idx = unit_idx,
+                     .worker_id = worker_id,
+                     .claimed_path = claimed_path,
+                     .structures = read<diagnose2::PerturbedBandStructures>(claimed_path)};
+    }
+    return std::nullopt;
+}
+
+bool WorkQueue::renew(const Claim &claim) const {
+    std::error_code error;
+    fs::last_write_time(claim.claimed_path, fs::file_time_type::clock::now(), error);
+    return !error;
+}
+
+void WorkQueue::complete(const Claim &claim, const diagnose2::SearchResults &results) const {
+    write_atomically(unit_path("results", claim.unit_idx), results, claim.worker_id);
+    std::error_code error;
+    fs::remove(claim.claimed_path, error);
+}
+
+int WorkQueue::num_units() const {
+    // Workers may start before the input is split.
+    while (!fs::exists(dir / NUM_UNITS_FILENAME)) {
+        std::this_thread::sleep_for(SPLIT_POLL_INTERVAL);
+    }
+    int result = -1;
+    std::ifstream(dir / NUM_UNITS_FILENAME) >> result;
+    if (result < 0) {
+        throw std::runtime_error(fmt::format("\"{}\" is not a work queue", dir.string()));
+    }
+    return result;
+}
+
+bool WorkQueue::is_done() const {
+    for (int unit_idx = 0; unit_idx < num_units(); ++unit_idx) {
+        if (!fs::exists(unit_path("results", unit_idx))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+diagnose2::SearchResults WorkQueue::merge_results() const {
+    diagnose2::SearchResults result{};
+    for (int unit_idx = 0; unit_idx < num_units(); ++unit_idx) {
+        const fs::path path = unit_path("results", unit_idx);
+        if (!fs::exists(path)) {
+            throw std::runtime_error(fmt::format("Work unit {} has no results yet", unit_idx));
+        }
+        auto unit_results = read<diagnose2::SearchResults>(path);
+        for (auto &search_result : *unit_results.mutable_search_result()) {
+            *result.add_search_result() = std::move(search_result);
+        }
+    }
+    return result;
+}
+
+fs::path WorkQueue::unit_path(const std::string &subdir, const int unit_idx) const {
+    return dir / subdir / fmt::format("unit_{:06}{}", unit_idx, UNIT_SUFFIX);
+}
+
+void WorkQueue::return_expired_claims() const {
+    const auto expiry_time = fs::file_time_type::clock::now() - lease_timeout;
+    for (const auto &filename : list_filenames(dir / "claimed")) {
+        const fs::path claimed_path = dir / "claimed" / filename;
+        std::error_code error;
+        const auto last_write_time = fs::last_write_time(claimed_path, error);
+        if (error || last_write_time >= expiry_time) {
+            continue;
+        }
+        // Strip the worker ID. If another worker returns the claim first, the rename fails.
+        const auto unit_filename = filename.substr(0, filename.find(UNIT_SUFFIX)) + UNIT_SUFFIX;
+        fs::rename(claimed_path, dir / "pending" / unit_filename, error);
+    }
+}
+
+}  // namespace magnon::search
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <chrono>
+#include <filesystem>
+#include <optional>
+#include <string>
+
+#include "diagnose2/perturbed_band_structure.pb.h"
+#include "diagnose2/search_result.pb.h"
+
+namespace magnon::search {
+
+// A queue of perturbation batches in a directory shared by worker processes, possibly on several
+// machines mounting the same file system. No process coordinates the workers: each unit of work
+// moves between the subdirectories below by atomic renames, so exactly one worker claims it.
+//
+//     num_units.txt                        Number of units the input was split into
+//     pending/unit_<idx>.pb.txt            `PerturbedBandStructures` waiting for a worker
+//     claimed/unit_<idx>.pb.txt.<worker>   Claimed by a worker, which renews its lease by
+//                                          touching the file
+//     results/unit_<idx>.pb.txt            `SearchResults` of the unit
+//
+// A claim whose file was not touched for the lease timeout is returned to `pending/`, so the units
+// of crashed workers are searched again. A worker that only stalled may then finish its unit too;
+// as searches are deterministic, both write the same results.
+class WorkQueue {
+ public:
+    WorkQueue(std::filesystem::path dir, std::chrono::seconds lease_timeout);
+
+    // Split `structures` into units of `unit_size` structures in the new queue directory `dir`.
+    static void create(const std::filesystem::path &dir,
+                       const diagnose2::PerturbedBandStructures &structures,
+                       int unit_size);
+
+    struct Claim {
+        int unit_idx;
+        std::string worker_id;
+        std::filesystem::path claimed_path;
+        diagnose2::PerturbedBandStructures structures;
+    };
+
+    // Claim a pending unit for `worker_id`, after returning the expired claims to the pending
+    // units. Return nothing if no unit is pending.
+    std::optional<Claim> claim(const std::string &worker_id) const;
+    // Renew the lease on `claim`. Return false if it expired and was returned to the pending units.
+    bool renew(const Claim &claim) const;
+    // Save the results of the unit of `claim` and release it.
+    void complete(const Claim &claim, const diagnose2::SearchResults &results) const;
+
+    // Number of units of the queue, waiting until it is split if it is not yet.
+    int num_units() const;
+    bool is_done() const;
+    // The results of all the units in input order. Throw `std::runtime_error` if a unit has none.
+    diagnose2::SearchResults merge_results() const;
+
+ private:
+    std::filesystem::path unit_path(const std::string &subdir, int unit_idx) const;
+    void return_expired_claims() const;
+
+    std::filesystem::path dir;
+    std::chrono::seconds lease_timeout;
+};
+
+}  // namespace magnon::search
@@ -0,0 +1,148 @@
+#include "search/work_queue.hpp"
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+namespace magnon::search {
+
+namespace fs = std::filesystem;
+
+// A fresh directory for the queue of the running test.
+fs::path make_queue_dir() {
+    const auto *test_info = testing::UnitTest::GetInstance()->current_test_info();
+    const fs::path result = fs::path(testing::TempDir()) / "work_queue_test" / test_info->name();
+    fs::remove_all(result);
+    return result;
+}
+
+// Structures told apart by their supergroup label.
+diagnose2::PerturbedBandStructures make_structures(const int num_structures) {
+    diagnose2::PerturbedBandStructures result{};
+    for (int i = 0; i < num_structures; ++i) {
+        result.add_structure()->mutable_supergroup()->set_label(std::to_string(i));
+    }
+    return result;
+}
+
+// Stands in for the search, which the queue does not depend on.
+diagnose2::SearchResults make_results(const diagnose2::PerturbedBandStructures &structures) {
+    diagnose2::SearchResults result{};
+    for (const auto &structure : structures.structure()) {
+        result.add_search_result()->set_supergroup_label(structure.supergroup().label());
+    }
+    return result;
+}
+
+TEST(WorkQueueTest, WorkersReassembleInputOrder) {
+    const auto dir = make_queue_dir();
+    WorkQueue::create(dir, make_structures(10), 3);
+    const WorkQueue queue(dir, std::chrono::seconds{60});
+    EXPECT_EQ(queue.num_units(), 4);
+    EXPECT_FALSE(queue.is_done());
+    EXPECT_THROW(queue.merge_results(), std::runtime_error);
+
+    {
+        std::vector<std::jthread> workers;
+        for (int i = 0; i < 3; ++i) {
+            workers.emplace_back([&queue, i]() {
+                while (const auto claim = queue.claim("worker" + std::to_string(i))) {
+                    EXPECT_TRUE(queue.renew(*claim));
+                    queue.complete(*claim, make_results(claim->structures));
+                }
+            });
+        }
+    }
+
+    EXPECT_TRUE(queue.is_done());
+    const auto results = queue.merge_results();
+    ASSERT_EQ(results.search_result_size(), 10);
+    for (int i = 0; i < results.search_result_size(); ++i) {
+        EXPECT_EQ(results.search_result(i).supergroup_label(), std::to_string(i));
+    }
+}
+
+TEST(WorkQueueTest, WorkerProcessesShareQueue) {
+    const auto dir = make_queue_dir();
+    constexpr int num_workers = 4;
+
+    // Start the workers before the split, which they wait for.
+    std::vector<pid_t> pids;
+    for (int i = 0; i < num_workers; ++i) {
+        const pid_t pid = fork();
+        ASSERT_NE(pid, -1);
+        if (pid == 0) {
+            const WorkQueue queue(dir, std::chrono::seconds{60});
+            while (!queue.is_done()) {
+                const auto claim = queue.claim("worker" + std::to_string(i));
+                if (!claim) {
+                    std::this_thread::sleep_for(std::chrono::milliseconds{10});
+                    continue;
+                }
+                if (!queue.renew(*claim)) {
+                    _exit(EXIT_FAILURE);
+                }
+                queue.complete(*claim, make_results(claim->structures));
+            }
+            _exit(EXIT_SUCCESS);
+        }
+        pids.push_back(pid);
+    }
+    WorkQueue::create(dir, make_structures(50), 2);
+
+    for (const pid_t pid : pids) {
+        int status = 0;
+        ASSERT_EQ(waitpid(pid, &status, 0), pid);
+        EXPECT_TRUE(WIFEXITED(status));
+        EXPECT_EQ(WEXITSTATUS(status), EXIT_SUCCESS);
+    }
+
+    const WorkQueue queue(dir, std::chrono::seconds{60});
+    EXPECT_TRUE(queue.is_done());
+    EXPECT_TRUE(fs::is_empty(dir / "pending"));
+    EXPECT_TRUE(fs::is_empty(dir / "claimed"));
+    const auto results = queue.merge_results();
+    ASSERT_EQ(results.search_result_size(), 50);
+    for (int i = 0; i < results.search_result_size(); ++i) {
+        EXPECT_EQ(results.search_result(i).supergroup_label(), std::to_string(i));
+    }
+}
+
+TEST(WorkQueueTest, ReturnsExpiredClaims) {
+    const auto dir = make_queue_dir();
+    WorkQueue::create(dir, make_structures(2), 2);
+    const WorkQueue queue(dir, std::chrono::seconds{60});
+
+    const auto crashed_claim = queue.claim("crashed");
+    ASSERT_TRUE(crashed_claim);
+    EXPECT_FALSE(queue.claim("rescuer"));
+
+    // Let the lease expire.
+    fs::last_write_time(crashed_claim->claimed_path,
+                        fs::file_time_type::clock::now() - std::chrono::minutes{2});
+    const auto rescuer_claim = queue.claim("rescuer");
+    ASSERT_TRUE(rescuer_claim);
+    EXPECT_EQ(rescuer_claim->unit_idx, crashed_claim->unit_idx);
+    EXPECT_FALSE(queue.renew(*crashed_claim));
+
+    queue.complete(*rescuer_claim, make_results(rescuer_claim->structures));
+    EXPECT_TRUE(queue.is_done());
+    EXPECT_EQ(queue.merge_results().search_result_size(), 2);
+}
+
+TEST(WorkQueueTest, RejectsExistingQueue) {
+    const auto dir = make_queue_dir();
+    WorkQueue::create(dir, make_structures(1), 1);
+    EXPECT_THROW(WorkQueue::create(dir, make_structures(1), 1), std::runtime_error);
+}
+
+}  // namespace magnon::search
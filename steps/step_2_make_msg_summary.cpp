@@ -1,6 +1,11 @@
+#include <atomic>
+#include <csignal>
 #include <cstdlib>
+#include <filesystem>
 #include <fstream>
 #include <iostream>
+#include <optional>
+#include <vector>
 
 #include "boost/program_options.hpp"
 #include "fmt/core.h"
@@ -17,24 +22,36 @@ const std::string msgs_summary_pathname =
     fmt::format("{}/msgs_summary.pb.txt", output_dirs.at("output_base_dir"));
 const std::string msg_summary_dir = output_dirs.at("msg_summary_dir");
 const std::string perturbations_dir = output_dirs.at("perturbations_dir");
-constexpr double SEARCH_TIMEOUT_S = 10.0;
+
+// Set by SIGINT and SIGTERM, so that the running search can save a checkpoint before exiting.
+std::atomic<bool> interrupted = false;
 
 struct Args {
     Args(const int argc, const char *const argv[]);
 
     std::string msg{};
+    double search_timeout_s = 10.0;
+    std::string checkpoint_dir{};
+    int num_jobs = 1;
+    std::string cache_dir{};
+    bool diagnosis_only{};
+    long num_prescreen_orderings = 0;
 };
 
 using MsgsSummary = magnon::summary::MsgsSummary;
 using MsgSummary = MsgsSummary::MsgSummary;
 using Perturbations = magnon::diagnose2::PerturbedBandStructures;
 
-MsgSummary make_msg_summary(MsgSummary unpopulated_summary);
+MsgSummary make_msg_summary(MsgSummary unpopulated_summary, const Args &args);
 
 int main(const int argc, const char *const argv[]) {
     using namespace magnon;
     const Args args{argc, argv};
 
+    const auto set_interrupted = [](int) { interrupted = true; };
+    std::signal(SIGINT, set_interrupted);
+    std::signal(SIGTERM, set_interrupted);
+
     MsgsSummary msgs_summary{};
     if (!utils::proto::read_from_text_file(msgs_summary_pathname, msgs_summary)) {
         throw std::runtime_error(
@@ -51,15 +68,79 @@ int main(const int argc, const char *const argv[]) {
     const auto msg_summary_it = ranges::find_if(msgs_summary.msg_summary(), has_correct_msg);
     assert(msg_summary_it != msgs_summary.msg_summary().end());
 
-    const MsgSummary msg_summary = make_msg_summary(*msg_summary_it);
+    const MsgSummary msg_summary = make_msg_summary(*msg_summary_it, args);
     const std::string output_pathname = fmt::format("{}/{}.pb.txt", msg_summary_dir, args.msg);
     std::ofstream(output_pathname) << utils::proto::to_text_format(msg_summary);
     std::cerr << fmt::format("Output: {}\n", output_pathname);
 }
 
-MsgSummary make_msg_summary(MsgSummary unpopulated_summary) {
+// Search the perturbations, resuming from and saving to the checkpoint pathnames that are not
+// empty. Exit if the searches are interrupted.
+std::vector<magnon::diagnose2::SearchResult> search(
+    const std::vector<magnon::diagnose2::PerturbedBandStructure> &structures,
+    const std::vector<std::string> &checkpoint_pathnames,
+    const Args &args) {
+    using namespace magnon;
+
+    std::vector<diagnose2::SearchCheckpoint> resume_from(structures.size());
+    std::vector<const diagnose2::SearchCheckpoint *> resume_from_ptrs(structures.size(), nullptr);
+    std::vector<diagnose2::SearchCheckpoint> checkpoints(structures.size());
+    for (std::size_t i = 0; i < structures.size(); ++i) {
+        const auto &checkpoint_pathname = checkpoint_pathnames[i];
+        if (!checkpoint_pathname.empty() && std::filesystem::exists(checkpoint_pathname)) {
+            if (!utils::proto::read_from_text_file(checkpoint_pathname, resume_from[i])) {
+                throw std::runtime_error(fmt::format(
+                    "Unable to read proto file! Pathname: \"{}\".", checkpoint_pathname));
+            }
+            resume_from_ptrs[i] = &resume_from[i];
+            std::cerr << fmt::format("Resuming from: {}\n", checkpoint_pathname);
+        }
+    }
+
+    const auto save_checkpoint = [&](const std::size_t i, const diagnose2::SearchResult &result) {
+        const auto &checkpoint_pathname = checkpoint_pathnames[i];
+        if (checkpoint_pathname.empty()) {
+            return;
+        }
+        if (result.is_timeout()) {
+            std::ofstream(checkpoint_pathname) << utils::proto::to_text_format(checkpoints[i]);
+            std::cerr << fmt::format("Checkpoint: {}\n", checkpoint_pathname);
+        } else {
+            std::filesystem::remove(checkpoint_pathname);
+        }
+    };
+    std::optional<diagnose2::SearchCache> cache;
+    if (!args.cache_dir.empty()) {
+        cache.emplace(args.cache_dir);
+    }
+    auto results = diagnose2::analyze_perturbations(
+        structures,
+        {.num_jobs = args.num_jobs,
+         .search_options = {.timeout_s = args.search_timeout_s,
+                            .mode = args.diagnosis_only ? diagnose2::SearchMode::DiagnosisOnly
+                                                        : diagnose2::SearchMode::Full,
+                            .num_prescreen_orderings = args.num_prescreen_orderings,
+                            .interrupt = &interrupted,
+                            .cache = cache ? &*cache : nullptr},
+         .resume_from = resume_from_ptrs,
+         .checkpoints = checkpoints,
+         .on_result = save_checkpoint});
+    if (interrupted) {
+        std::cerr << "Interrupted\n";
+        std::exit(EXIT_FAILURE);
+    }
+    return results;
+}
+
+MsgSummary make_msg_summary(MsgSummary unpopulated_summary, const Args &args) {
     using namespace magnon;
 
+    // All the perturbations of the MSG are searched in one batch, so that slow ones do not hold up
+    // the others.
+    std::vector<diagnose2::PerturbedBandStructure> structures;
+    std::vector<std::string> checkpoint_pathnames;
+    // Checkpoints only resume searches in the mode they were taken in.
+    const std::string checkpoint_suffix = args.diagnosis_only ? "_diagnosis" : "";
     for (auto &wps_summary : *unpopulated_summary.mutable_wps_summary()) {
         const std::string wps_encoding =
             wps_summary.wp_label() | ranges::views::join('+') | ranges::to<std::string>;
@@ -72,11 +153,27 @@ MsgSummary make_msg_summary(MsgSummary unpopulated_summary) {
             throw std::runtime_error(
                 fmt::format("Unable to read proto file! Pathname: \"{}\".", perturbation_filename));
         }
-        for (const auto &perturbation : perturbations.structure()) {
+        for (int i = 0; i < perturbations.structure_size(); ++i) {
+            const auto &perturbation = perturbations.structure(i);
             auto &perturbation_summary = *wps_summary.add_perturbation_summary();
             perturbation_summary.mutable_perturbation()->CopyFrom(perturbation);
-            perturbation_summary.mutable_search_result()->CopyFrom(diagnose2::analyze_perturbation(
-                formula::maybe_with_alternative_si_formulas(perturbation), SEARCH_TIMEOUT_S));
+            structures.push_back(formula::maybe_with_alternative_si_formulas(perturbation));
+            checkpoint_pathnames.push_back(args.checkpoint_dir.empty()
+                                               ? ""
+                                               : fmt::format("{}/{}_{}_{}{}.pb.txt",
+                                                             args.checkpoint_dir,
+                                                             unpopulated_summary.msg_number(),
+                                                             wps_encoding,
+                                                             i,
+                                                             checkpoint_suffix));
+        }
+    }
+
+    auto results = search(structures, checkpoint_pathnames, args);
+    auto result_it = results.begin();
+    for (auto &wps_summary : *unpopulated_summary.mutable_wps_summary()) {
+        for (auto &perturbation_summary : *wps_summary.mutable_perturbation_summary()) {
+            *perturbation_summary.mutable_search_result() = std::move(*result_it++);
         }
     }
     return unpopulated_summary;
@@ -89,7 +186,21 @@ Args::Args(const int argc, const char *const argv[]) {
     // clang-format off
     desc.add_options()
         ("help", "Print help message.")
-        ("msg", po::value(&msg)->required(), "MSG number");
+        ("msg", po::value(&msg)->required(), "MSG number")
+        ("search_timeout_s", po::value(&search_timeout_s)->default_value(search_timeout_s),
+         "Time budget of each perturbation search, non-positive for none")
+        ("checkpoint_dir", po::value(&checkpoint_dir),
+         "Directory to save the searches that time out or are interrupted in, and to resume "
+         "them from on the next run")
+        ("jobs", po::value(&num_jobs)->default_value(num_jobs),
+         "Number of perturbations searched at once")
+        ("cache_dir", po::value(&cache_dir),
+         "Directory of the search result cache, shared by concurrent processes")
+        ("diagnosis_only", po::bool_switch(&diagnosis_only),
+         "Only decide the diagnosis of each perturbation, without its possible gap counts and SIs")
+        ("prescreen_orderings",
+         po::value(&num_prescreen_orderings)->default_value(num_prescreen_orderings),
+         "Number of random superband orderings sampled for an exclusion before each search");
     // clang-format on
 
     try {
@@ -49,8 +49,6 @@ int main(const int argc, const char *const argv[]) {
             }
 
             const diagnose2::SpectrumData data(perturbation);
-            const diagnose2::Superband superband(data.pos_neg_magnonirreps.first, data);
-            const diagnose2::Subband subband = superband.make_subband();
 
             const std::string wps = [&]() {
                 std::string result{};
@@ -73,14 +71,29 @@ int main(const int argc, const char *const argv[]) {
                 }
                 return result;
             };
-            const std::string filename = fmt::format(
-                "{}_{}_{}_{}_fig.tex",
+            const std::string figure_stem = fmt::format(
+                "{}_{}_{}_{}",
                 perturbation.supergroup().number(),
                 perturbation.subgroup().number(),
                 filter_alnum(perturbation.group_subgroup_relation().perturbation_prescription(0)),
                 wps);
-            const std::string figure_filepath = fmt::format("{}/{}", figures_dir, filename);
-            Visualizer(superband, subband, data).dump(figure_filepath);
+            const std::string figure_filepath =
+                fmt::format("{}/{}_fig.tex", figures_dir, figure_stem);
+            // Draw the models with the most and the fewest nontrivial gaps if the search recorded
+            // them, the latter next to the former with a `_min` suffix, and the unpermuted
+            // energetics otherwise.
+            const auto &search_result = pert_summary.search_result();
+            if (search_result.has_max_nontrivial_witness()) {
+                Visualizer(search_result.max_nontrivial_witness(), data).dump(figure_filepath);
+                const std::string min_figure_filepath =
+                    fmt::format("{}/{}_min_fig.tex", figures_dir, figure_stem);
+                Visualizer(search_result.min_nontrivial_witness(), data).dump(min_figure_filepath);
+                std::cerr << fmt::format("Output: {}\n", min_figure_filepath);
+            } else {
+                const diagnose2::Superband superband(data.pos_neg_magnonirreps.first, data);
+                const diagnose2::Subband subband = superband.make_subband();
+                Visualizer(superband, subband, data).dump(figure_filepath);
+            }
             std::cerr << fmt::format("Output: {}\n", figure_filepath);
         }
     }
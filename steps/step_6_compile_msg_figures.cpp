@@ -1,5 +1,7 @@
 #include <cstdlib>
 #include <iostream>
+#include <string>
+#include <vector>
 
 #include "boost/optional.hpp"
 #include "boost/program_options.hpp"
@@ -66,17 +68,26 @@ int main(const int argc, const char *const argv[]) {
                 }
                 return result;
             };
-            const std::string filename = fmt::format(
-                "{}_{}_{}_{}_fig.tex",
+            const std::string figure_stem = fmt::format(
+                "{}_{}_{}_{}",
                 perturbation.supergroup().number(),
                 perturbation.subgroup().number(),
                 filter_alnum(perturbation.group_subgroup_relation().perturbation_prescription(0)),
                 wps);
-            const std::string command =
-                fmt::format("cd {0} && pdflatex {1} 1>/dev/null && pdflatex {1} 1>/dev/null",
-                            figures_dir,
-                            filename);
-            std::cerr << fmt::format("Result: {}, Command: {}\n", system(command.c_str()), command);
+            // Step 3 draws the model with the fewest nontrivial gaps next to the one with the most
+            // whenever the search recorded them.
+            std::vector<std::string> filenames{fmt::format("{}_fig.tex", figure_stem)};
+            if (pert_summary.search_result().has_min_nontrivial_witness()) {
+                filenames.push_back(fmt::format("{}_min_fig.tex", figure_stem));
+            }
+            for (const auto &filename : filenames) {
+                const std::string command =
+                    fmt::format("cd {0} && pdflatex {1} 1>/dev/null && pdflatex {1} 1>/dev/null",
+                                figures_dir,
+                                filename);
+                std::cerr << fmt::format(
+                    "Result: {}, Command: {}\n", system(command.c_str()), command);
+            }
         }
     }
 }
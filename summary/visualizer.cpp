@@ -381,6 +381,16 @@ Visualizer::Visualizer(const diagnose2::Superband &superband,
     subband_height = vis_config_.subband_superband_ratio * superband_height;
 }
 
+Visualizer::Visualizer(const diagnose2::SearchResult::Witness &witness,
+                       const diagnose2::SpectrumData &data)
+    : Visualizer(diagnose2::replay_witness(witness, data), data) {}
+
+Visualizer::Visualizer(std::unique_ptr<const diagnose2::WitnessModel> witness_model,
+                       const diagnose2::SpectrumData &data)
+    : Visualizer(witness_model->superband, witness_model->subband, data) {
+    this->witness_model = std::move(witness_model);
+}
+
 void Visualizer::dump(const std::string &filename) {
     std::ostringstream sis_code;
     std::ostringstream node_code;
@@ -458,14 +468,6 @@ void Visualizer::dump(const std::string &filename) {
             assert(dim == gap);
             assert(e_idx > 0);
 
-            const auto to_str = [](const IntMatrix &si) {
-                std::ostringstream result;
-                for (int i = 0; i < si.size(); ++i) {
-                    result << si(i);
-                }
-                return result.str();
-            };
-
             IrrepPoint p1 = x_idx_to_subirrep_points[x_idx][e_idx - 1];
             IrrepPoint p2 = x_idx_to_subirrep_points[x_idx][e_idx];
 
@@ -474,7 +476,7 @@ void Visualizer::dump(const std::string &filename) {
             const double x2 = 0.5 * (p1.x + p2.x) - 0.9;
             const double y2 = 0.5 * (p1.y + p2.y);
 
-            const char *color = si.isZero() ? "black" : "red";
+            const char *color = si.is_trivial() ? "black" : "red";
 
             sis_code << fmt::format(
                 R"(\draw[-{{Latex[length=3mm,width=2.25mm]}},line width=.95pt,{},)"
@@ -493,7 +495,7 @@ void Visualizer::dump(const std::string &filename) {
                                     color,
                                     x2,
                                     y2 + .22,
-                                    to_str(si));
+                                    data.sub_si_group.to_string(si));
         }
     }
 
@@ -2,13 +2,16 @@
 
 #include <cassert>
 #include <map>
+#include <memory>
 #include <optional>
 #include <string>
 #include <utility>
 #include <vector>
 
 #include "config/visualization_config.pb.h"
+#include "diagnose2/search_result.pb.h"
 #include "diagnose2/spectrum_data.hpp"
+#include "diagnose2/witness.hpp"
 
 namespace magnon {
 
@@ -47,10 +50,16 @@ class Visualizer {
     Visualizer(const diagnose2::Superband &superband,
                const diagnose2::Subband &subband,
                const diagnose2::SpectrumData &data);
+    // Draw the model `witness` records, from a search of the structure `data` was built from.
+    Visualizer(const diagnose2::SearchResult::Witness &witness,
+               const diagnose2::SpectrumData &data);
 
     void dump(const std::string &filename);
 
  private:
+    Visualizer(std::unique_ptr<const diagnose2::WitnessModel> witness_model,
+               const diagnose2::SpectrumData &data);
+
     void supervisualize_at_x_idx(int x_idx, std::ostringstream &output);
     void subvisualize_at_x_idx(int x_idx, std::ostringstream &output);
     void visualize_superlines(int x1_idx, int x2_idx, std::ostringstream &output);
@@ -95,6 +104,8 @@ class Visualizer {
 
  private:
     std::vector<int> drawn_subk_idxs;
+    // Owns the superband and subband when replaying a witness
+    std::unique_ptr<const diagnose2::WitnessModel> witness_model;
     const diagnose2::Superband &superband;
     const diagnose2::Subband &subband;
     const diagnose2::SpectrumData &data;
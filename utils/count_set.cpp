@@ -0,0 +1,98 @@
+#include "utils/count_set.hpp"
+
+#include <algorithm>
+#include <cassert>
+
+namespace magnon::utils {
+
+CountSet::CountSet(const std::initializer_list<int> counts) {
+    for (const auto count : counts) {
+        insert(count);
+    }
+}
+
+void CountSet::insert(const int count) {
+    assert(count >= 0);
+    const auto word_idx = static_cast<std::size_t>(count / WORD_BITS);
+    if (word_idx >= words.size()) {
+        words.resize(word_idx + 1, 0);
+    }
+    words[word_idx] |= std::uint64_t{1} << (count % WORD_BITS);
+}
+
+bool CountSet::contains(const int count) const {
+    const auto word_idx = static_cast<std::size_t>(count / WORD_BITS);
+    return count >= 0 && word_idx < words.size() &&
+           (words[word_idx] >> (count % WORD_BITS) & 1) != 0;
+}
+
+bool CountSet::empty() const { return words.empty(); }
+
+int CountSet::size() const {
+    int result = 0;
+    for (const auto word : words) {
+        result += std::popcount(word);
+    }
+    return result;
+}
+
+void CountSet::merge(const CountSet &other) {
+    if (other.words.size() > words.size()) {
+        words.resize(other.words.size(), 0);
+    }
+    for (std::size_t i = 0; i < other.words.size(); ++i) {
+        words[i] |= other.words[i];
+    }
+}
+
+CountSet all_sums(const CountSet &a, const CountSet &b) {
+    assert(!a.empty());
+    assert(!b.empty());
+
+    CountSet result;
+    result.words.assign(a.words.size() + b.words.size(), 0);
+    for (const auto shift : b) {
+        // OR in `a` shifted left by `shift` bits.
+        const auto word_shift = static_cast<std::size_t>(shift / CountSet::WORD_BITS);
+        const int bit_shift = shift % CountSet::WORD_BITS;
+        for (std::size_t i = 0; i < a.words.size(); ++i) {
+            result.words[i + word_shift] |= a.words[i] << bit_shift;
+            if (bit_shift != 0) {
+                result.words[i + word_shift + 1] |= a.words[i] >> (CountSet::WORD_BITS - bit_shift);
+            }
+        }
+    }
+    result.trim();
+
+    return result;
+}
+
+bool CountSet::operator==(const CountSet &rhs) const { return words == rhs.words; }
+
+void CountSet::trim() {
+    while (!words.empty() && words.back() == 0) {
+        words.pop_back();
+    }
+}
+
+CountSet::Iterator::Iterator(const std::vector<std::uint64_t> &words, const int word_idx)
+    : words{&words}, word_idx{word_idx} {
+    if (word_idx < static_cast<int>(words.size())) {
+        remaining = words[word_idx];
+        skip_empty_words();
+    }
+}
+
+CountSet::Iterator &CountSet::Iterator::operator++() {
+    remaining &= remaining - 1;
+    skip_empty_words();
+    return *this;
+}
+
+void CountSet::Iterator::skip_empty_words() {
+    while (remaining == 0 && ++word_idx < static_cast<int>(words->size())) {
+        remaining = (*words)[word_idx];
+    }
+}
+
+}  // namespace magnon::utils
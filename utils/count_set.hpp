@@ -0,0 +1,75 @@
+#pragma once
+
+#include <bit>
+#include <cstdint>
+#include <initializer_list>
+#include <set>
+#include <vector>
+
+namespace magnon::utils {
+
+// Set of small non-negative integers, such as the possible number of gaps with a given SI, stored
+// as a bitset. The sumset `all_sums(a, b)` of two such sets is an OR of shifted copies of `a`,
+// one per element of `b`, which takes a few word operations per element instead of |a| set
+// insertions.
+class CountSet {
+ public:
+    CountSet() = default;
+    CountSet(std::initializer_list<int> counts);
+
+    void insert(int count);
+    bool contains(int count) const;
+    bool empty() const;
+    int size() const;
+
+    // Insert all the elements of `other`.
+    void merge(const CountSet &other);
+
+    // {x + y | x in a, y in b}
+    friend CountSet all_sums(const CountSet &a, const CountSet &b);
+
+    bool operator==(const CountSet &rhs) const;
+
+    std::set<int> to_set() const { return {begin(), end()}; }
+
+    // Iterates the elements in increasing order.
+    class Iterator {
+     public:
+        using value_type = int;
+        using difference_type = std::ptrdiff_t;
+
+        Iterator() = default;
+        Iterator(const std::vector<std::uint64_t> &words, int word_idx);
+
+        int operator*() const { return word_idx * WORD_BITS + std::countr_zero(remaining); }
+        Iterator &operator++();
+        Iterator operator++(int) {
+            auto result = *this;
+            ++*this;
+            return result;
+        }
+        bool operator==(const Iterator &rhs) const {
+            return word_idx == rhs.word_idx && remaining == rhs.remaining;
+        }
+
+     private:
+        void skip_empty_words();
+
+        const std::vector<std::uint64_t> *words = nullptr;
+        int word_idx = 0;
+        std::uint64_t remaining = 0;  // Bits of `words[word_idx]` not visited yet
+    };
+
+    Iterator begin() const { return {words, 0}; }
+    Iterator end() const { return {words, static_cast<int>(words.size())}; }
+
+ private:
+    static constexpr int WORD_BITS = 64;
+
+    // Trailing zero words are not kept, so that equal sets compare equal.
+    void trim();
+
+    std::vector<std::uint64_t> words;
+};
+
+}  // namespace magnon::utils
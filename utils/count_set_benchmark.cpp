@@ -0,0 +1,108 @@
+// Measures the finishing pass of the gap-count search, which folds the possible gap counts of
+// every gap bracket of every superband ordering into sumsets, with `std::set<int>` and with
+// `CountSet`.
+//
+// Usage: count_set_benchmark [num_bands] [num_orderings]
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <set>
+#include <vector>
+
+#include "fmt/core.h"
+
+#include "utils/count_set.hpp"
+
+namespace {
+
+using magnon::utils::CountSet;
+
+constexpr int DEFAULT_NUM_BANDS = 384;
+constexpr int DEFAULT_NUM_ORDERINGS = 200;
+constexpr int BRACKET_WIDTH = 4;
+
+std::set<int> all_sums(const std::set<int> &a, const std::set<int> &b) {
+    std::set<int> result;
+    for (const auto &x : a) {
+        for (const auto &y : b) {
+            result.insert(x + y);
+        }
+    }
+    return result;
+}
+
+// Time `pass` and return the elapsed seconds.
+double time_s(const auto &pass) {
+    const auto start_time = std::chrono::steady_clock::now();
+    pass();
+    const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start_time;
+    return elapsed.count();
+}
+
+}  // namespace
+
+int main(int argc, const char **argv) {
+    const int num_bands = argc > 1 ? std::atoi(argv[1]) : DEFAULT_NUM_BANDS;
+    const int num_orderings = argc > 2 ? std::atoi(argv[2]) : DEFAULT_NUM_ORDERINGS;
+    const int num_brackets = num_bands / BRACKET_WIDTH;
+
+    // The possible counts of one SI in each bracket of each ordering.
+    std::mt19937 rng(0);
+    std::uniform_int_distribution<int> count_dist(0, BRACKET_WIDTH);
+    std::vector<std::vector<std::set<int>>> ordering_to_bracket_to_counts(num_orderings);
+    for (auto &bracket_to_counts : ordering_to_bracket_to_counts) {
+        for (int i = 0; i < num_brackets; ++i) {
+            auto &counts = bracket_to_counts.emplace_back();
+            for (int j = 0; j < 3; ++j) {
+                counts.insert(count_dist(rng));
+            }
+        }
+    }
+
+    std::set<int> set_result;
+    const double set_s = time_s([&]() {
+        for (const auto &bracket_to_counts : ordering_to_bracket_to_counts) {
+            std::set<int> possibcounts{0};
+            for (const auto &counts : bracket_to_counts) {
+                possibcounts = all_sums(possibcounts, counts);
+            }
+            set_result.insert(possibcounts.begin(), possibcounts.end());
+        }
+    });
+
+    std::vector<std::vector<CountSet>> ordering_to_bracket_to_count_set;
+    for (const auto &bracket_to_counts : ordering_to_bracket_to_counts) {
+        auto &bracket_to_count_set = ordering_to_bracket_to_count_set.emplace_back();
+        for (const auto &counts : bracket_to_counts) {
+            auto &count_set = bracket_to_count_set.emplace_back();
+            for (const auto count : counts) {
+                count_set.insert(count);
+            }
+        }
+    }
+
+    CountSet count_set_result;
+    const double count_set_s = time_s([&]() {
+        for (const auto &bracket_to_count_set : ordering_to_bracket_to_count_set) {
+            CountSet possibcounts{0};
+            for (const auto &counts : bracket_to_count_set) {
+                possibcounts = all_sums(possibcounts, counts);
+            }
+            count_set_result.merge(possibcounts);
+        }
+    });
+
+    if (count_set_result.to_set() != set_result) {
+        std::cerr << "Mismatch between the two implementations\n";
+        return 1;
+    }
+
+    std::cout << fmt::format("{} bands, {} orderings, {} brackets per ordering\n",
+                             num_bands,
+                             num_orderings,
+                             num_brackets);
+    std::cout << fmt::format("{:<16}{:10.3f} s\n", "std::set<int>:", set_s);
+    std::cout << fmt::format("{:<16}{:10.3f} s\n", "CountSet:", count_set_s);
+}
@@ -0,0 +1,52 @@
+#include "utils/count_set.hpp"
+
+#include <random>
+#include <set>
+
+#include "gtest/gtest.h"
+
+namespace magnon::utils {
+
+TEST(CountSetTest, InsertsAndIterates) {
+    CountSet set{3, 0, 64, 200};
+    set.insert(3);
+    EXPECT_EQ(set.size(), 4);
+    EXPECT_TRUE(set.contains(64));
+    EXPECT_FALSE(set.contains(63));
+    EXPECT_FALSE(set.contains(1000));
+    EXPECT_EQ(set.to_set(), (std::set<int>{0, 3, 64, 200}));
+    EXPECT_TRUE(CountSet{}.empty());
+}
+
+TEST(CountSetTest, AllSumsMatchesPairwiseSums) {
+    std::mt19937 rng(0);
+    for (int round = 0; round < 100; ++round) {
+        std::uniform_int_distribution<int> count_dist(0, 10 + 3 * round);
+        CountSet a, b;
+        std::set<int> expected_a, expected_b;
+        for (int i = 0; i < 1 + round % 7; ++i) {
+            const int x = count_dist(rng), y = count_dist(rng);
+            a.insert(x);
+            expected_a.insert(x);
+            b.insert(y);
+            expected_b.insert(y);
+        }
+
+        std::set<int> expected;
+        for (const auto x : expected_a) {
+            for (const auto y : expected_b) {
+                expected.insert(x + y);
+            }
+        }
+        EXPECT_EQ(all_sums(a, b).to_set(), expected);
+    }
+}
+
+TEST(CountSetTest, MergesAndCompares) {
+    CountSet set{1, 2};
+    set.merge({2, 130});
+    EXPECT_EQ(set, (CountSet{1, 2, 130}));
+    EXPECT_FALSE(set == (CountSet{1, 2}));
+}
+
+}  // namespace magnon::utils